@@ -0,0 +1,14 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include "bench_registry.hpp"
+
+#include <gain_controller.hpp>
+#include <gain_processor.hpp>
+
+///////////////////////////////////////////////////////////////////////////////
+// Plugins benchmarked by qplug_bench
+///////////////////////////////////////////////////////////////////////////////
+QPLUG_BENCH_PLUGIN(gain, gain_controller, gain_processor);
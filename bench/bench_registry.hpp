@@ -0,0 +1,52 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_BENCH_REGISTRY_HPP_NOVEMBER_9_2019)
+#define QPLUG_BENCH_REGISTRY_HPP_NOVEMBER_9_2019
+
+#include <headless/headless_plugin.hpp>
+#include <memory>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// Plugins benchmarked by qplug_bench. Register a plugin's controller (for
+// its parameters) and processor at namespace scope in any source file
+// linked into qplug_bench:
+//
+//    QPLUG_BENCH_PLUGIN(gain, gain_controller, gain_processor);
+//
+///////////////////////////////////////////////////////////////////////////////
+struct bench_plugin
+{
+   char const*                            name;
+   headless_plugin::controller_factory    make_controller;
+   headless_plugin::processor_factory     make_processor;
+};
+
+inline std::vector<bench_plugin>& bench_plugins()
+{
+   static std::vector<bench_plugin> plugins;
+   return plugins;
+}
+
+struct register_bench_plugin
+{
+   register_bench_plugin(bench_plugin const& plugin)
+   {
+      bench_plugins().push_back(plugin);
+   }
+};
+
+#define QPLUG_BENCH_PLUGIN(name, controller, processor)                       \
+   static register_bench_plugin name##_bench_plugin{{                         \
+      #name                                                                   \
+    , [](headless_plugin& base) -> headless_plugin::controller_ptr            \
+      { return std::make_unique<controller>(base); }                          \
+    , [](headless_plugin& base) -> headless_plugin::processor_ptr             \
+      { return std::make_unique<processor>(base); }                           \
+   }}                                                                         \
+   /***/
+
+#endif
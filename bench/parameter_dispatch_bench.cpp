@@ -0,0 +1,218 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <headless/headless_plugin.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// Cost per parameter change: bound variables (what processor::parameters
+// builds a std::function list from) vs. the compile-time parameter_table,
+// through the processor's public paths:
+//
+//    update_parameter:  processor::update_parameter, called directly
+//    host:              host automation (headless_plugin::automate), applied
+//                       by the processor at the end of each block
+//
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   constexpr std::size_t num_changes = 2'000'000;
+   constexpr std::size_t block_size = 256;
+
+   template <std::size_t N>
+   qplug::controller::parameter_list bench_parameters()
+   {
+      static std::vector<std::string> names;
+      static std::vector<qplug::parameter> params;
+      if (params.empty())
+      {
+         for (std::size_t i = 0; i != N; ++i)
+            names.push_back("Param " + std::to_string(i));
+         for (auto const& name : names)
+            params.push_back(qplug::parameter{ name.c_str(), 0.0 });
+      }
+      return { params.data(), params.data() + params.size() };
+   }
+
+   template <std::size_t N>
+   struct bench_controller : qplug::controller
+   {
+      using controller::controller;
+
+      parameter_list parameters() const override
+      {
+         return bench_parameters<N>();
+      }
+   };
+
+   // Bound variables
+   template <std::size_t N>
+   struct function_processor : qplug::processor
+   {
+      function_processor(base_processor& base)
+       : processor(base)
+      {
+         bind(std::make_index_sequence<N>{});
+      }
+
+      template <std::size_t... I>
+      void bind(std::index_sequence<I...>)
+      {
+         parameters(values[I]...);
+      }
+
+      bool sample_accurate() const override
+      {
+         return true;
+      }
+
+      void process(in_channels const&, out_channels const&) override {}
+
+      double values[N] = {};
+   };
+
+   // Binds to values[i], like a data member binding (the same type for all
+   // parameters, with a different offset)
+   template <typename Derived>
+   struct bind_value
+   {
+      void operator()(Derived& self, double value) const
+      {
+         self.values[i] = value;
+      }
+
+      std::size_t i;
+   };
+
+   template <std::size_t N>
+   struct table_target : qplug::processor
+   {
+      using processor::processor;
+
+      bool sample_accurate() const override
+      {
+         return true;
+      }
+
+      void process(in_channels const&, out_channels const&) override {}
+
+      double values[N] = {};
+   };
+
+   template <std::size_t N, std::size_t... I>
+   constexpr auto make_table(std::index_sequence<I...>)
+   {
+      return qplug::make_parameter_table<table_target<N>>(
+         bind_value<table_target<N>>{ I }...);
+   }
+
+   // At namespace scope, after the processor it binds to
+   template <std::size_t N>
+   constexpr auto dispatch_table = make_table<N>(std::make_index_sequence<N>{});
+
+   template <std::size_t N>
+   struct table_processor : table_target<N>
+   {
+      table_processor(base_processor& base)
+       : table_target<N>(base)
+      {
+         this->parameters(dispatch_table<N>);
+      }
+   };
+
+   template <std::size_t N>
+   std::vector<int> random_ids()
+   {
+      std::mt19937 gen{ 1234 };
+      std::uniform_int_distribution<int> dist(0, int(N-1));
+      std::vector<int> ids(num_changes);
+      for (auto& id : ids)
+         id = dist(gen);
+      return ids;
+   }
+
+   template <typename F>
+   double ns_per_change(F&& f)
+   {
+      auto start = std::chrono::steady_clock::now();
+      f();
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      return std::chrono::duration<double, std::nano>(elapsed).count() / num_changes;
+   }
+
+   struct result
+   {
+      double update_parameter;
+      double host;
+   };
+
+   template <typename Processor, std::size_t N>
+   result bench(std::vector<int> const& ids)
+   {
+      headless_plugin plugin{
+         [](headless_plugin& base) -> headless_plugin::controller_ptr
+         { return std::make_unique<bench_controller<N>>(base); }
+       , [](headless_plugin& base) -> headless_plugin::processor_ptr
+         { return std::make_unique<Processor>(base); }
+       , 48000, block_size
+      };
+
+      result r;
+      qplug::processor& proc = plugin.processor();
+      r.update_parameter = ns_per_change(
+         [&]
+         {
+            double value = 0.0;
+            for (auto id : ids)
+               proc.update_parameter(id, value += 1e-9);
+         }
+      );
+
+      std::vector<float> buffer(block_size);
+      float* out[] = { buffer.data() };
+      float const* in[] = { buffer.data() };
+      r.host = ns_per_change(
+         [&]
+         {
+            double value = 0.0;
+            for (std::size_t i = 0; i != ids.size(); ++i)
+            {
+               plugin.automate(ids[i], value += 1e-9, int(i % block_size));
+               if (i % block_size == block_size - 1)
+                  plugin.process(in, 1, out, 1, block_size);
+            }
+         }
+      );
+      return r;
+   }
+
+   template <std::size_t N>
+   void bench()
+   {
+      auto ids = random_ids<N>();
+      auto f = bench<function_processor<N>, N>(ids);
+      auto t = bench<table_processor<N>, N>(ids);
+
+      std::printf(
+         "%4zu parameters (ns/change):"
+         " update_parameter %6.2f (std::function) %6.2f (parameter_table),"
+         " host %6.2f (std::function) %6.2f (parameter_table)\n"
+       , N, f.update_parameter, t.update_parameter, f.host, t.host
+      );
+   }
+}
+
+int main()
+{
+   bench<16>();
+   bench<256>();
+   bench<4096>();
+   return 0;
+}
@@ -0,0 +1,183 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_BENCH_PERF_COUNTERS_HPP_NOVEMBER_9_2019)
+#define QPLUG_BENCH_PERF_COUNTERS_HPP_NOVEMBER_9_2019
+
+#include <cstdint>
+
+#if defined(__linux__)
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+# include <cstring>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Hardware counters (cycles, instructions and cache misses) for the calling
+// thread, read as a single perf_event_open group. Only available on Linux,
+// and only if the kernel allows it (see /proc/sys/kernel/perf_event_paranoid).
+// Check available() before using the counts.
+//
+// Where the kernel supports it, the counters are inherited by the threads
+// the calling thread starts after construction (e.g. a processor's
+// worker_pool), and the counts include theirs. Otherwise, all_threads() is
+// false and the counts are for the calling thread only.
+///////////////////////////////////////////////////////////////////////////////
+class perf_counters
+{
+public:
+
+   struct counts
+   {
+      std::uint64_t        cycles = 0;
+      std::uint64_t        instructions = 0;
+      std::uint64_t        cache_misses = 0;
+   };
+
+                           perf_counters();
+                           ~perf_counters();
+                           perf_counters(perf_counters const&) = delete;
+
+   bool                    available() const { return _fd[0] != -1; }
+   bool                    all_threads() const { return _all_threads; }
+   void                    start();
+   counts                  stop();
+
+private:
+
+   bool                    open(bool inherit);
+   void                    close_all();
+   counts                  read_counts() const;
+
+   static constexpr int    num_counters = 3;
+   int                     _fd[num_counters] = { -1, -1, -1 };
+   bool                    _all_threads = false;
+   counts                  _start;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Inline implementation
+///////////////////////////////////////////////////////////////////////////////
+#if defined(__linux__)
+
+inline perf_counters::perf_counters()
+{
+   // Reading an inherited group needs Linux 4.13 or later
+   _all_threads = open(true);
+   if (!_all_threads)
+      open(false);
+}
+
+inline bool perf_counters::open(bool inherit)
+{
+   std::uint64_t const config[num_counters] =
+   {
+      PERF_COUNT_HW_CPU_CYCLES
+    , PERF_COUNT_HW_INSTRUCTIONS
+    , PERF_COUNT_HW_CACHE_MISSES
+   };
+
+   for (int i = 0; i != num_counters; ++i)
+   {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = config[i];
+      attr.disabled = (i == 0);           // The group leader starts disabled
+      attr.inherit = inherit;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+
+      _fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, (i == 0)? -1 : _fd[0], 0);
+      if (_fd[i] == -1)
+      {
+         close_all();
+         return false;
+      }
+   }
+
+   // The kernel may accept the inherited group but fail to read it
+   if (inherit)
+   {
+      std::uint64_t data[1 + num_counters];
+      if (read(_fd[0], data, sizeof(data)) != sizeof(data))
+      {
+         close_all();
+         return false;
+      }
+   }
+   return true;
+}
+
+inline void perf_counters::close_all()
+{
+   for (auto& fd : _fd)
+   {
+      if (fd != -1)
+         close(fd);
+      fd = -1;
+   }
+}
+
+inline perf_counters::~perf_counters()
+{
+   close_all();
+}
+
+inline perf_counters::counts perf_counters::read_counts() const
+{
+   // PERF_FORMAT_GROUP layout: nr, then the values in group order. With
+   // inherit, the values include those of the inheriting threads.
+   counts result;
+   std::uint64_t data[1 + num_counters];
+   if (read(_fd[0], data, sizeof(data)) == sizeof(data))
+   {
+      result.cycles = data[1];
+      result.instructions = data[2];
+      result.cache_misses = data[3];
+   }
+   return result;
+}
+
+inline void perf_counters::start()
+{
+   if (!available())
+      return;
+
+   // Reset does not clear the counts of inheriting threads that have
+   // exited since, so the counts are taken relative to the start.
+   ioctl(_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+   _start = read_counts();
+   ioctl(_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+inline perf_counters::counts perf_counters::stop()
+{
+   if (!available())
+      return {};
+   ioctl(_fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+   auto end = read_counts();
+   return {
+      end.cycles - _start.cycles
+    , end.instructions - _start.instructions
+    , end.cache_misses - _start.cache_misses
+   };
+}
+
+#else
+
+inline perf_counters::perf_counters() {}
+inline perf_counters::~perf_counters() {}
+inline void perf_counters::start() {}
+inline perf_counters::counts perf_counters::stop() { return {}; }
+
+#endif
+
+#endif
@@ -0,0 +1,257 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <infra/filesystem.hpp>
+#include <elements/support/resource_paths.hpp>
+#include "headless/headless_plugin.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = cycfi::fs;
+namespace qplug = cycfi::qplug;
+using clock_type = std::chrono::steady_clock;
+
+///////////////////////////////////////////////////////////////////////////////
+// Preset queries from 64 plugin instances at once, each on its own thread,
+// while another instance saves presets (or not). The baseline puts each
+// query under one shared std::mutex, as the controller used to.
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   constexpr std::size_t num_instances = 64;
+   constexpr std::size_t num_params = 32;
+   constexpr std::size_t num_presets = 500;
+
+   qplug::controller::parameter_list bench_parameters()
+   {
+      static std::vector<std::string> names;
+      static std::vector<qplug::parameter> params;
+      if (params.empty())
+      {
+         for (std::size_t i = 0; i != num_params; ++i)
+            names.push_back("Param " + std::to_string(i));
+         for (auto const& name : names)
+            params.push_back(qplug::parameter{ name.c_str(), 0.5 });
+         params.push_back(qplug::parameter{ "Program ID", 0 }.range(0, 1000));
+      }
+      return { params.data(), params.data() + params.size() };
+   }
+
+   struct bench_controller : qplug::controller
+   {
+      using controller::controller;
+
+      parameter_list parameters() const override
+      {
+         return bench_parameters();
+      }
+   };
+
+   struct bench_processor : qplug::processor
+   {
+      using processor::processor;
+      void process(in_channels const& in, out_channels const& out) override {}
+   };
+
+   fs::path bench_dir()
+   {
+      return fs::temp_directory_path() / "preset_contention_bench";
+   }
+
+   void write_factory_presets()
+   {
+      fs::remove_all(bench_dir());
+      fs::create_directories(bench_dir());
+
+      std::ofstream file(bench_dir() / "factory_presets.json");
+      file << '{';
+      for (std::size_t i = 0; i != num_presets; ++i)
+      {
+         file << (i? ",\n" : "\n") << "  \"Preset " << i << "\" : {";
+         for (std::size_t j = 0; j != num_params; ++j)
+            file << "\"Param " << j << "\" : 0." << (i + j) % 10 << ", ";
+         file << "\"Program ID\" : " << i << '}';
+      }
+      file << "\n}\n";
+   }
+
+   struct result
+   {
+      double ops_per_s = 0;
+      double p99_us = 0;
+      double max_us = 0;
+   };
+
+   // Each thread queries its own instance for a while
+   result run(std::vector<std::unique_ptr<headless_plugin>>& plugins, bool saving, bool locked)
+   {
+      static std::mutex global_mutex;
+      std::atomic<bool> go{ false }, stop{ false };
+      std::vector<std::vector<float>> latencies(plugins.size());
+      std::vector<std::size_t> ops(plugins.size());
+
+      auto query = [&](std::size_t n)
+      {
+         auto& controller = plugins[n]->controller();
+         auto& samples = latencies[n];
+         samples.reserve(1 << 20);
+         while (!go)
+            std::this_thread::yield();
+
+         std::size_t i = n;
+         std::size_t total = 0;
+         std::string name;
+         while (!stop)
+         {
+            name = "Preset " + std::to_string(i++ % num_presets);
+            auto start = clock_type::now();
+            {
+               std::unique_lock<std::mutex> lock(global_mutex, std::defer_lock);
+               if (locked)
+                  lock.lock();
+               switch (total % 4)
+               {
+                  case 0: controller.has_preset(name); break;
+                  case 1: controller.find_preset_id(name); break;
+                  case 2: controller.find_preset(int(i % num_presets)); break;
+                  case 3: controller.preset_list(); break;
+               }
+            }
+            auto elapsed = std::chrono::duration<float, std::micro>(clock_type::now() - start);
+            if (samples.size() != samples.capacity())
+               samples.push_back(elapsed.count());
+            ++total;
+         }
+         ops[n] = total;
+      };
+
+      auto save = [&]
+      {
+         auto& controller = plugins[0]->controller();
+         while (!go)
+            std::this_thread::yield();
+         for (int i = 0; !stop; ++i)
+         {
+            {
+               std::unique_lock<std::mutex> lock(global_mutex, std::defer_lock);
+               if (locked)
+                  lock.lock();
+               controller.save_preset("Saved " + std::to_string(i % 8));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+      };
+
+      std::vector<std::thread> threads;
+      for (std::size_t n = 0; n != plugins.size(); ++n)
+         threads.emplace_back(query, n);
+      if (saving)
+         threads.emplace_back(save);
+
+      auto duration = std::chrono::milliseconds(1000);
+      go = true;
+      std::this_thread::sleep_for(duration);
+      stop = true;
+      for (auto& t : threads)
+         t.join();
+
+      std::vector<float> all;
+      for (auto const& samples : latencies)
+         all.insert(all.end(), samples.begin(), samples.end());
+      std::sort(all.begin(), all.end());
+
+      result r;
+      for (auto n : ops)
+         r.ops_per_s += n;
+      r.ops_per_s /= std::chrono::duration<double>(duration).count();
+      if (!all.empty())
+      {
+         r.p99_us = all[all.size() * 99 / 100];
+         r.max_us = all.back();
+      }
+      return r;
+   }
+
+   void print(char const* name, result const& r)
+   {
+      std::printf(
+         "%-32s %12.0f queries/s   p99 %8.2f us   max %10.2f us\n"
+       , name, r.ops_per_s, r.p99_us, r.max_us
+      );
+   }
+
+   // The mean time to save a preset, with library_size user presets.
+   // Saving copies the one preset only, so this should not grow with the
+   // library.
+   void save_latency(qplug::controller& controller, std::size_t library_size)
+   {
+      for (std::size_t i = 0; i != library_size; ++i)
+         controller.save_preset("User " + std::to_string(i));
+
+      constexpr int num_saves = 200;
+      auto start = clock_type::now();
+      for (int i = 0; i != num_saves; ++i)
+         controller.save_preset("User 0");
+      auto elapsed = std::chrono::duration<double, std::micro>(clock_type::now() - start);
+
+      std::printf(
+         "save, %6zu user presets %18.2f us\n"
+       , library_size, elapsed.count() / num_saves
+      );
+
+      for (std::size_t i = 0; i != library_size; ++i)
+         controller.delete_preset("User " + std::to_string(i));
+   }
+}
+
+namespace cycfi::qplug
+{
+   controller_ptr make_controller(base_controller& base)
+   {
+      return std::make_unique<bench_controller>(base);
+   }
+
+   processor_ptr make_processor(base_processor& base)
+   {
+      return std::make_unique<bench_processor>(base);
+   }
+}
+
+int main()
+{
+   write_factory_presets();
+   setenv("XDG_DATA_HOME", bench_dir().c_str(), 1);
+   cycfi::elements::add_search_path(bench_dir());
+
+   std::vector<std::unique_ptr<headless_plugin>> plugins;
+   for (std::size_t i = 0; i != num_instances; ++i)
+   {
+      plugins.push_back(std::make_unique<headless_plugin>());
+      plugins.back()->controller().load_all_presets();
+   }
+
+   std::printf("%zu instances, %zu presets\n", num_instances, num_presets);
+   print("snapshots", run(plugins, false, false));
+   print("snapshots, while saving", run(plugins, true, false));
+   print("shared mutex", run(plugins, false, true));
+   print("shared mutex, while saving", run(plugins, true, true));
+
+   for (std::size_t i = 0; i != 8; ++i)
+      plugins[0]->controller().delete_preset("Saved " + std::to_string(i));
+
+   save_latency(plugins[0]->controller(), 10);
+   save_latency(plugins[0]->controller(), 10000);
+   return 0;
+}
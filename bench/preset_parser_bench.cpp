@@ -0,0 +1,126 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <qplug/presets.hpp>
+#include <qplug/preset_reader.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace cycfi::qplug;
+
+///////////////////////////////////////////////////////////////////////////////
+// Preset parsing throughput: preset_parser (X3) vs. read_presets, on banks
+// written the way the controller writes user presets.
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   struct plugin
+   {
+      plugin(std::size_t n)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+            names.push_back("Parameter " + std::to_string(i));
+         for (auto const& name : names)
+            params.push_back(parameter{ name.c_str(), 0.5 }.range(-100, 100));
+      }
+
+      parameter_list list() const
+      {
+         return { params.data(), params.data() + params.size() };
+      }
+
+      std::vector<std::string>   names;
+      std::vector<parameter>     params;
+   };
+
+   std::string make_bank(plugin const& p, std::size_t num_presets)
+   {
+      std::mt19937 rng{ 1234 };
+      std::uniform_real_distribution<double> value{ -100, 100 };
+
+      std::ostringstream out;
+      out << '{';
+      for (std::size_t i = 0; i != num_presets; ++i)
+      {
+         out << (i? ",\n" : "\n") << "  \"Preset " << i << "\" : {";
+         int j = 0;
+         for (auto const& param : p.params)
+         {
+            out << (j++? ",\n" : "\n") << "    \"" << param._name << "\" : ";
+            param.print(out, value(rng));
+         }
+         out << "\n  }";
+      }
+      out << "\n}\n";
+      return out.str();
+   }
+
+   template <typename F>
+   double mb_per_s(std::size_t size, F&& f)
+   {
+      // Repeat for at least 500ms
+      std::size_t n = 0;
+      auto start = std::chrono::steady_clock::now();
+      auto elapsed = start - start;
+      do
+      {
+         if (!f())
+            std::printf("Parse failed!\n");
+         ++n;
+         elapsed = std::chrono::steady_clock::now() - start;
+      }
+      while (elapsed < std::chrono::milliseconds(500));
+      auto seconds = std::chrono::duration<double>(elapsed).count();
+      return (double(size) * n) / (seconds * 1024 * 1024);
+   }
+}
+
+void bench(std::size_t num_params, std::size_t num_presets)
+{
+   plugin p{ num_params };
+   auto json = make_bank(p, num_presets);
+
+   double sum = 0;
+   auto&& on_param = [&sum](auto const& v, parameter const&) { sum += v.second; };
+   auto&& on_preset_name = [](std::string_view) {};
+
+   auto x3_speed = mb_per_s(json.size(),
+      [&]
+      {
+         char const* f = json.data();
+         char const* l = f + json.size();
+         auto attr = for_each_preset(p.list(), on_param, on_preset_name);
+         return x3::phrase_parse(f, l, preset_parser{}, x3::space, attr);
+      }
+   );
+
+   parameter_names names{ p.list() };
+   auto reader_speed = mb_per_s(json.size(),
+      [&]
+      {
+         return read_presets(json, names, on_param, on_preset_name);
+      }
+   );
+
+   std::printf(
+      "%5zu presets x %4zu parameters (%6.2f MB): X3 %7.1f MB/s"
+      " | read_presets %7.1f MB/s (%.1fx)\n"
+    , num_presets, num_params, json.size() / (1024.0 * 1024.0)
+    , x3_speed, reader_speed, reader_speed / x3_speed
+   );
+}
+
+int main()
+{
+   bench(16, 20000);
+   bench(128, 2000);
+   bench(1000, 200);
+   return 0;
+}
@@ -0,0 +1,155 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <qplug/parameter.hpp>
+#include <qplug/preset_store.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace cycfi::qplug;
+
+///////////////////////////////////////////////////////////////////////////////
+// Cost of recalling a preset and memory per preset: the old layout (a map
+// of name to value per preset, searched by parameter name, as
+// controller::load_preset used to do) vs. preset_store.
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   // Bytes currently allocated with new. Each block keeps its size in a
+   // header.
+   std::size_t allocated = 0;
+   constexpr std::size_t header_size = alignof(std::max_align_t);
+}
+
+void* operator new(std::size_t size)
+{
+   if (auto p = static_cast<char*>(std::malloc(size + header_size)))
+   {
+      allocated += size;
+      *reinterpret_cast<std::size_t*>(p) = size;
+      return p + header_size;
+   }
+   throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+   if (!p)
+      return;
+   auto block = static_cast<char*>(p) - header_size;
+   allocated -= *reinterpret_cast<std::size_t*>(block);
+   std::free(block);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+   operator delete(p);
+}
+
+using preset_info = std::map<std::string, double>;
+using preset_info_map = std::map<std::string, preset_info>;
+
+struct plugin
+{
+   plugin(std::size_t n)
+   {
+      for (std::size_t i = 0; i != n; ++i)
+         names.push_back("Parameter " + std::to_string(i));
+      for (auto const& name : names)
+         params.push_back({ name.c_str(), 0.5 });
+      values.resize(n, 0.5);
+   }
+
+   std::vector<std::string>   names;
+   std::vector<parameter>     params;
+   std::vector<double>        values;
+};
+
+template <typename F>
+double us_per_call(F&& f)
+{
+   // Repeat for at least 100ms
+   std::size_t n = 0;
+   auto start = std::chrono::steady_clock::now();
+   auto elapsed = start - start;
+   do
+   {
+      f();
+      ++n;
+      elapsed = std::chrono::steady_clock::now() - start;
+   }
+   while (elapsed < std::chrono::milliseconds(100));
+   return std::chrono::duration<double, std::micro>(elapsed).count() / n;
+}
+
+void bench(std::size_t n, std::size_t num_presets)
+{
+   plugin p{ n };
+
+   auto start = allocated;
+   preset_info_map map;
+   for (std::size_t i = 0; i != num_presets; ++i)
+   {
+      auto& preset = map["Preset " + std::to_string(i)];
+      for (std::size_t j = 0; j != n; ++j)
+         preset[p.params[j]._name] = double(i + j);
+   }
+   auto map_bytes = allocated - start;
+
+   start = allocated;
+   preset_store store{ n };
+   for (std::size_t i = 0; i != num_presets; ++i)
+   {
+      auto preset = store.add("Preset " + std::to_string(i));
+      for (std::size_t j = 0; j != n; ++j)
+         store.set(preset, int(j), double(i + j));
+   }
+   auto store_bytes = allocated - start;
+
+   auto map_recall = us_per_call(
+      [&]
+      {
+         auto& preset = map.find("Preset 1")->second;
+         int i = 0;
+         for (auto const& param : p.params)
+         {
+            auto iter = preset.find(param._name);
+            if (iter != preset.end())
+               p.values[i] = iter->second;
+            ++i;
+         }
+      }
+   );
+
+   auto store_recall = us_per_call(
+      [&]
+      {
+         store.for_each(store.find("Preset 1"),
+            [&](int param, double value) { p.values[param] = value; });
+      }
+   );
+
+   std::printf(
+      "%6zu parameters: map recall %9.2f us, %8zu bytes/preset"
+      " | store recall %8.2f us, %8zu bytes/preset\n"
+    , n, map_recall, map_bytes / num_presets
+    , store_recall, store_bytes / num_presets
+   );
+}
+
+int main()
+{
+   bench(10, 1000);
+   bench(100, 1000);
+   bench(1000, 100);
+   return 0;
+}
@@ -0,0 +1,325 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include "bench_registry.hpp"
+#include "perf_counters.hpp"
+#include <qplug/rt_check.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// Drives the processors of all registered plugins through the headless
+// backend across block sizes, channel counts and automation densities, and
+// emits the results as JSON (stdout, or --out FILE). A human readable
+// summary goes to stderr.
+//
+// ns_per_sample is the wall time per frame per channel. Hardware counters
+// are null when perf_event_open is not available. They include the
+// processor's worker threads (see processor::channel_group_size) when the
+// kernel lets them inherit the counters; otherwise counters_partial is true
+// for the results that processed channel groups in parallel.
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   char const* usage =
+      "Usage: qplug_bench [options]\n"
+      "\n"
+      "Options:\n"
+      "  -p, --plugin NAME   benchmark only NAME (may be repeated)\n"
+      "  -f, --frames N      frames processed per run (default: 262144)\n"
+      "  -s, --sps N         sample rate (default: 48000)\n"
+      "  -q, --quick         fewer block sizes, channel counts and densities\n"
+      "  -o, --out FILE      write the JSON results to FILE\n"
+      "  -l, --list          list the registered plugins\n"
+      ;
+
+   struct options
+   {
+      std::vector<std::string>   plugins;
+      std::size_t                frames = 1 << 18;
+      std::uint32_t              sps = 48000;
+      bool                       quick = false;
+      bool                       list = false;
+      std::string                out;
+   };
+
+   options parse_options(int argc, char const* argv[])
+   {
+      options opts;
+      for (int i = 1; i < argc; ++i)
+      {
+         std::string arg = argv[i];
+         auto value = [&]() -> std::string
+         {
+            if (++i == argc)
+               throw std::runtime_error{ "Error: Missing value for " + arg };
+            return argv[i];
+         };
+
+         if (arg == "-p" || arg == "--plugin")
+            opts.plugins.push_back(value());
+         else if (arg == "-f" || arg == "--frames")
+            opts.frames = std::stoul(value());
+         else if (arg == "-s" || arg == "--sps")
+            opts.sps = std::stoul(value());
+         else if (arg == "-q" || arg == "--quick")
+            opts.quick = true;
+         else if (arg == "-o" || arg == "--out")
+            opts.out = value();
+         else if (arg == "-l" || arg == "--list")
+            opts.list = true;
+         else
+            throw std::runtime_error{ usage };
+      }
+      return opts;
+   }
+
+   struct config
+   {
+      bench_plugin const*  plugin;
+      std::size_t          block;
+      std::size_t          channels;
+      std::size_t          events_per_block;
+   };
+
+   struct result
+   {
+      config               cfg;
+      std::size_t          frames;
+      double               seconds;
+      bool                 has_counters;
+      bool                 parallel;
+      perf_counters::counts counts;
+   };
+
+   struct automation_event
+   {
+      int                  frame;
+      int                  id;
+      double               value;
+   };
+
+   // Precomputed automation, so generating it is not measured: a repeating
+   // pattern of blocks, each with events_per_block changes at random frames
+   // to random parameters.
+   std::vector<std::vector<automation_event>>
+   make_automation(headless_plugin const& plugin, config const& cfg)
+   {
+      constexpr std::size_t num_patterns = 64;
+      std::vector<std::vector<automation_event>> blocks(num_patterns);
+      auto num_params = plugin.num_parameters();
+      if (num_params == 0 || cfg.events_per_block == 0)
+         return blocks;
+
+      std::mt19937 gen{ 1234 };
+      std::uniform_int_distribution<int> frame_dist(0, int(cfg.block - 1));
+      std::uniform_int_distribution<int> id_dist(0, int(num_params - 1));
+      std::uniform_real_distribution<double> value_dist(0.0, 1.0);
+
+      auto n = std::min(cfg.events_per_block, cfg.block);
+      for (auto& events : blocks)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            auto id = id_dist(gen);
+            events.push_back({ frame_dist(gen), id, plugin.from_normalized(id, value_dist(gen)) });
+         }
+         std::sort(events.begin(), events.end(),
+            [](auto const& a, auto const& b) { return a.frame < b.frame; });
+      }
+      return blocks;
+   }
+
+   result run(config const& cfg, std::size_t total_frames, std::uint32_t sps, perf_counters& perf)
+   {
+      headless_plugin plugin{
+         cfg.plugin->make_controller, cfg.plugin->make_processor, sps, cfg.block };
+      auto automation = make_automation(plugin, cfg);
+
+      std::mt19937 gen{ 5678 };
+      std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+      std::vector<std::vector<float>> in_buffs(cfg.channels, std::vector<float>(cfg.block));
+      std::vector<std::vector<float>> out_buffs(cfg.channels, std::vector<float>(cfg.block));
+      std::vector<float const*> in;
+      std::vector<float*> out;
+      for (auto& buff : in_buffs)
+      {
+         std::generate(buff.begin(), buff.end(), [&]{ return noise(gen); });
+         in.push_back(buff.data());
+      }
+      for (auto& buff : out_buffs)
+         out.push_back(buff.data());
+
+      auto num_blocks = std::max<std::size_t>(total_frames / cfg.block, 16);
+      std::size_t pattern = 0;
+      auto process_block = [&]
+      {
+         for (auto const& event : automation[pattern])
+            plugin.automate(event.id, event.value, event.frame);
+         pattern = (pattern + 1) % automation.size();
+         plugin.process(in.data(), cfg.channels, out.data(), cfg.channels, cfg.block);
+      };
+
+      plugin.activate(true);
+
+      // Warm up
+      for (std::size_t i = 0; i != num_blocks / 8 + 1; ++i)
+         process_block();
+
+      perf.start();
+      auto start = std::chrono::steady_clock::now();
+      for (std::size_t i = 0; i != num_blocks; ++i)
+         process_block();
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      auto counts = perf.stop();
+
+      plugin.activate(false);
+      bool parallel = plugin.processor().channel_group_size() != 0;
+      return { cfg, num_blocks * cfg.block, elapsed.count(), perf.available(), parallel, counts };
+   }
+
+   void write_json(
+      std::ostream& out, std::vector<result> const& results
+    , std::uint32_t sps, perf_counters const& perf)
+   {
+      bool has_counters = perf.available();
+      auto counter = [&](std::uint64_t count, double samples)
+      {
+         return has_counters? std::to_string(count / samples) : std::string{ "null" };
+      };
+
+      // Counts that miss the worker threads
+      bool partial = has_counters && !perf.all_threads();
+
+      out << "{\n";
+      out << "  \"sps\": " << sps << ",\n";
+      out << "  \"perf_counters\": " << (has_counters? "true" : "false") << ",\n";
+      out << "  \"perf_counters_all_threads\": " << (perf.all_threads()? "true" : "false") << ",\n";
+      out << "  \"results\": [\n";
+      for (std::size_t i = 0; i != results.size(); ++i)
+      {
+         auto const& r = results[i];
+         double samples = double(r.frames) * r.cfg.channels;
+         double audio_time = double(r.frames) / sps;
+         out << "    { "
+            << "\"plugin\": \"" << r.cfg.plugin->name << "\", "
+            << "\"block\": " << r.cfg.block << ", "
+            << "\"channels\": " << r.cfg.channels << ", "
+            << "\"events_per_block\": " << std::min(r.cfg.events_per_block, r.cfg.block) << ", "
+            << "\"frames\": " << r.frames << ", "
+            << "\"ns_per_sample\": " << (r.seconds * 1e9 / samples) << ", "
+            << "\"realtime_factor\": " << (audio_time / r.seconds) << ", "
+            << "\"cycles_per_sample\": " << counter(r.counts.cycles, samples) << ", "
+            << "\"instructions_per_sample\": " << counter(r.counts.instructions, samples) << ", "
+            << "\"cache_misses_per_sample\": " << counter(r.counts.cache_misses, samples) << ", "
+            << "\"counters_partial\": " << ((partial && r.parallel)? "true" : "false")
+            << " }" << ((i + 1 != results.size())? "," : "") << '\n';
+      }
+      out << "  ]\n";
+      out << "}\n";
+   }
+
+   void bench(options const& opts)
+   {
+      auto const& plugins = bench_plugins();
+      if (opts.list)
+      {
+         for (auto const& plugin : plugins)
+            std::cout << plugin.name << std::endl;
+         return;
+      }
+
+      std::vector<std::size_t> block_sizes, channel_counts, densities;
+      if (opts.quick)
+      {
+         block_sizes = { 1, 64, 512, 8192 };
+         channel_counts = { 2 };
+         densities = { 0, 1 };
+      }
+      else
+      {
+         for (std::size_t block = 1; block <= 8192; block *= 2)
+            block_sizes.push_back(block);
+         channel_counts = { 1, 2, 8 };
+         densities = { 0, 1, 16 };
+      }
+
+      perf_counters perf;
+      if (!perf.available())
+         std::cerr << "Hardware counters are not available." << std::endl;
+      else if (!perf.all_threads())
+         std::cerr << "Hardware counters exclude worker threads." << std::endl;
+
+      std::vector<result> results;
+      for (auto const& plugin : plugins)
+      {
+         if (!opts.plugins.empty()
+            && std::find(opts.plugins.begin(), opts.plugins.end(), plugin.name) == opts.plugins.end())
+            continue;
+
+         for (auto block : block_sizes)
+            for (auto channels : channel_counts)
+               for (std::size_t i = 0; i != densities.size(); ++i)
+               {
+                  // Densities are capped to the block size. Skip those that
+                  // repeat a previous configuration at small block sizes.
+                  auto density = densities[i];
+                  if (i != 0 && std::min(densities[i-1], block) == std::min(density, block))
+                     continue;
+
+                  auto r = run({ &plugin, block, channels, density }, opts.frames, opts.sps, perf);
+                  std::cerr
+                     << plugin.name
+                     << " block: " << block
+                     << " channels: " << channels
+                     << " events/block: " << std::min(density, block)
+                     << " ns/sample: " << (r.seconds * 1e9 / (double(r.frames) * channels))
+                     << std::endl;
+                  results.push_back(r);
+               }
+      }
+
+      if (opts.out.empty())
+      {
+         write_json(std::cout, results, opts.sps, perf);
+      }
+      else
+      {
+         std::ofstream file(opts.out);
+         if (!file)
+            throw std::runtime_error{ "Error: Cannot open \"" + opts.out + "\"" };
+         write_json(file, results, opts.sps, perf);
+      }
+   }
+}
+
+int main(int argc, char const* argv[])
+{
+   try
+   {
+      bench(parse_options(argc, argv));
+   }
+   catch (std::exception const& e)
+   {
+      std::cerr << e.what() << std::endl;
+      return 1;
+   }
+
+   // In realtime safety checking builds, fail if a processor allocated,
+   // locked or did file I/O
+   if (cycfi::qplug::rt_check::violations())
+   {
+      cycfi::qplug::rt_check::print_report(stderr);
+      return 2;
+   }
+   return 0;
+}
@@ -0,0 +1,150 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <qplug/plugin_state.hpp>
+#include <qplug/data_stream.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace cycfi::qplug;
+
+///////////////////////////////////////////////////////////////////////////////
+// Cost of saving and loading the plugin state: the legacy format (names,
+// matched with a linear scan, as UnserializeState used to do) vs. the
+// binary format (ids, matched with parameter_index).
+///////////////////////////////////////////////////////////////////////////////
+struct vector_istream : istream
+{
+   vector_istream(std::vector<char> const& buff)
+    : _buff(buff)
+   {}
+
+   char const* data() const override { return _buff.data(); }
+   std::size_t size() const override { return _buff.size(); }
+
+   std::vector<char> const& _buff;
+};
+
+struct plugin
+{
+   plugin(std::size_t n)
+   {
+      for (std::size_t i = 0; i != n; ++i)
+         names.push_back("Parameter " + std::to_string(i));
+      for (auto const& name : names)
+         params.push_back({ name.c_str(), 0.5 });
+      values.resize(n, 0.5);
+      index = parameter_index{ { params.data(), params.data() + params.size() } };
+   }
+
+   std::vector<std::string>   names;
+   std::vector<parameter>     params;
+   std::vector<double>        values;
+   parameter_index            index;
+};
+
+void save_legacy(vector_ostream& str, plugin const& p)
+{
+   int num_params = p.params.size();
+   str << num_params;
+   for (int i = 0; i < num_params; ++i)
+      str << p.params[i]._name << p.values[i];
+}
+
+void load_legacy(vector_istream& str, plugin& p)
+{
+   int num_params = 0;
+   str >> num_params;
+   for (int i = 0; i < num_params; ++i)
+   {
+      std::string name;
+      double value;
+      str >> name >> value;
+      for (std::size_t j = 0; j != p.params.size(); ++j)
+      {
+         if (p.params[j]._name == name)
+         {
+            p.values[j] = value;
+            break;
+         }
+      }
+   }
+}
+
+template <typename F>
+double us_per_call(F&& f)
+{
+   // Repeat for at least 100ms
+   std::size_t n = 0;
+   auto start = std::chrono::steady_clock::now();
+   auto elapsed = start - start;
+   do
+   {
+      f();
+      ++n;
+      elapsed = std::chrono::steady_clock::now() - start;
+   }
+   while (elapsed < std::chrono::milliseconds(100));
+   return std::chrono::duration<double, std::micro>(elapsed).count() / n;
+}
+
+void bench(std::size_t n)
+{
+   plugin p{ n };
+
+   std::vector<char> legacy_buff;
+   vector_ostream legacy{ legacy_buff };
+   auto legacy_save = us_per_call(
+      [&]
+      {
+         legacy_buff.clear();
+         save_legacy(legacy, p);
+      }
+   );
+
+   auto legacy_load = us_per_call(
+      [&]
+      {
+         vector_istream str{ legacy_buff };
+         load_legacy(str, p);
+      }
+   );
+
+   std::vector<char> binary_buff;
+   vector_ostream binary{ binary_buff };
+   auto binary_save = us_per_call(
+      [&]
+      {
+         binary_buff.clear();
+         save_parameters(binary, p.index, [&](int id) { return p.values[id]; });
+      }
+   );
+
+   auto binary_load = us_per_call(
+      [&]
+      {
+         vector_istream str{ binary_buff };
+         load_parameters(str, p.index, [&](int id, double value) { p.values[id] = value; });
+      }
+   );
+
+   std::printf(
+      "%6zu parameters: legacy save %9.2f us, load %11.2f us (%7zu bytes)"
+      " | binary save %8.2f us, load %8.2f us (%7zu bytes)\n"
+    , n, legacy_save, legacy_load, legacy_buff.size()
+    , binary_save, binary_load, binary_buff.size()
+   );
+}
+
+int main()
+{
+   bench(100);
+   bench(1000);
+   bench(10000);
+   return 0;
+}
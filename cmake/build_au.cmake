@@ -63,6 +63,7 @@ set(QPLUG_DEPENDENCIES
    ${AUDIOTOOLBOX}
    elements
    libq
+   qplug_kernels
 )
 
 configure_file(
@@ -70,9 +71,12 @@ configure_file(
    factory.cpp
 )
 
+include(${QPLUG_ROOT}/cmake/factory_presets.cmake)
+
 set (QPLUG_SOURCES
    ${QPLUG_SOURCES}
    ${CMAKE_CURRENT_BINARY_DIR}/factory.cpp
+   ${QPLUG_FACTORY_PRESETS_SOURCES}
 )
 
 add_library(${target} MODULE
@@ -83,6 +87,10 @@ add_library(${target} MODULE
    ${QPLUG_RESOURCES}
 )
 
+if (TARGET ${factory_presets_target})
+   add_dependencies(${target} ${factory_presets_target})
+endif()
+
 target_compile_definitions(${target}
    PUBLIC
    IPLUG2=1
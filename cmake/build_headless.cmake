@@ -0,0 +1,83 @@
+###############################################################################
+#  Copyright (c) 2016-2019 Joel de Guzman. All rights reserved.
+#
+#  Distributed under the MIT License (https://opensource.org/licenses/MIT)
+###############################################################################
+cmake_minimum_required(VERSION 3.5.1)
+
+set(CMAKE_CXX_STANDARD 17)
+set(CMAKE_CXX_STANDARD_REQUIRED ON)
+set(target ${PLUG_NAME}_render)
+include(${QPLUG_ROOT}/cmake/derived.cmake)
+
+if (CMAKE_BUILD_TYPE MATCHES Debug)
+   add_compile_definitions(NDEBUG=1)
+endif()
+
+set(Boost_USE_STATIC_LIBS ON)
+find_package(Boost 1.61 REQUIRED)
+find_package(Threads REQUIRED)
+
+# The headless backend builds into its own directory so its factory.cpp and
+# config.h do not clash with the plugin targets'.
+set(HEADLESS_BINARY_DIR ${CMAKE_CURRENT_BINARY_DIR}/headless)
+
+configure_file(
+   ${QPLUG_ROOT}/cmake/factory.cpp.in
+   ${HEADLESS_BINARY_DIR}/factory.cpp
+)
+
+configure_file(
+   ${QPLUG_ROOT}/cmake/config.h.in
+   ${HEADLESS_BINARY_DIR}/config.h
+)
+
+include(${QPLUG_ROOT}/cmake/factory_presets.cmake)
+
+add_executable(${target}
+   ${PLUG_SOURCES}
+   ${QPLUG_HEADLESS_SOURCES}
+   ${QPLUG_ROOT}/lib/src/headless/render.cpp
+   ${HEADLESS_BINARY_DIR}/factory.cpp
+   ${QPLUG_FACTORY_PRESETS_SOURCES}
+)
+
+if (TARGET ${factory_presets_target})
+   add_dependencies(${target} ${factory_presets_target})
+endif()
+
+target_compile_options(${target} PRIVATE
+   $<$<CXX_COMPILER_ID:GNU>: -Wextra -Wpedantic -ftemplate-backtrace-limit=0>
+   $<$<CXX_COMPILER_ID:Clang>: -Wpedantic -ftemplate-backtrace-limit=0>
+   $<$<CXX_COMPILER_ID:MSVC>: /wd4068 /wd4244 /wd4305 /wd4996 /wd4267 /wd4018>
+)
+
+target_compile_definitions(${target}
+   PUBLIC
+   QPLUG_HEADLESS=1
+)
+
+target_include_directories(${target}
+   PUBLIC
+   ${PLUG_INCLUDE_DIRECTORIES}
+   ${QPLUG_INCLUDE_DIRS}
+   ${QPLUG_ROOT}/lib/src
+   ${CMAKE_CURRENT_SOURCE_DIR}
+   ${HEADLESS_BINARY_DIR}
+   ${QPLUG_ROOT}/lib/infra/include
+   ${Boost_INCLUDE_DIRS}
+)
+
+target_link_libraries(${target}
+   PRIVATE
+   elements
+   libq
+   qplug_kernels
+   Threads::Threads
+)
+
+if (QPLUG_RT_CHECK)
+   target_compile_definitions(${target} PUBLIC QPLUG_RT_CHECK=1)
+   target_link_libraries(${target} PRIVATE ${CMAKE_DL_LIBS})
+   set_target_properties(${target} PROPERTIES ENABLE_EXPORTS ON)
+endif()
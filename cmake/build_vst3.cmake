@@ -62,6 +62,7 @@ if (APPLE)
       ${AUDIOTOOLBOX}
       elements
       libq
+      qplug_kernels
    )
 endif()
 
@@ -71,6 +72,7 @@ if (WIN32)
       Delayimp.lib
       elements
       libq
+      qplug_kernels
    )
 endif()
 
@@ -79,9 +81,12 @@ configure_file(
    factory.cpp
 )
 
+include(${QPLUG_ROOT}/cmake/factory_presets.cmake)
+
 set (QPLUG_SOURCES
    ${QPLUG_SOURCES}
    ${CMAKE_CURRENT_BINARY_DIR}/factory.cpp
+   ${QPLUG_FACTORY_PRESETS_SOURCES}
 )
 
 add_library(${target} MODULE
@@ -92,6 +97,10 @@ add_library(${target} MODULE
    ${QPLUG_RESOURCES}
 )
 
+if (TARGET ${factory_presets_target})
+   add_dependencies(${target} ${factory_presets_target})
+endif()
+
 # Get rid of certain warnings
 target_compile_options(${target} PRIVATE
    $<$<CXX_COMPILER_ID:GNU>: -Wextra -Wpedantic -ftemplate-backtrace-limit=0>
@@ -0,0 +1,107 @@
+###############################################################################
+#  Copyright (c) 2016-2019 Joel de Guzman. All rights reserved.
+#
+#  Distributed under the MIT License (https://opensource.org/licenses/MIT)
+###############################################################################
+cmake_minimum_required(VERSION 3.5.1)
+
+# Factory presets, compiled into the plugin. PLUG_FACTORY_PRESETS is the
+# factory presets file (by default, the factory_presets.json in
+# PLUG_RESOURCES, if there is one). The presets tool checks it against the
+# plugin's parameters (invalid presets fail the build) and converts it to
+# a table, factory_presets.cpp, in QPLUG_FACTORY_PRESETS_SOURCES. Included
+# by each of the build scripts; the tool and the table are made once.
+
+if (NOT DEFINED PLUG_FACTORY_PRESETS)
+   foreach (resource ${PLUG_RESOURCES})
+      get_filename_component(resource_name ${resource} NAME)
+      if (resource_name STREQUAL "factory_presets.json")
+         set(PLUG_FACTORY_PRESETS ${resource})
+      endif()
+   endforeach()
+endif()
+
+set(presets_target ${PLUG_NAME}_presets)
+set(factory_presets_target ${PLUG_NAME}_factory_presets)
+set(FACTORY_PRESETS_BINARY_DIR ${CMAKE_CURRENT_BINARY_DIR}/factory_presets)
+
+if (NOT TARGET ${presets_target})
+
+   set(Boost_USE_STATIC_LIBS ON)
+   find_package(Boost 1.61 REQUIRED)
+   find_package(Threads REQUIRED)
+
+   ############################################################################
+   # Preset converter: JSON presets to a binary preset bank (.qpb), or
+   # factory presets to a table. Built with the headless backend, into its
+   # own directory so its factory.cpp and config.h do not clash with the
+   # plugin targets'.
+
+   configure_file(
+      ${QPLUG_ROOT}/cmake/factory.cpp.in
+      ${FACTORY_PRESETS_BINARY_DIR}/factory.cpp
+   )
+
+   configure_file(
+      ${QPLUG_ROOT}/cmake/config.h.in
+      ${FACTORY_PRESETS_BINARY_DIR}/config.h
+   )
+
+   add_executable(${presets_target}
+      ${PLUG_SOURCES}
+      ${QPLUG_HEADLESS_SOURCES}
+      ${QPLUG_ROOT}/lib/src/headless/convert_presets.cpp
+      ${FACTORY_PRESETS_BINARY_DIR}/factory.cpp
+   )
+
+   target_compile_definitions(${presets_target}
+      PUBLIC
+      QPLUG_HEADLESS=1
+   )
+
+   target_include_directories(${presets_target}
+      PUBLIC
+      ${PLUG_INCLUDE_DIRECTORIES}
+      ${QPLUG_INCLUDE_DIRS}
+      ${QPLUG_ROOT}/lib/src
+      ${CMAKE_CURRENT_SOURCE_DIR}
+      ${FACTORY_PRESETS_BINARY_DIR}
+      ${QPLUG_ROOT}/lib/infra/include
+      ${Boost_INCLUDE_DIRS}
+   )
+
+   target_link_libraries(${presets_target}
+      PRIVATE
+      elements
+      libq
+      qplug_kernels
+      Threads::Threads
+   )
+
+   ############################################################################
+   # The factory presets table
+
+   if (PLUG_FACTORY_PRESETS)
+      add_custom_command(
+         OUTPUT ${FACTORY_PRESETS_BINARY_DIR}/factory_presets.cpp
+         COMMAND ${presets_target}
+            ${PLUG_FACTORY_PRESETS}
+            ${FACTORY_PRESETS_BINARY_DIR}/factory_presets.cpp
+         DEPENDS ${presets_target} ${PLUG_FACTORY_PRESETS}
+         COMMENT "Compiling factory presets ${PLUG_FACTORY_PRESETS}"
+         VERBATIM
+      )
+
+      add_custom_target(${factory_presets_target}
+         DEPENDS ${FACTORY_PRESETS_BINARY_DIR}/factory_presets.cpp
+      )
+   endif()
+endif()
+
+if (PLUG_FACTORY_PRESETS)
+   set(QPLUG_FACTORY_PRESETS_SOURCES
+      ${FACTORY_PRESETS_BINARY_DIR}/factory_presets.cpp
+   )
+else()
+   set(QPLUG_FACTORY_PRESETS_SOURCES)
+endif()
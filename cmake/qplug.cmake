@@ -13,6 +13,7 @@ if (CMAKE_BUILD_TYPE MATCHES Debug)
 endif()
 
 set(QPLUG_BUILD_TEST OFF CACHE BOOL "")
+set(QPLUG_BUILD_BENCH OFF CACHE BOOL "")
 add_subdirectory(${QPLUG_ROOT} "${CMAKE_CURRENT_BINARY_DIR}/qplug")
 
 set(QPLUG_TOOLS "${QPLUG_ROOT}/external/tools")
@@ -21,9 +22,26 @@ include(${QPLUG_ROOT}/cmake/defaults.cmake)
 set (QPLUG_SOURCES
    ${QPLUG_ROOT}/lib/src/processor.cpp
    ${QPLUG_ROOT}/lib/src/controller.cpp
+   ${QPLUG_ROOT}/lib/src/directory_watcher.cpp
+   ${QPLUG_ROOT}/lib/src/factory_presets.cpp
+   ${QPLUG_ROOT}/lib/src/preset_bank.cpp
+   ${QPLUG_ROOT}/lib/src/preset_journal.cpp
+   ${QPLUG_ROOT}/lib/src/worker_pool.cpp
    ${QPLUG_ROOT}/lib/src/iplug2/iplug2_plugin.cpp
 )
 
+set (QPLUG_HEADLESS_SOURCES
+   ${QPLUG_ROOT}/lib/src/processor.cpp
+   ${QPLUG_ROOT}/lib/src/controller.cpp
+   ${QPLUG_ROOT}/lib/src/directory_watcher.cpp
+   ${QPLUG_ROOT}/lib/src/factory_presets.cpp
+   ${QPLUG_ROOT}/lib/src/preset_bank.cpp
+   ${QPLUG_ROOT}/lib/src/preset_journal.cpp
+   ${QPLUG_ROOT}/lib/src/worker_pool.cpp
+   ${QPLUG_ROOT}/lib/src/rt_check.cpp
+   ${QPLUG_ROOT}/lib/src/headless/headless_plugin.cpp
+)
+
 set (QPLUG_INCLUDE_DIRS
    ${QPLUG_ROOT}/lib/include
 )
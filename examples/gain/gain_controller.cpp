@@ -45,7 +45,7 @@ parameter_list gain_controller::parameters() const
 {
    static parameter params[] =
    {
-      parameter{ "Gain", 100.0 }.range(0, 100).unit("%")
+      parameter{ "Gain", 100.0 }.range(0, 100).unit("%").smooth(50)
    };
 
    return { params };
@@ -7,7 +7,7 @@
 #define QPLUG_GAIN_PROCESSOR_JUNE_3_2019
 
 #include <qplug/processor.hpp>
-#include <q/fx/lowpass.hpp>
+#include <qplug/kernels.hpp>
 
 namespace qplug = cycfi::qplug;
 namespace q = cycfi::q;
@@ -18,13 +18,11 @@ class gain_processor : public qplug::processor
 public:
                         gain_processor(base_processor& base);
 
-   void                 reset() override;
    void                 process(in_channels const& in, out_channels const& out) override;
 
 private:
 
-   double               _gain = 1.0;
-   q::one_pole_lowpass  _gain_lp;
+   enum { gain_id };
 };
 
 #endif
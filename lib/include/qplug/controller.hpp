@@ -8,11 +8,13 @@
 
 #include <qplug/parameter.hpp>
 #include <qplug/data_stream.hpp>
+#include <qplug/load_meter.hpp>
 #include <q/support/midi.hpp>
 #include <infra/iterator_range.hpp>
 #include <elements/view.hpp>
 #include <elements/element/button.hpp>
 
+#include <future>
 #include <memory>
 #include <vector>
 #include <map>
@@ -22,6 +24,10 @@
 # include "IPlug_include_in_plug_hdr.h"
 class iplug2_plugin;
 using base_controller = iplug2_plugin;
+#elif defined(QPLUG_HEADLESS)
+# include "config.h"
+class headless_plugin;
+using base_controller = headless_plugin;
 #endif
 
 namespace cycfi::qplug
@@ -67,7 +73,8 @@ namespace cycfi::qplug
       // Called when a parameter is set via set_parameter
       virtual void            on_set_parameter(int id, double value) {}
 
-      // Called when parameter is being loaded via preset
+      // Called when parameter is being loaded via preset (only if its value
+      // changes)
       virtual void            on_recall_parameter(int id, double value) {}
 
       // Called when user is editing a parameter via the GUI
@@ -93,8 +100,37 @@ namespace cycfi::qplug
 
       using preset_names_list = std::vector<std::pair<std::string_view, int>>;
 
+      // Load the presets on the calling thread. Waits for a background
+      // load in progress, if any.
       bool                    load_all_presets();
+
+      // Load the presets in the background. The plugin starts this when it
+      // is created, and calls poll_presets from the UI thread (e.g. on
+      // idle), which calls on_presets_loaded once the presets are ready.
+      void                    load_all_presets_async();
+      void                    poll_presets();
+      bool                    presets_loaded() const { return _presets_loaded; }
+      virtual void            on_presets_loaded() {}
+
+      // Once loaded, the user presets are kept up to date with the changes
+      // other processes (e.g. another host) make to them, in the
+      // background. poll_presets calls on_presets_changed when they do.
+      virtual void            on_presets_changed() {}
+
       bool                    load_preset(std::string_view name);
+
+      // Morph from preset from (or the current values, if from is empty) to
+      // preset to, in the processor, over ms milliseconds. With ms == 0, the
+      // morph follows processor::morph_position instead. bool, int and note
+      // parameters switch at switch_point (0 to 1). The host's parameters
+      // are not changed while morphing. Once a timed morph is done,
+      // poll_presets recalls the values it ended on; a morph along the
+      // position never ends, so load_preset(to) to make it stick.
+      bool                    morph_preset(
+                                 std::string_view from, std::string_view to
+                               , double ms, double switch_point = 0.5);
+      void                    stop_morph();
+
       std::string_view        find_preset(int program_id) const;
       int                     find_preset_id(std::string_view name) const;
 
@@ -106,6 +142,9 @@ namespace cycfi::qplug
       bool                    has_factory_preset(std::string_view name) const;
       preset_names_list       preset_list() const;
 
+      // Changes whenever presets are loaded, saved or deleted
+      std::uint64_t           presets_generation() const;
+
       virtual void            on_load_begin(int version) {}
       virtual void            load_state(istream& str) {}
       virtual void            on_load_end() {}
@@ -114,6 +153,11 @@ namespace cycfi::qplug
       virtual void            save_state(ostream& str) {}
       virtual void            on_save_end() {}
 
+      // The plugin caches the saved state until it changes. Parameter
+      // changes are tracked; call this when the state written by
+      // save_state changes.
+      void                    state_changed();
+
       bool                    is_dirty() const { return _dirty; }
 
                               template <typename MIDIProcessor>
@@ -122,12 +166,18 @@ namespace cycfi::qplug
 
       std::string_view        host_name() const;
 
+      // The processor's DSP load. Lock-free; call it from the UI thread
+      // (e.g. on a timer) to display a CPU meter or collect statistics.
+      load_meter const&       dsp_load() const;
+
    private:
 
       friend base_controller;
 
-      void                    recall_parameter(int id, double value);
+      void                    recall_parameters(parameter_value_list& values);
       void                    parameter_change(int id, double value);
+      void                    wait_for_presets() const;
+      void                    poll_morph();
 
                               template <typename T, typename... Rest>
       void                    add_controller(int id, T&& first, Rest&&... rest);
@@ -138,6 +188,15 @@ namespace cycfi::qplug
       base_controller&        _base;
       param_change_list       _on_parameter_change;
       bool                    _dirty = false;
+      bool                    _recalling = false;   // The view is refreshed once
+
+      std::future<bool>       _presets_loading;
+      bool                    _presets_loaded = false;
+      bool                    _user_presets = false;
+      std::uint64_t           _external_changes_seen = 0;
+
+      parameter_value_list    _morph_end;
+      std::uint32_t           _morph_id = 0;
 
       using midi_event = std::function<void(q::midi::raw_message msg, std::size_t time)>;
       midi_event              _on_midi_event = [](auto, auto){};
@@ -241,7 +300,7 @@ namespace cycfi::qplug
       detail::set_callback(*control,
          [this, id](auto val) // Called when the user interacts with the GUI
          {
-            _dirty = true;
+            state_changed();
             edit_parameter(id, val);
          }
       );
@@ -254,7 +313,8 @@ namespace cycfi::qplug
             f = [this, control](double value)
             {
                control->value(value > 0.5);
-               detail::refresh_element(*view(), *control);
+               if (!_recalling)
+                  detail::refresh_element(*view(), *control);
             };
             break;
 
@@ -264,7 +324,8 @@ namespace cycfi::qplug
             f = [this, control](double value)
             {
                control->value(value);
-               detail::refresh_element(*view(), *control);
+               if (!_recalling)
+                  detail::refresh_element(*view(), *control);
             };
             break;
 
@@ -273,7 +334,8 @@ namespace cycfi::qplug
             {
                // $$$ TODO: pass the actual note value $$$
                control->value(value);
-               detail::refresh_element(*view(), *control);
+               if (!_recalling)
+                  detail::refresh_element(*view(), *control);
             };
             break;
       }
@@ -6,20 +6,269 @@
 #if !defined(QPLUG_DATA_STREAM_OCTOBER_21_2019)
 #define QPLUG_DATA_STREAM_OCTOBER_21_2019
 
-#include <infra/data_stream.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 namespace cycfi::qplug
 {
-   struct ostream : cycfi::ostream<ostream>
+   ////////////////////////////////////////////////////////////////////////////
+   // Binary streams for the plugin state (see controller::save_state and
+   // controller::load_state). Arithmetic values are written as raw bytes,
+   // strings as null terminated characters.
+   //
+   // Large data (e.g. wavetables or IRs) should use write_array/read_array,
+   // which write the element count then copy all the elements at once, and
+   // read_view, which points into the stream's data instead of copying.
+   ////////////////////////////////////////////////////////////////////////////
+   struct ostream
    {
-      virtual ostream& write(const char* s, std::size_t size) = 0;
+      virtual                 ~ostream() = default;
+      virtual ostream&        write(const char* s, std::size_t size) = 0;
+
+      // Hint that size more bytes are coming
+      virtual void            reserve(std::size_t /*size*/) {}
+
+                              template <typename T>
+      std::enable_if_t<std::is_arithmetic<T>::value, ostream&>
+                              operator<<(T val);
+      ostream&                operator<<(char const* s);
+      ostream&                operator<<(std::string const& s);
+      ostream&                operator<<(std::string_view s);
+
+      // Element count (uint32), then the elements
+                              template <typename T>
+      ostream&                write_array(T const* data, std::size_t n);
+                              template <typename T>
+      ostream&                write_array(std::vector<T> const& v);
    };
 
-   struct istream : cycfi::istream<istream>
+   struct istream
    {
-      virtual char const* data() const = 0;
-      virtual std::size_t size() const = 0;
+      virtual                 ~istream() = default;
+      virtual char const*     data() const = 0;
+      virtual std::size_t     size() const = 0;
+
+      // False once a read went past the end. Failed reads give zeros and
+      // empty strings and arrays.
+      bool                    good() const { return _ok; }
+      std::size_t             pos() const { return _pos; }
+      std::size_t             remaining() const;
+
+                              template <typename T>
+      std::enable_if_t<std::is_arithmetic<T>::value, istream&>
+                              operator>>(T& val);
+      istream&                operator>>(std::string& s);
+
+      // Zero-copy reads. The views point into the stream's data and are
+      // valid as long as the data is. read_array_view gives the raw bytes
+      // of what write_array wrote; they are not necessarily aligned for T.
+      istream&                read_view(std::string_view& s);
+                              template <typename T>
+      istream&                read_array_view(std::string_view& bytes);
+
+      // Read what write_array wrote, with a single copy
+                              template <typename T>
+      istream&                read_array(std::vector<T>& v);
+
+   private:
+
+      char const*             take(std::size_t n);
+
+      std::size_t             _pos = 0;
+      bool                    _ok = true;
    };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // An ostream appending to a vector. Reserving grows the vector
+   // geometrically, so many small writes stay linear.
+   ////////////////////////////////////////////////////////////////////////////
+   struct vector_ostream : ostream
+   {
+      explicit                vector_ostream(std::vector<char>& buff)
+                               : _buff(buff)
+                              {}
+
+      ostream&                write(const char* s, std::size_t size) override;
+      void                    reserve(std::size_t size) override;
+
+      std::vector<char>&      _buff;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // An istream reading memory it does not own
+   ////////////////////////////////////////////////////////////////////////////
+   struct memory_istream : istream
+   {
+                              memory_istream(char const* data, std::size_t size)
+                               : _data(data)
+                               , _size(size)
+                              {}
+
+      char const*             data() const override { return _data; }
+      std::size_t             size() const override { return _size; }
+
+      char const*             _data;
+      std::size_t             _size;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename T>
+   inline std::enable_if_t<std::is_arithmetic<T>::value, ostream&>
+   ostream::operator<<(T val)
+   {
+      return write(reinterpret_cast<char const*>(&val), sizeof(T));
+   }
+
+   inline ostream& ostream::operator<<(char const* s)
+   {
+      return write(s, std::strlen(s) + 1);
+   }
+
+   inline ostream& ostream::operator<<(std::string const& s)
+   {
+      return write(s.c_str(), s.size() + 1);
+   }
+
+   inline ostream& ostream::operator<<(std::string_view s)
+   {
+      reserve(s.size() + 1);
+      write(s.data(), s.size());
+      return write("", 1);
+   }
+
+   template <typename T>
+   inline ostream& ostream::write_array(T const* data, std::size_t n)
+   {
+      static_assert(std::is_trivially_copyable<T>::value,
+         "write_array requires trivially copyable elements");
+
+      reserve(sizeof(std::uint32_t) + n * sizeof(T));
+      *this << std::uint32_t(n);
+      return write(reinterpret_cast<char const*>(data), n * sizeof(T));
+   }
+
+   template <typename T>
+   inline ostream& ostream::write_array(std::vector<T> const& v)
+   {
+      return write_array(v.data(), v.size());
+   }
+
+   inline ostream& vector_ostream::write(const char* s, std::size_t size)
+   {
+      _buff.insert(_buff.end(), s, s + size);
+      return *this;
+   }
+
+   inline void vector_ostream::reserve(std::size_t size)
+   {
+      auto needed = _buff.size() + size;
+      if (needed > _buff.capacity())
+         _buff.reserve(std::max(needed, 2 * _buff.capacity()));
+   }
+
+   inline std::size_t istream::remaining() const
+   {
+      auto n = size();
+      return (_pos < n)? n - _pos : 0;
+   }
+
+   inline char const* istream::take(std::size_t n)
+   {
+      if (!_ok || n > remaining())
+      {
+         _ok = false;
+         return nullptr;
+      }
+      auto p = data() + _pos;
+      _pos += n;
+      return p;
+   }
+
+   template <typename T>
+   inline std::enable_if_t<std::is_arithmetic<T>::value, istream&>
+   istream::operator>>(T& val)
+   {
+      if (auto p = take(sizeof(T)))
+         std::memcpy(&val, p, sizeof(T));
+      else
+         val = T{};
+      return *this;
+   }
+
+   inline istream& istream::operator>>(std::string& s)
+   {
+      std::string_view view;
+      read_view(view);
+      s.assign(view.data(), view.size());
+      return *this;
+   }
+
+   inline istream& istream::read_view(std::string_view& s)
+   {
+      s = {};
+      auto n = remaining();
+      if (!_ok || n == 0)
+      {
+         _ok = false;
+         return *this;
+      }
+
+      auto first = data() + _pos;
+      auto last = static_cast<char const*>(std::memchr(first, 0, n));
+      if (!last)
+      {
+         _ok = false;
+         return *this;
+      }
+      s = { first, std::size_t(last - first) };
+      _pos += s.size() + 1;
+      return *this;
+   }
+
+   template <typename T>
+   inline istream& istream::read_array_view(std::string_view& bytes)
+   {
+      bytes = {};
+      std::uint32_t n = 0;
+      *this >> n;
+      if (n > remaining() / sizeof(T))
+      {
+         _ok = false;
+         return *this;
+      }
+      if (auto p = take(n * sizeof(T)))
+         bytes = { p, n * sizeof(T) };
+      return *this;
+   }
+
+   template <typename T>
+   inline istream& istream::read_array(std::vector<T>& v)
+   {
+      static_assert(std::is_trivially_copyable<T>::value,
+         "read_array requires trivially copyable elements");
+
+      v.clear();
+      std::uint32_t n = 0;
+      *this >> n;
+      if (n > remaining() / sizeof(T))
+      {
+         _ok = false;
+         return *this;
+      }
+
+      v.resize(n);
+      if (auto p = take(n * sizeof(T)))
+         std::memcpy(v.data(), p, n * sizeof(T));
+      return *this;
+   }
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,93 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_DIRECTORY_WATCHER_HPP_DECEMBER_2_2019)
+#define QPLUG_DIRECTORY_WATCHER_HPP_DECEMBER_2_2019
+
+#include <infra/filesystem.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // directory_watcher: Calls on_change, on a background thread, when any
+   // of the given files in a directory is created, written, replaced or
+   // deleted (e.g. by another process).
+   //
+   // On Linux, changes are notified by inotify. Elsewhere, or if inotify
+   // is not available, the files are polled: their sizes and modification
+   // times are checked every interval. Changes that come together are
+   // reported once, and on_change is never called concurrently.
+   ////////////////////////////////////////////////////////////////////////////
+   class directory_watcher
+   {
+   public:
+
+      using file_names = std::vector<std::string>;
+      using callback = std::function<void()>;
+      using duration = std::chrono::milliseconds;
+
+      enum mode { notify, poll };
+
+                              directory_watcher(
+                                 fs::path const& dir
+                               , file_names files
+                               , callback on_change
+                               , mode mode_ = notify
+                               , duration interval = duration{ 500 }
+                              );
+                              directory_watcher(directory_watcher const&) = delete;
+                              ~directory_watcher();
+
+      directory_watcher&      operator=(directory_watcher const&) = delete;
+
+      // Polling, because notify was not asked for or is not available
+      bool                    is_polling() const   { return _polling; }
+
+   private:
+
+      struct file_state
+      {
+         bool                 exists = false;
+         std::uintmax_t       size = 0;
+         fs::file_time_type   time;
+
+         bool operator==(file_state const& rhs) const
+         {
+            return exists == rhs.exists && size == rhs.size && time == rhs.time;
+         }
+      };
+
+      void                    watch();
+      void                    watch_notify();
+      void                    watch_poll();
+      bool                    read_events();
+      std::vector<file_state> stat_files() const;
+
+      fs::path                _dir;
+      file_names              _files;
+      callback                _on_change;
+      duration                _interval;
+
+      int                     _notify_fd = -1;
+      int                     _wake_fd[2] = { -1, -1 };
+      bool                    _polling = true;
+
+      std::mutex              _mutex;
+      std::condition_variable _cond;
+      bool                    _stop = false;
+      bool                    _done = false;
+      std::thread             _thread;
+   };
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_EVENT_QUEUE_HPP_NOVEMBER_4_2019)
+#define QPLUG_EVENT_QUEUE_HPP_NOVEMBER_4_2019
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // event_queue: A fixed capacity queue of timestamped events for one audio
+   // block, kept sorted by frame offset. Storage is allocated up front and
+   // push never allocates. Hosts deliver sample accurate events from within
+   // the process call, so the queue is filled and drained by the audio
+   // thread only; no locking is involved.
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename Event>
+   class event_queue
+   {
+   public:
+
+      using iterator = Event const*;
+
+      explicit                event_queue(std::size_t capacity = 1024);
+                              event_queue(event_queue const&) = delete;
+
+      bool                    push(Event const& ev);
+      void                    clear()           { _size = 0; }
+
+      iterator                begin() const     { return _events.data(); }
+      iterator                end() const       { return _events.data() + _size; }
+      Event const&            operator[](std::size_t i) const { return _events[i]; }
+
+      std::size_t             size() const      { return _size; }
+      std::size_t             capacity() const  { return _events.size(); }
+      bool                    empty() const     { return _size == 0; }
+      bool                    full() const      { return _size == _events.size(); }
+
+   private:
+
+      std::vector<Event>      _events;
+      std::size_t             _size = 0;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // A parameter change at a specific frame offset within the current block.
+   // value is the plain (not normalized) parameter value.
+   ////////////////////////////////////////////////////////////////////////////
+   struct parameter_event
+   {
+      std::uint32_t           frame;
+      int                     id;
+      double                  value;
+   };
+
+   using parameter_event_queue = event_queue<parameter_event>;
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename Event>
+   inline event_queue<Event>::event_queue(std::size_t capacity)
+    : _events(capacity)
+   {}
+
+   template <typename Event>
+   inline bool event_queue<Event>::push(Event const& ev)
+   {
+      if (full())
+         return false;
+
+      // Events almost always arrive in order, so we do an insertion from the
+      // back. Events with equal frames keep their arrival order.
+      auto i = _size++;
+      for (; i != 0 && _events[i-1].frame > ev.frame; --i)
+         _events[i] = _events[i-1];
+      _events[i] = ev;
+      return true;
+   }
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_FACTORY_PRESETS_HPP_NOVEMBER_30_2019)
+#define QPLUG_FACTORY_PRESETS_HPP_NOVEMBER_30_2019
+
+#include <qplug/parameter.hpp>
+#include <infra/iterator_range.hpp>
+#include <cstddef>
+#include <ostream>
+#include <string_view>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // Factory presets compiled into the plugin. At build time, the presets
+   // tool validates factory_presets.json against the plugin's parameters
+   // and writes it out as a C++ source file (see write_factory_presets)
+   // holding a constexpr table, which registers itself when the plugin is
+   // loaded. The controller then uses the table instead of looking for
+   // factory_presets.qpb or factory_presets.json: no file I/O and no
+   // parsing.
+   ////////////////////////////////////////////////////////////////////////////
+   struct factory_preset_value
+   {
+      int                     param;   // Index into the plugin's parameters
+      double                  value;   // Plain value
+   };
+
+   struct factory_preset
+   {
+      std::string_view        name;
+      factory_preset_value const* values;
+      std::size_t             size;
+   };
+
+   struct factory_preset_table
+   {
+      factory_preset const*   presets;
+      std::size_t             size;
+      std::size_t             num_params;
+   };
+
+   // Called by the generated table, before main. Returns true.
+   bool                       register_factory_presets(factory_preset_table const& table);
+
+   // The registered table, or nullptr if there is none
+   factory_preset_table const* compiled_factory_presets();
+
+   // Write the presets (see preset_parser) as a factory preset table.
+   // Returns false if the presets are invalid (e.g. a parameter is not
+   // one of params), with the error written to err.
+   bool                       write_factory_presets(
+                                 std::string_view json
+                               , iterator_range<parameter const*> params
+                               , std::ostream& out
+                               , std::ostream& err
+                              );
+}
+
+#endif
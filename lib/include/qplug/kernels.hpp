@@ -0,0 +1,223 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_KERNELS_HPP_NOVEMBER_11_2019)
+#define QPLUG_KERNELS_HPP_NOVEMBER_11_2019
+
+#include <q/support/audio_stream.hpp>
+#include <cmath>
+#include <cstddef>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // Block kernels: vectorized operations on blocks of samples. There are
+   // SSE2, AVX2 (with FMA), AVX-512 and NEON implementations, plus a
+   // portable one. The best one supported by the CPU is selected when the
+   // library is loaded, so a single binary runs everywhere.
+   //
+   // Use the functions in namespace kernels below. The tables are exposed
+   // for testing and benchmarking the implementations against each other.
+   ////////////////////////////////////////////////////////////////////////////
+   struct kernel_table
+   {
+      void  (*clear)(float* out, std::size_t n);
+      void  (*copy)(float* out, float const* in, std::size_t n);
+      void  (*gain)(float* out, float const* in, float g, std::size_t n);
+      void  (*gain_buffer)(float* out, float const* in, float const* g, float scale, std::size_t n);
+      void  (*gain_ramp)(float* out, float const* in, float from, float to, std::size_t n);
+      void  (*mix)(float* out, float const* in, float g, std::size_t n);
+      void  (*pan)(float* left, float* right, float const* in, float gl, float gr, std::size_t n);
+      float (*peak)(float const* in, std::size_t n);
+      float (*sum_squares)(float const* in, std::size_t n);
+      void  (*interleave2)(float* out, float const* left, float const* right, std::size_t n);
+      void  (*deinterleave2)(float* left, float* right, float const* in, std::size_t n);
+   };
+
+   enum class kernel_isa
+   {
+      scalar
+    , sse2
+    , avx2
+    , avx512
+    , neon
+   };
+
+   kernel_isa           active_kernel_isa();
+   char const*          kernel_isa_name(kernel_isa isa);
+
+   // The table for isa, or nullptr if it is not supported by the build or
+   // by the CPU.
+   kernel_table const*  kernel_table_for(kernel_isa isa);
+
+   namespace detail
+   {
+      extern kernel_table active_kernels;
+   }
+
+   namespace kernels
+   {
+      using in_channels = q::audio_stream::in_channels;
+      using out_channels = q::audio_stream::out_channels;
+
+      // out[i] = 0
+      void  clear(float* out, std::size_t n);
+
+      // out[i] = in[i]
+      void  copy(float* out, float const* in, std::size_t n);
+
+      // out[i] = in[i] * g
+      void  gain(float* out, float const* in, float g, std::size_t n);
+
+      // out[i] = in[i] * g[i] * scale (e.g. g is a parameter_ramp's data)
+      void  gain(float* out, float const* in, float const* g, float scale, std::size_t n);
+
+      // out[i] = in[i] * gain, with the gain going linearly from `from`
+      // (exclusive) to `to` (reached at the last frame)
+      void  gain_ramp(float* out, float const* in, float from, float to, std::size_t n);
+
+      // out[i] += in[i] * g
+      void  mix(float* out, float const* in, float g, std::size_t n);
+
+      // Constant power pan of a mono input to stereo. pos goes from -1
+      // (left) to 1 (right).
+      void  pan(float* left, float* right, float const* in, float pos, std::size_t n);
+
+      // Maximum absolute value and RMS
+      float peak(float const* in, std::size_t n);
+      float rms(float const* in, std::size_t n);
+
+      // Interleave channels into frames and back. Stereo is vectorized.
+      void  interleave(float* out, float const* const* in, std::size_t channels, std::size_t n);
+      void  deinterleave(float* const* out, float const* in, std::size_t channels, std::size_t n);
+
+      // audio_channels versions. These apply to the channels common to in
+      // and out, over all frames.
+      void  copy(out_channels const& out, in_channels const& in);
+      void  gain(out_channels const& out, in_channels const& in, float g);
+      void  gain(out_channels const& out, in_channels const& in, float const* g, float scale);
+      void  gain_ramp(out_channels const& out, in_channels const& in, float from, float to);
+      void  mix(out_channels const& out, in_channels const& in, float g);
+      void  clear(out_channels const& out);
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   namespace kernels
+   {
+      namespace detail
+      {
+         template <typename Channels>
+         inline auto data(Channels const& channels, std::size_t ch)
+         {
+            return channels[ch].begin();
+         }
+
+         template <typename Channels>
+         inline std::size_t frames(Channels const& channels)
+         {
+            return channels.size()? channels[0].size() : 0;
+         }
+
+         inline std::size_t common(out_channels const& out, in_channels const& in)
+         {
+            return (out.size() < in.size())? out.size() : in.size();
+         }
+      }
+
+      inline void clear(float* out, std::size_t n)
+      {
+         qplug::detail::active_kernels.clear(out, n);
+      }
+
+      inline void copy(float* out, float const* in, std::size_t n)
+      {
+         qplug::detail::active_kernels.copy(out, in, n);
+      }
+
+      inline void gain(float* out, float const* in, float g, std::size_t n)
+      {
+         qplug::detail::active_kernels.gain(out, in, g, n);
+      }
+
+      inline void gain(float* out, float const* in, float const* g, float scale, std::size_t n)
+      {
+         qplug::detail::active_kernels.gain_buffer(out, in, g, scale, n);
+      }
+
+      inline void gain_ramp(float* out, float const* in, float from, float to, std::size_t n)
+      {
+         qplug::detail::active_kernels.gain_ramp(out, in, from, to, n);
+      }
+
+      inline void mix(float* out, float const* in, float g, std::size_t n)
+      {
+         qplug::detail::active_kernels.mix(out, in, g, n);
+      }
+
+      inline void pan(float* left, float* right, float const* in, float pos, std::size_t n)
+      {
+         constexpr float quarter_pi = 0.785398163397448f;
+         auto angle = (pos + 1) * quarter_pi;
+         qplug::detail::active_kernels.pan(
+            left, right, in, std::cos(angle), std::sin(angle), n);
+      }
+
+      inline float peak(float const* in, std::size_t n)
+      {
+         return qplug::detail::active_kernels.peak(in, n);
+      }
+
+      inline float rms(float const* in, std::size_t n)
+      {
+         return n? std::sqrt(qplug::detail::active_kernels.sum_squares(in, n) / n) : 0.0f;
+      }
+
+      inline void copy(out_channels const& out, in_channels const& in)
+      {
+         auto n = detail::frames(out);
+         for (std::size_t ch = 0, nch = detail::common(out, in); ch != nch; ++ch)
+            copy(detail::data(out, ch), detail::data(in, ch), n);
+      }
+
+      inline void gain(out_channels const& out, in_channels const& in, float g)
+      {
+         auto n = detail::frames(out);
+         for (std::size_t ch = 0, nch = detail::common(out, in); ch != nch; ++ch)
+            gain(detail::data(out, ch), detail::data(in, ch), g, n);
+      }
+
+      inline void gain(out_channels const& out, in_channels const& in, float const* g, float scale)
+      {
+         auto n = detail::frames(out);
+         for (std::size_t ch = 0, nch = detail::common(out, in); ch != nch; ++ch)
+            gain(detail::data(out, ch), detail::data(in, ch), g, scale, n);
+      }
+
+      inline void gain_ramp(out_channels const& out, in_channels const& in, float from, float to)
+      {
+         auto n = detail::frames(out);
+         for (std::size_t ch = 0, nch = detail::common(out, in); ch != nch; ++ch)
+            gain_ramp(detail::data(out, ch), detail::data(in, ch), from, to, n);
+      }
+
+      inline void mix(out_channels const& out, in_channels const& in, float g)
+      {
+         auto n = detail::frames(out);
+         for (std::size_t ch = 0, nch = detail::common(out, in); ch != nch; ++ch)
+            mix(detail::data(out, ch), detail::data(in, ch), g, n);
+      }
+
+      inline void clear(out_channels const& out)
+      {
+         auto n = detail::frames(out);
+         for (std::size_t ch = 0; ch != out.size(); ++ch)
+            clear(detail::data(out, ch), n);
+      }
+   }
+}
+
+#endif
@@ -0,0 +1,180 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_LOAD_METER_HPP_NOVEMBER_13_2019)
+#define QPLUG_LOAD_METER_HPP_NOVEMBER_13_2019
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // DSP load statistics. Loads are percentages of the block's deadline
+   // (frames / sps): 100 means the block took all the time it had.
+   ////////////////////////////////////////////////////////////////////////////
+   struct load_stats
+   {
+      double                  current = 0;   // The last block
+      double                  min = 0;
+      double                  avg = 0;
+      double                  max = 0;
+      double                  p99 = 0;
+      std::uint64_t           blocks = 0;
+      std::uint64_t           overruns = 0;  // Blocks over 100%
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // load_meter: Per-block DSP load, with a histogram of 1% bins (the last
+   // bin collects everything from 200% up). The audio thread is the only
+   // writer; any other thread may read, without locks. Readers see each
+   // value atomically, but not the whole meter at once, so stats taken
+   // while the audio is running may be off by a block.
+   ////////////////////////////////////////////////////////////////////////////
+   class load_meter
+   {
+   public:
+
+      static constexpr std::size_t num_bins = 201;
+
+                              load_meter() = default;
+                              load_meter(load_meter const&) = delete;
+
+      // Audio thread: record a block that took elapsed seconds, out of
+      // deadline seconds.
+      void                    record(double elapsed, double deadline);
+
+      // Any thread. The statistics are cleared by the next record.
+      void                    reset();
+
+      load_stats              stats() const;
+      double                  current() const;
+      double                  percentile(double p) const;
+      std::uint64_t           bin(std::size_t i) const;
+
+   private:
+
+      using counter = std::atomic<std::uint64_t>;
+
+      // Loads are kept in thousandths of a percent
+      static constexpr double scale = 1000.0;
+
+      void                    clear();
+      double                  percentile(double p, std::uint64_t blocks) const;
+
+      counter                 _bins[num_bins] = {};
+      counter                 _blocks{ 0 };
+      counter                 _overruns{ 0 };
+      counter                 _sum{ 0 };
+      std::atomic<std::uint32_t> _current{ 0 };
+      std::atomic<std::uint32_t> _min{ std::numeric_limits<std::uint32_t>::max() };
+      std::atomic<std::uint32_t> _max{ 0 };
+      std::atomic<bool>       _reset{ false };
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   inline void load_meter::record(double elapsed, double deadline)
+   {
+      if (deadline <= 0)
+         return;
+
+      if (_reset.exchange(false, std::memory_order_acquire))
+         clear();
+
+      // Single writer: plain loads and stores, no read-modify-write
+      constexpr auto relaxed = std::memory_order_relaxed;
+      double load = (elapsed / deadline) * 100.0;
+      constexpr double limit = std::numeric_limits<std::uint32_t>::max() / scale;
+      auto value = std::uint32_t(((load < limit)? load : limit) * scale);
+
+      auto i = std::size_t(load);
+      auto& bin = _bins[(i < num_bins)? i : num_bins-1];
+      bin.store(bin.load(relaxed) + 1, relaxed);
+
+      _current.store(value, relaxed);
+      _sum.store(_sum.load(relaxed) + value, relaxed);
+      if (value < _min.load(relaxed))
+         _min.store(value, relaxed);
+      if (value > _max.load(relaxed))
+         _max.store(value, relaxed);
+      if (load > 100.0)
+         _overruns.store(_overruns.load(relaxed) + 1, relaxed);
+      _blocks.store(_blocks.load(relaxed) + 1, std::memory_order_release);
+   }
+
+   inline void load_meter::reset()
+   {
+      _reset.store(true, std::memory_order_release);
+   }
+
+   inline void load_meter::clear()
+   {
+      constexpr auto relaxed = std::memory_order_relaxed;
+      for (auto& bin : _bins)
+         bin.store(0, relaxed);
+      _overruns.store(0, relaxed);
+      _sum.store(0, relaxed);
+      _current.store(0, relaxed);
+      _min.store(std::numeric_limits<std::uint32_t>::max(), relaxed);
+      _max.store(0, relaxed);
+      _blocks.store(0, std::memory_order_release);
+   }
+
+   inline load_stats load_meter::stats() const
+   {
+      constexpr auto relaxed = std::memory_order_relaxed;
+      load_stats s;
+      s.blocks = _blocks.load(std::memory_order_acquire);
+      if (s.blocks == 0)
+         return s;
+
+      s.current = _current.load(relaxed) / scale;
+      s.min = _min.load(relaxed) / scale;
+      s.max = _max.load(relaxed) / scale;
+      s.avg = (_sum.load(relaxed) / scale) / s.blocks;
+      s.p99 = percentile(0.99, s.blocks);
+      s.overruns = _overruns.load(relaxed);
+      return s;
+   }
+
+   inline double load_meter::current() const
+   {
+      return _current.load(std::memory_order_relaxed) / scale;
+   }
+
+   inline double load_meter::percentile(double p) const
+   {
+      return percentile(p, _blocks.load(std::memory_order_acquire));
+   }
+
+   inline double load_meter::percentile(double p, std::uint64_t blocks) const
+   {
+      if (blocks == 0)
+         return 0;
+
+      // The upper edge of the bin holding the p-th block, capped by the max
+      auto max = _max.load(std::memory_order_relaxed) / scale;
+      auto rank = std::uint64_t(p * blocks + 0.5);
+      std::uint64_t count = 0;
+      for (std::size_t i = 0; i != num_bins-1; ++i)
+      {
+         count += _bins[i].load(std::memory_order_relaxed);
+         if (count >= rank)
+            return (i+1 < max)? i+1 : max;
+      }
+      return max;
+   }
+
+   inline std::uint64_t load_meter::bin(std::size_t i) const
+   {
+      return _bins[i].load(std::memory_order_relaxed);
+   }
+}
+
+#endif
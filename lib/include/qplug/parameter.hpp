@@ -12,6 +12,7 @@
 
 #include <ostream>
 #include <iomanip>
+#include <vector>
 
 namespace cycfi::qplug
 {
@@ -119,6 +120,22 @@ namespace cycfi::qplug
          return r;
       }
 
+      // Smooth changes over the given time in milliseconds. The processor
+      // gets a per-block ramp for the parameter (see processor::smoothed).
+      constexpr parameter smooth(double ms) const
+      {
+         parameter r = *this;
+         r._smooth = ms;
+         return r;
+      }
+
+      // The initial value as the backends and the processor see it. Notes
+      // are enumerations starting at 0 (the _min note).
+      constexpr double init_value() const
+      {
+         return (_type == note)? _init - _min : _init;
+      }
+
       void print(std::ostream& out, double val) const
       {
          switch (_type)
@@ -148,9 +165,21 @@ namespace cycfi::qplug
       double         _step = 0.001;
       double         _curve = 1.0;
       char const*    _unit = "";
+      double         _smooth = 0.0;
       bool           _can_automate = true;
       bool           _save_in_preset = true;
    };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // A batch of parameter values (e.g. a preset being recalled)
+   ////////////////////////////////////////////////////////////////////////////
+   struct parameter_value
+   {
+      int            id;
+      double         value;
+   };
+
+   using parameter_value_list = std::vector<parameter_value>;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,214 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_PARAMETER_MORPH_HPP_NOVEMBER_26_2019)
+#define QPLUG_PARAMETER_MORPH_HPP_NOVEMBER_26_2019
+
+#include <qplug/parameter.hpp>
+#include <infra/iterator_range.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // parameter_morph: Moves the parameters from one set of values to
+   // another, on the audio thread, over a given time or along a position
+   // (e.g. a host-automatable morph parameter).
+   //
+   // A morph is set up on another thread (e.g. the UI) with the start and
+   // end values of every parameter, in a buffer the audio thread does not
+   // use, and handed over lock-free. Each block, update computes the
+   // values of the parameters that differ. Continuous parameters (double
+   // and frequency) are interpolated linearly; bool, int and note
+   // parameters switch from start to end at the switch point.
+   //
+   // Each morph gets an id from start. Once a timed morph gets to its end,
+   // done gives its id, so that the end values can be published elsewhere
+   // (see controller::morph_preset).
+   ////////////////////////////////////////////////////////////////////////////
+   class parameter_morph
+   {
+   public:
+
+      using parameter_list = iterator_range<parameter const*>;
+
+                              parameter_morph() = default;
+                              parameter_morph(parameter_morph const&) = delete;
+
+      // Not realtime safe
+      void                    reset(parameter_list params);
+
+      // One thread at a time (e.g. the UI). ms == 0 morphs along position.
+      std::uint32_t           start(
+                                 std::vector<double> const& from
+                               , std::vector<double> const& to
+                               , double ms
+                               , double switch_point = 0.5
+                              );
+      void                    stop();
+
+      // Audio thread. position is from 0 (from) to 1 (to).
+      void                    position(double pos) { _position = std::clamp(pos, 0.0, 1.0); }
+      bool                    active() const       { return _active; }
+
+      // Any thread: the id of the last timed morph that got to its end
+      std::uint32_t           done() const { return _done.load(std::memory_order_acquire); }
+
+      // Audio thread: f(id, value) for each parameter being morphed, once
+      // per block while the morph moves
+                              template <typename F>
+      void                    update(std::size_t frames, std::uint32_t sps, F&& f);
+
+   private:
+
+      enum command { none, start_, stop_ };
+
+      struct slot
+      {
+         std::vector<double>  from;
+         std::vector<double>  to;
+         std::vector<int>     ids;     // The parameters that differ
+         double               ms = 0.0;
+         double               switch_point = 0.5;
+         command              cmd = none;
+         std::uint32_t        id = 0;
+      };
+
+      void                    publish();
+
+      // A triple buffer: the writer fills _back, then swaps it with the
+      // ready slot, flagged as fresh. The audio thread swaps the ready
+      // slot with _front when it is fresh.
+      static constexpr int    fresh = 4;
+
+      slot                    _slots[3];
+      std::atomic<int>        _ready{ 1 };
+      int                     _back = 0;
+      int                     _front = 2;
+      std::uint32_t           _started = 0;
+      std::atomic<std::uint32_t> _done{ 0 };
+
+      std::vector<bool>       _discrete;
+      double                  _position = 0.0;
+      double                  _elapsed = 0.0;
+      double                  _last = -1.0;
+      bool                    _active = false;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   inline void parameter_morph::reset(parameter_list params)
+   {
+      _discrete.clear();
+      for (auto const& param : params)
+      {
+         _discrete.push_back(
+            param._type != parameter::double_ && param._type != parameter::frequency);
+      }
+
+      for (auto& s : _slots)
+      {
+         s.from.assign(params.size(), 0.0);
+         s.to.assign(params.size(), 0.0);
+         s.ids.clear();
+         s.ids.reserve(params.size());
+         s.cmd = none;
+      }
+      _ready.store(1, std::memory_order_relaxed);
+      _back = 0;
+      _front = 2;
+      _active = false;
+   }
+
+   inline std::uint32_t parameter_morph::start(
+      std::vector<double> const& from
+    , std::vector<double> const& to
+    , double ms
+    , double switch_point
+   )
+   {
+      auto& s = _slots[_back];
+      auto n = std::min({ from.size(), to.size(), s.from.size() });
+      s.ids.clear();
+      for (std::size_t i = 0; i != n; ++i)
+      {
+         s.from[i] = from[i];
+         s.to[i] = to[i];
+         if (from[i] != to[i])
+            s.ids.push_back(int(i));
+      }
+      s.ms = std::max(ms, 0.0);
+      s.switch_point = switch_point;
+      s.cmd = start_;
+      s.id = ++_started;
+      publish();
+      return s.id;
+   }
+
+   inline void parameter_morph::stop()
+   {
+      _slots[_back].cmd = stop_;
+      publish();
+   }
+
+   inline void parameter_morph::publish()
+   {
+      _back = _ready.exchange(_back | fresh, std::memory_order_acq_rel) & ~fresh;
+   }
+
+   template <typename F>
+   inline void parameter_morph::update(std::size_t frames, std::uint32_t sps, F&& f)
+   {
+      if (_ready.load(std::memory_order_relaxed) & fresh)
+      {
+         _front = _ready.exchange(_front, std::memory_order_acq_rel) & ~fresh;
+         auto const& s = _slots[_front];
+         _active = s.cmd == start_;
+         _elapsed = 0.0;
+         _last = -1.0;
+      }
+
+      if (!_active)
+         return;
+
+      auto const& s = _slots[_front];
+      double t = _position;
+      if (s.ms > 0.0)
+      {
+         auto duration = (s.ms * sps) / 1000;
+         t = (duration > 0.0)? std::min(_elapsed / duration, 1.0) : 1.0;
+         _elapsed += frames;
+      }
+
+      if (t == _last)
+         return;
+      _last = t;
+
+      for (auto id : s.ids)
+      {
+         auto from = s.from[id];
+         auto to = s.to[id];
+         if (_discrete[id])
+            f(id, (t < s.switch_point)? from : to);
+         else
+            f(id, from + (to - from) * t);
+      }
+
+      // A timed morph is done once it gets there
+      if (s.ms > 0.0 && t == 1.0)
+      {
+         _active = false;
+         _done.store(s.id, std::memory_order_release);
+      }
+   }
+}
+
+#endif
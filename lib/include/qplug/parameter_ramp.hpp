@@ -0,0 +1,146 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_PARAMETER_RAMP_HPP_NOVEMBER_6_2019)
+#define QPLUG_PARAMETER_RAMP_HPP_NOVEMBER_6_2019
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // parameter_ramp: Block-rate linear smoothing for a parameter. Each block,
+   // update(frames) produces a contiguous buffer of per-frame values while
+   // the value is moving towards its target. Once the target is reached,
+   // the ramp is constant and update does no work at all; check constant()
+   // and use value() for the fast path.
+   //
+   // The buffer is allocated by config, and update never allocates. A
+   // change within the block (a sample accurate event) restarts the ramp
+   // at its frame, from the value the ramp had there.
+   ////////////////////////////////////////////////////////////////////////////
+   class parameter_ramp
+   {
+   public:
+
+      void                    config(double ms, std::uint32_t sps, std::size_t max_frames);
+      void                    target(double value);
+      void                    target(double value, std::size_t frame);
+      void                    jump(double value);
+      void                    update(std::size_t frames);
+
+      bool                    smoothed() const  { return _ramp_frames != 0; }
+      bool                    constant() const  { return _constant; }
+      float                   value() const     { return _value; }
+      float const*            data() const      { return _buffer.data(); }
+      float                   operator[](std::size_t i) const;
+
+   private:
+
+      void                    fill(std::size_t first);
+
+      float                   _value = 0.0f;
+      float                   _start = 0.0f;
+      float                   _target = 0.0f;
+      float                   _step = 0.0f;
+      std::size_t             _ramp_frames = 0;
+      std::size_t             _remaining = 0;
+      std::size_t             _frames = 0;
+      bool                    _constant = true;
+      std::vector<float>      _buffer;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   inline void parameter_ramp::config(double ms, std::uint32_t sps, std::size_t max_frames)
+   {
+      _ramp_frames = std::size_t((ms * sps) / 1000);
+      _buffer.resize(_ramp_frames? max_frames : 0);
+      _frames = 0;
+      jump(_target);
+   }
+
+   inline void parameter_ramp::target(double value)
+   {
+      _target = value;
+      if (_ramp_frames == 0)
+      {
+         _value = _target;
+         return;
+      }
+      _remaining = _ramp_frames;
+      _step = (_target - _value) / _remaining;
+   }
+
+   inline void parameter_ramp::target(double value, std::size_t frame)
+   {
+      // At or past the end of the block, the ramp starts with the next one
+      if (_ramp_frames == 0 || frame >= _frames)
+      {
+         target(value);
+         return;
+      }
+
+      // Restart from the value the ramp has at frame
+      auto from = frame? (*this)[frame - 1] : _start;
+      if (_constant)
+      {
+         std::fill(_buffer.begin(), _buffer.begin() + frame, _value);
+         _constant = false;
+      }
+      _value = from;
+      target(value);
+      fill(frame);
+   }
+
+   inline void parameter_ramp::jump(double value)
+   {
+      _value = _start = _target = value;
+      _remaining = 0;
+      _constant = true;
+   }
+
+   inline void parameter_ramp::update(std::size_t frames)
+   {
+      // Should not happen: hosts do not exceed the maximum block size. We
+      // don't allocate here; the value jumps to its target instead.
+      if (frames > _buffer.size())
+      {
+         jump(_target);
+         _frames = 0;
+         return;
+      }
+
+      _frames = frames;
+      _start = _value;
+      _constant = _remaining == 0;
+      if (!_constant)
+         fill(0);
+   }
+
+   inline void parameter_ramp::fill(std::size_t first)
+   {
+      auto n = std::min(_frames - first, _remaining);
+      auto value = _value;
+      for (std::size_t i = first; i != first + n; ++i)
+         _buffer[i] = value += _step;
+
+      _remaining -= n;
+      _value = (_remaining == 0)? _target : value;
+      for (std::size_t i = first + n; i != _frames; ++i)
+         _buffer[i] = _value;
+   }
+
+   inline float parameter_ramp::operator[](std::size_t i) const
+   {
+      return _constant? _value : _buffer[i];
+   }
+}
+
+#endif
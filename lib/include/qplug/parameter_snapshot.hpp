@@ -0,0 +1,229 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_PARAMETER_SNAPSHOT_HPP_NOVEMBER_14_2019)
+#define QPLUG_PARAMETER_SNAPSHOT_HPP_NOVEMBER_14_2019
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // parameter_snapshot: Parameter values shared between the threads that
+   // change parameters (UI, preset recall, the host) and the audio thread.
+   //
+   // Writers publish values into a shared array of atomics and flag them in
+   // a shared changed bitset. Once per block, the audio thread acquires the
+   // flagged values into its own array, which process reads without any
+   // synchronization, along with the set of parameters that changed.
+   // Publishing and acquiring are lock-free and never allocate.
+   //
+   // Each value is published atomically. Values published together by a
+   // writer may be split across two blocks, unless they are published in a
+   // batch (between begin_batch and end_batch): the audio thread does not
+   // acquire anything while a batch is being published, and puts back what
+   // it acquired if a batch started meanwhile.
+   ////////////////////////////////////////////////////////////////////////////
+   class parameter_snapshot
+   {
+   public:
+
+                              parameter_snapshot() = default;
+                              parameter_snapshot(parameter_snapshot const&) = delete;
+
+      // Not realtime safe. Sets all values; none is flagged as changed.
+      void                    reset(std::vector<double> const& values);
+
+      // Any thread
+      void                    publish(int id, double value);
+      void                    begin_batch();
+      void                    end_batch();
+
+      // Audio thread: f(id, value) for each value published since the last
+      // acquire. f is expected to assign the value.
+                              template <typename F>
+      void                    acquire(F&& f);
+
+      // Audio thread: set the value of id and flag it as changed
+      void                    assign(int id, double value);
+      void                    clear_changed();
+
+      std::size_t             size() const            { return _values.size(); }
+      double const*           values() const          { return _values.data(); }
+      double                  operator[](int id) const { return _values[id]; }
+
+      bool                    changed(int id) const;
+      bool                    any_changed() const     { return _any_changed; }
+
+      // f(id) for each changed parameter, in id order
+                              template <typename F>
+      void                    for_each_changed(F&& f) const;
+
+   private:
+
+      using word = std::uint64_t;
+      static constexpr std::size_t word_bits = 64;
+
+      template <typename F>
+      static void             for_each_bit(word bits, std::size_t base, F&& f);
+
+      using shared_values = std::unique_ptr<std::atomic<double>[]>;
+      using shared_bits = std::unique_ptr<std::atomic<word>[]>;
+
+      shared_values           _published;
+      shared_bits             _published_bits;
+      std::atomic<int>        _batches_open{ 0 };
+      std::atomic<std::uint32_t> _batches_begun{ 0 };
+      std::vector<double>     _values;
+      std::vector<word>       _changed;
+      std::vector<double>     _acquired;
+      std::vector<word>       _taken;
+      bool                    _any_changed = false;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   inline void parameter_snapshot::reset(std::vector<double> const& values)
+   {
+      auto num_words = (values.size() + word_bits - 1) / word_bits;
+      _published = std::make_unique<std::atomic<double>[]>(values.size());
+      _published_bits = std::make_unique<std::atomic<word>[]>(num_words);
+      for (std::size_t i = 0; i != values.size(); ++i)
+         _published[i].store(values[i], std::memory_order_relaxed);
+      for (std::size_t i = 0; i != num_words; ++i)
+         _published_bits[i].store(0, std::memory_order_relaxed);
+
+      _values = values;
+      _changed.assign(num_words, 0);
+      _acquired = values;
+      _taken.assign(num_words, 0);
+      _any_changed = false;
+   }
+
+   inline void parameter_snapshot::publish(int id, double value)
+   {
+      if (std::size_t(id) >= _values.size())
+         return;
+
+      // The release makes the value visible to the acquire that sees the bit
+      _published[id].store(value, std::memory_order_relaxed);
+      _published_bits[id / word_bits].fetch_or(
+         word(1) << (id % word_bits), std::memory_order_release);
+   }
+
+   inline void parameter_snapshot::begin_batch()
+   {
+      // Open first: the audio thread that sees the batch begun sees it open.
+      // The fence orders the begin before the values (see acquire).
+      _batches_open.fetch_add(1, std::memory_order_relaxed);
+      _batches_begun.fetch_add(1, std::memory_order_release);
+      std::atomic_thread_fence(std::memory_order_release);
+   }
+
+   inline void parameter_snapshot::end_batch()
+   {
+      _batches_open.fetch_sub(1, std::memory_order_release);
+   }
+
+   template <typename F>
+   inline void parameter_snapshot::acquire(F&& f)
+   {
+      auto begun = _batches_begun.load(std::memory_order_acquire);
+      if (_batches_open.load(std::memory_order_acquire) != 0)
+         return;  // Next block
+
+      bool any = false;
+      for (std::size_t w = 0; w != _taken.size(); ++w)
+      {
+         auto& shared = _published_bits[w];
+         _taken[w] = 0;
+         if (shared.load(std::memory_order_relaxed) == 0)
+            continue;
+
+         _taken[w] = shared.exchange(0, std::memory_order_acquire);
+         for_each_bit(_taken[w], w * word_bits,
+            [&](std::size_t id)
+            {
+               _acquired[id] = _published[id].load(std::memory_order_relaxed);
+               any = true;
+            }
+         );
+      }
+
+      if (!any)
+         return;
+
+      // If we read anything written by a batch that began after we looked,
+      // the fence makes the begin visible here. Put it all back for the
+      // next block, where the whole batch will be acquired.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (_batches_begun.load(std::memory_order_relaxed) != begun)
+      {
+         for (std::size_t w = 0; w != _taken.size(); ++w)
+         {
+            if (_taken[w])
+               _published_bits[w].fetch_or(_taken[w], std::memory_order_release);
+         }
+         return;
+      }
+
+      for (std::size_t w = 0; w != _taken.size(); ++w)
+      {
+         for_each_bit(_taken[w], w * word_bits,
+            [&](std::size_t id) { f(int(id), _acquired[id]); });
+      }
+   }
+
+   inline void parameter_snapshot::assign(int id, double value)
+   {
+      if (std::size_t(id) >= _values.size())
+         return;
+      _values[id] = value;
+      _changed[id / word_bits] |= word(1) << (id % word_bits);
+      _any_changed = true;
+   }
+
+   inline void parameter_snapshot::clear_changed()
+   {
+      if (!_any_changed)
+         return;
+      for (auto& bits : _changed)
+         bits = 0;
+      _any_changed = false;
+   }
+
+   inline bool parameter_snapshot::changed(int id) const
+   {
+      if (std::size_t(id) >= _values.size())
+         return false;
+      return (_changed[id / word_bits] >> (id % word_bits)) & 1;
+   }
+
+   template <typename F>
+   inline void parameter_snapshot::for_each_changed(F&& f) const
+   {
+      if (!_any_changed)
+         return;
+      for (std::size_t w = 0; w != _changed.size(); ++w)
+         for_each_bit(_changed[w], w * word_bits, [&](std::size_t id) { f(int(id)); });
+   }
+
+   template <typename F>
+   inline void parameter_snapshot::for_each_bit(word bits, std::size_t base, F&& f)
+   {
+      for (auto id = base; bits != 0; bits >>= 1, ++id)
+      {
+         if (bits & 1)
+            f(id);
+      }
+   }
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_PARAMETER_TABLE_HPP_NOVEMBER_5_2019)
+#define QPLUG_PARAMETER_TABLE_HPP_NOVEMBER_5_2019
+
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+namespace cycfi::qplug
+{
+   namespace detail
+   {
+      template <std::size_t I, typename T>
+      struct binding_leaf
+      {
+         T _binding;
+      };
+
+      // Flat (non-recursive) storage for the bindings. Unlike std::tuple,
+      // this does not hit template recursion limits with thousands of
+      // parameters.
+      template <typename Indices, typename... T>
+      struct binding_storage;
+
+      template <std::size_t... I, typename... T>
+      struct binding_storage<std::index_sequence<I...>, T...>
+       : binding_leaf<I, T>...
+      {
+         constexpr binding_storage(T... bindings)
+          : binding_leaf<I, T>{ bindings }...
+         {}
+      };
+
+      template <std::size_t I, typename T>
+      constexpr T const& get_binding(binding_leaf<I, T> const& leaf)
+      {
+         return leaf._binding;
+      }
+
+      template <typename Derived, typename T>
+      inline void apply_binding(T const& binding, Derived& self, double value)
+      {
+         if constexpr(std::is_member_function_pointer<T>::value)
+         {
+            (self.*binding)(value);
+         }
+         else if constexpr(std::is_member_object_pointer<T>::value)
+         {
+            auto& var = self.*binding;
+            if constexpr(std::is_same<std::decay_t<decltype(var)>, bool>::value)
+               var = value > 0.5;
+            else
+               var = value;
+         }
+         else if constexpr(std::is_invocable<T const&, Derived&, double>::value)
+         {
+            binding(self, value);
+         }
+         else
+         {
+            binding(value);
+         }
+      }
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // A binding in a parameter_table's jump table. self is the Derived
+   // object the table was made for.
+   ////////////////////////////////////////////////////////////////////////////
+   struct parameter_binding
+   {
+      void                    (*apply)(void const* binding, void* self, double value);
+      void const*             binding;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // parameter_table: A compile-time parameter dispatch table. Each binding
+   // is one of:
+   //
+   //    1. A pointer to a data member of Derived (e.g. &my_processor::_gain)
+   //    2. A pointer to a member function of Derived taking the value
+   //    3. A callable f(Derived& self, double value)
+   //    4. A callable f(double value) (e.g. ignore_parameter)
+   //
+   // The bindings are stored by value without type erasure, and dispatch is
+   // a single jump through a table keyed by id. Bindings of the same type
+   // share the same jump target, which keeps the jump predictable however
+   // the ids come (a switch with each binding inlined in its own case is
+   // slower when many parameters change). Nothing is ever allocated.
+   //
+   // The table refers to its own bindings, so it can't be copied. Declare
+   // it constexpr at namespace scope, after the processor (whose members
+   // can't be named in its own class body):
+   //
+   //    constexpr auto my_params = qplug::make_parameter_table<my_processor>(
+   //       &my_processor::_gain, &my_processor::set_cutoff
+   //    );
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename Derived, typename... T>
+   class parameter_table
+   {
+   public:
+
+      static constexpr std::size_t size = sizeof...(T);
+
+      constexpr               parameter_table(T... bindings)
+                               : parameter_table(std::index_sequence_for<T...>{}, bindings...)
+                              {}
+
+                              parameter_table(parameter_table const&) = delete;
+
+      bool                    dispatch(Derived& self, int id, double value) const;
+
+      // The jump table, size entries keyed by id (see processor::parameters)
+      parameter_binding const* bindings() const { return _jump_table.data(); }
+
+   private:
+
+      using storage = detail::binding_storage<std::index_sequence_for<T...>, T...>;
+
+                              template <std::size_t... I>
+      constexpr               parameter_table(std::index_sequence<I...>, T... bindings);
+
+                              template <typename B>
+      static void             apply(void const* binding, void* self, double value);
+
+      using jump_table = std::array<parameter_binding, size>;
+
+      storage                 _bindings;
+      jump_table              _jump_table;
+   };
+
+   template <typename Derived, typename... T>
+   constexpr parameter_table<Derived, T...>
+   make_parameter_table(T... bindings)
+   {
+      return { bindings... };
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename Derived, typename... T>
+   template <std::size_t... I>
+   constexpr parameter_table<Derived, T...>::parameter_table(
+      std::index_sequence<I...>, T... bindings)
+    : _bindings(bindings...)
+    , _jump_table{ parameter_binding{ &apply<T>, &detail::get_binding<I>(_bindings) }... }
+   {}
+
+   template <typename Derived, typename... T>
+   template <typename B>
+   inline void parameter_table<Derived, T...>::apply(
+      void const* binding, void* self, double value)
+   {
+      detail::apply_binding(
+         *static_cast<B const*>(binding), *static_cast<Derived*>(self), value);
+   }
+
+   template <typename Derived, typename... T>
+   inline bool parameter_table<Derived, T...>::dispatch(
+      Derived& self, int id, double value) const
+   {
+      if (id < 0 || std::size_t(id) >= size)
+         return false;
+      auto const& e = _jump_table[id];
+      e.apply(e.binding, &self, value);
+      return true;
+   }
+}
+
+#endif
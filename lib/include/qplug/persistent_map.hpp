@@ -0,0 +1,242 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_PERSISTENT_MAP_HPP_DECEMBER_4_2019)
+#define QPLUG_PERSISTENT_MAP_HPP_DECEMBER_4_2019
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // persistent_map: A sorted map whose copies share their nodes. The
+   // nodes (an AVL tree) are immutable: set and erase copy the O(log n)
+   // nodes on the path to the key, and leave the rest shared with the
+   // copies. Copying is O(1).
+   //
+   // A map is not thread safe, but copies are independent: one thread may
+   // change a map while others read its copies (e.g. in a published
+   // snapshot).
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename K, typename V, typename Compare = std::less<>>
+   class persistent_map
+   {
+   public:
+
+      bool                    empty() const           { return !_root; }
+      std::size_t             size() const            { return _size; }
+      void                    clear()                 { _root.reset(); _size = 0; }
+
+      // The value of the key, or nullptr if there is none
+                              template <typename Key>
+      V const*                find(Key const& key) const;
+
+      // Add the key, or replace its value
+      void                    set(K const& key, V value);
+      bool                    erase(K const& key);
+
+      // f(key, value) for each entry, sorted by key
+                              template <typename F>
+      void                    for_each(F&& f) const;
+
+   private:
+
+      struct node;
+      using node_ptr = std::shared_ptr<node const>;
+
+      struct node
+      {
+         K                    key;
+         V                    value;
+         node_ptr             left;
+         node_ptr             right;
+         int                  height;
+      };
+
+      static int              height(node_ptr const& n) { return n? n->height : 0; }
+      static node_ptr         make(K const& key, V const& value, node_ptr left, node_ptr right);
+      static node_ptr         balance(K const& key, V const& value, node_ptr left, node_ptr right);
+      static node_ptr         insert(node_ptr const& n, K const& key, V& value, bool& added);
+      static node_ptr         remove(node_ptr const& n, K const& key, bool& removed);
+      static node_ptr         remove_min(node_ptr const& n, node_ptr& min);
+
+                              template <typename F>
+      static void             visit(node_ptr const& n, F& f);
+
+      node_ptr                _root;
+      std::size_t             _size = 0;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename K, typename V, typename Compare>
+   template <typename Key>
+   inline V const* persistent_map<K, V, Compare>::find(Key const& key) const
+   {
+      Compare less;
+      for (auto n = _root.get(); n;)
+      {
+         if (less(key, n->key))
+            n = n->left.get();
+         else if (less(n->key, key))
+            n = n->right.get();
+         else
+            return &n->value;
+      }
+      return nullptr;
+   }
+
+   template <typename K, typename V, typename Compare>
+   inline void persistent_map<K, V, Compare>::set(K const& key, V value)
+   {
+      bool added = false;
+      _root = insert(_root, key, value, added);
+      if (added)
+         ++_size;
+   }
+
+   template <typename K, typename V, typename Compare>
+   inline bool persistent_map<K, V, Compare>::erase(K const& key)
+   {
+      bool removed = false;
+      _root = remove(_root, key, removed);
+      if (removed)
+         --_size;
+      return removed;
+   }
+
+   template <typename K, typename V, typename Compare>
+   template <typename F>
+   inline void persistent_map<K, V, Compare>::for_each(F&& f) const
+   {
+      visit(_root, f);
+   }
+
+   template <typename K, typename V, typename Compare>
+   template <typename F>
+   inline void persistent_map<K, V, Compare>::visit(node_ptr const& n, F& f)
+   {
+      if (!n)
+         return;
+      visit(n->left, f);
+      f(n->key, n->value);
+      visit(n->right, f);
+   }
+
+   template <typename K, typename V, typename Compare>
+   inline typename persistent_map<K, V, Compare>::node_ptr
+   persistent_map<K, V, Compare>::make(
+      K const& key, V const& value, node_ptr left, node_ptr right)
+   {
+      auto h = 1 + std::max(height(left), height(right));
+      return std::make_shared<node const>(
+         node{ key, value, std::move(left), std::move(right), h });
+   }
+
+   template <typename K, typename V, typename Compare>
+   inline typename persistent_map<K, V, Compare>::node_ptr
+   persistent_map<K, V, Compare>::balance(
+      K const& key, V const& value, node_ptr left, node_ptr right)
+   {
+      // The heights of left and right differ by 2 at most
+      if (height(left) > height(right) + 1)
+      {
+         if (height(left->left) >= height(left->right))
+         {
+            return make(left->key, left->value, left->left
+             , make(key, value, left->right, std::move(right)));
+         }
+         auto const& lr = left->right;
+         return make(lr->key, lr->value
+          , make(left->key, left->value, left->left, lr->left)
+          , make(key, value, lr->right, std::move(right)));
+      }
+
+      if (height(right) > height(left) + 1)
+      {
+         if (height(right->right) >= height(right->left))
+         {
+            return make(right->key, right->value
+             , make(key, value, std::move(left), right->left), right->right);
+         }
+         auto const& rl = right->left;
+         return make(rl->key, rl->value
+          , make(key, value, std::move(left), rl->left)
+          , make(right->key, right->value, rl->right, right->right));
+      }
+
+      return make(key, value, std::move(left), std::move(right));
+   }
+
+   template <typename K, typename V, typename Compare>
+   inline typename persistent_map<K, V, Compare>::node_ptr
+   persistent_map<K, V, Compare>::insert(
+      node_ptr const& n, K const& key, V& value, bool& added)
+   {
+      if (!n)
+      {
+         added = true;
+         return make(key, value, nullptr, nullptr);
+      }
+
+      Compare less;
+      if (less(key, n->key))
+         return balance(n->key, n->value, insert(n->left, key, value, added), n->right);
+      if (less(n->key, key))
+         return balance(n->key, n->value, n->left, insert(n->right, key, value, added));
+      return make(n->key, value, n->left, n->right);
+   }
+
+   template <typename K, typename V, typename Compare>
+   inline typename persistent_map<K, V, Compare>::node_ptr
+   persistent_map<K, V, Compare>::remove(
+      node_ptr const& n, K const& key, bool& removed)
+   {
+      if (!n)
+         return n;
+
+      Compare less;
+      if (less(key, n->key))
+      {
+         auto left = remove(n->left, key, removed);
+         return removed? balance(n->key, n->value, std::move(left), n->right) : n;
+      }
+      if (less(n->key, key))
+      {
+         auto right = remove(n->right, key, removed);
+         return removed? balance(n->key, n->value, n->left, std::move(right)) : n;
+      }
+
+      removed = true;
+      if (!n->left)
+         return n->right;
+      if (!n->right)
+         return n->left;
+
+      // Replace the node with the smallest of its right subtree
+      node_ptr min;
+      auto right = remove_min(n->right, min);
+      return balance(min->key, min->value, n->left, std::move(right));
+   }
+
+   template <typename K, typename V, typename Compare>
+   inline typename persistent_map<K, V, Compare>::node_ptr
+   persistent_map<K, V, Compare>::remove_min(node_ptr const& n, node_ptr& min)
+   {
+      if (!n->left)
+      {
+         min = n;
+         return n->right;
+      }
+      return balance(n->key, n->value, remove_min(n->left, min), n->right);
+   }
+}
+
+#endif
@@ -0,0 +1,219 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_PLUGIN_STATE_HPP_NOVEMBER_15_2019)
+#define QPLUG_PLUGIN_STATE_HPP_NOVEMBER_15_2019
+
+#include <qplug/parameter.hpp>
+#include <infra/iterator_range.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // Binary plugin state. The parameters are saved as:
+   //
+   //    magic       uint32            state_magic
+   //    version     uint32            state_version
+   //    count       uint32            number of parameters
+   //    ids         uint64 x count    parameter ids (see parameter_hash)
+   //    values      double x count    plain values, in the same order
+   //
+   // followed by the controller's state. Parameters are matched by id, so
+   // parameters may be added, removed or reordered between versions of a
+   // plugin, as long as they keep their names.
+   //
+   // The legacy format (an int count, then name and value pairs) is still
+   // read. The magic, as an int, is negative, so it can never be mistaken
+   // for a legacy count. The legacy format is also written in the unlikely
+   // case that two parameter names have the same id.
+   ////////////////////////////////////////////////////////////////////////////
+   constexpr std::uint32_t state_magic = 0xF1A75A7E;
+   constexpr std::uint32_t state_version = 1;
+
+   // 64-bit FNV-1a hash of the parameter name
+   constexpr std::uint64_t parameter_hash(std::string_view name)
+   {
+      std::uint64_t h = 0xcbf29ce484222325;
+      for (auto c : name)
+      {
+         h ^= std::uint8_t(c);
+         h *= 0x100000001b3;
+      }
+      return h;
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // parameter_index: Maps parameter ids and names to parameter indices
+   // in constant time (open addressing, at most half full).
+   ////////////////////////////////////////////////////////////////////////////
+   class parameter_index
+   {
+   public:
+
+      using parameter_list = iterator_range<parameter const*>;
+
+                              parameter_index() = default;
+      explicit                parameter_index(parameter_list params);
+
+      std::size_t             size() const            { return _ids.size(); }
+      std::uint64_t           id(int index) const     { return _ids[index]; }
+      char const*             name(int index) const   { return _names[index]; }
+      bool                    unique() const          { return _unique; }
+
+      // The index of the parameter, or -1 if not found
+      int                     find(std::uint64_t id) const;
+      int                     find(std::string_view name) const;
+
+   private:
+
+      struct slot
+      {
+         std::uint64_t        id;
+         int                  index;   // -1 if empty
+      };
+
+      std::vector<std::uint64_t> _ids;
+      std::vector<char const*> _names;
+      std::vector<slot>       _slots;
+      std::size_t             _mask = 0;
+      bool                    _unique = true;
+   };
+
+   // Write the parameters. value(i) returns the plain value of parameter i.
+   template <typename Stream, typename Value>
+   void save_parameters(Stream& str, parameter_index const& index, Value&& value);
+
+   // Read the parameters, in the current or legacy format. set(i, value)
+   // is called for each known parameter i. Returns false if the state is
+   // not valid (e.g. from a newer version).
+   template <typename Stream, typename Set>
+   bool load_parameters(Stream& str, parameter_index const& index, Set&& set);
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   inline parameter_index::parameter_index(parameter_list params)
+   {
+      std::size_t capacity = 16;
+      while (capacity < params.size() * 2)
+         capacity *= 2;
+      _slots.assign(capacity, { 0, -1 });
+      _mask = capacity - 1;
+
+      _ids.reserve(params.size());
+      _names.reserve(params.size());
+      for (std::size_t i = 0; i != params.size(); ++i)
+      {
+         auto id = parameter_hash(params[i]._name);
+         _ids.push_back(id);
+         _names.push_back(params[i]._name);
+
+         auto s = id & _mask;
+         for (; _slots[s].index >= 0; s = (s + 1) & _mask)
+         {
+            if (_slots[s].id == id)
+               _unique = false;
+         }
+         _slots[s] = { id, int(i) };
+      }
+   }
+
+   inline int parameter_index::find(std::uint64_t id) const
+   {
+      if (_slots.empty())
+         return -1;
+      for (auto s = id & _mask; _slots[s].index >= 0; s = (s + 1) & _mask)
+      {
+         if (_slots[s].id == id)
+            return _slots[s].index;
+      }
+      return -1;
+   }
+
+   inline int parameter_index::find(std::string_view name) const
+   {
+      // The hash may collide. Confirm with the name.
+      auto i = find(parameter_hash(name));
+      if (i >= 0 && _names[i] == name)
+         return i;
+      for (std::size_t j = 0; !_unique && j != _names.size(); ++j)
+      {
+         if (_names[j] == name)
+            return int(j);
+      }
+      return -1;
+   }
+
+   template <typename Stream, typename Value>
+   inline void save_parameters(Stream& str, parameter_index const& index, Value&& value)
+   {
+      int num_params = index.size();
+      if (!index.unique())
+      {
+         str << num_params;
+         for (int i = 0; i != num_params; ++i)
+            str << index.name(i) << double(value(i));
+         return;
+      }
+
+      str << state_magic << state_version << std::uint32_t(num_params);
+      for (int i = 0; i != num_params; ++i)
+         str << index.id(i);
+      for (int i = 0; i != num_params; ++i)
+         str << double(value(i));
+   }
+
+   template <typename Stream, typename Set>
+   inline bool load_parameters(Stream& str, parameter_index const& index, Set&& set)
+   {
+      std::int32_t first = 0;
+      str >> first;
+
+      if (std::uint32_t(first) != state_magic)
+      {
+         // Legacy format
+         for (int i = 0; i < first && str.good(); ++i)
+         {
+            std::string_view name;
+            double value = 0;
+            str.read_view(name) >> value;
+            auto id = index.find(name);
+            if (id >= 0 && str.good())
+               set(id, value);
+         }
+         return str.good();
+      }
+
+      std::uint32_t version = 0;
+      std::uint32_t num_params = 0;
+      str >> version >> num_params;
+      if (version > state_version || num_params > str.remaining() / sizeof(double))
+         return false;
+
+      // Map the ids first; the values follow in the same order
+      std::vector<int> ids(num_params);
+      for (auto& id : ids)
+      {
+         std::uint64_t hash = 0;
+         str >> hash;
+         id = index.find(hash);
+      }
+
+      for (auto id : ids)
+      {
+         double value = 0;
+         str >> value;
+         if (id >= 0 && str.good())
+            set(id, value);
+      }
+      return str.good();
+   }
+}
+
+#endif
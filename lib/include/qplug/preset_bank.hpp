@@ -0,0 +1,202 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_PRESET_BANK_HPP_NOVEMBER_18_2019)
+#define QPLUG_PRESET_BANK_HPP_NOVEMBER_18_2019
+
+#include <qplug/parameter.hpp>
+#include <qplug/data_stream.hpp>
+#include <infra/iterator_range.hpp>
+#include <infra/filesystem.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // Binary preset bank (.qpb). An alternative to the JSON presets files
+   // for large libraries: the bank is memory mapped and nothing is decoded
+   // until a preset is looked up. The layout (native byte order) is:
+   //
+   //    header      bank_header
+   //    params      uint64 x num_params      parameter ids (parameter_hash)
+   //    names       bank_name x num_presets  sorted by name
+   //    records     record_size x num_presets, in the same order as names
+   //    strings     the preset names
+   //
+   // Each record is a bitset of the parameters the preset has (uint64 x
+   // ceil(num_params / 64)), followed by a double (plain value) for each
+   // parameter, in the order of the params table. Parameters are matched
+   // by id, so a bank stays valid when parameters are added, removed or
+   // reordered.
+   ////////////////////////////////////////////////////////////////////////////
+   constexpr std::uint32_t preset_bank_magic = 0x31425051;   // "QPB1"
+   constexpr std::uint32_t preset_bank_version = 1;
+
+   struct bank_header
+   {
+      std::uint32_t           magic;
+      std::uint32_t           version;
+      std::uint32_t           num_params;
+      std::uint32_t           num_presets;
+      std::uint32_t           record_size;
+      std::uint32_t           strings_size;
+   };
+
+   struct bank_name
+   {
+      std::uint32_t           offset;  // Into the strings
+      std::uint32_t           size;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // preset_bank: A read-only, memory mapped preset bank
+   ////////////////////////////////////////////////////////////////////////////
+   class preset_bank
+   {
+   public:
+
+      using parameter_list = iterator_range<parameter const*>;
+
+                              preset_bank() = default;
+                              preset_bank(preset_bank const&) = delete;
+                              ~preset_bank();
+
+      preset_bank&            operator=(preset_bank const&) = delete;
+
+      // Map the bank. Returns false if the file can't be mapped or is not
+      // a valid bank.
+      bool                    open(fs::path const& path, parameter_list params);
+      void                    close();
+      void                    swap(preset_bank& other);
+
+      bool                    is_open() const         { return _data != nullptr; }
+      std::size_t             size() const            { return _num_presets; }
+
+      std::string_view        name(std::size_t preset) const;
+
+      // The preset with the given name, or -1 if not found
+      int                     find(std::string_view name) const;
+
+      // param is the index into the plugin's parameters
+      bool                    has(std::size_t preset, int param) const;
+      double                  value(std::size_t preset, int param) const;
+
+      // f(param, value) for each parameter in the preset
+                              template <typename F>
+      void                    for_each(std::size_t preset, F&& f) const;
+
+   private:
+
+      using word = std::uint64_t;
+
+      char const*             record(std::size_t preset) const;
+
+      char const*             _data = nullptr;
+      std::size_t             _size = 0;
+      void*                   _mapping = nullptr;   // Windows file mapping
+
+      std::size_t             _num_presets = 0;
+      std::size_t             _num_params = 0;
+      std::size_t             _record_size = 0;
+      bank_name const*        _names = nullptr;
+      char const*             _records = nullptr;
+      char const*             _strings = nullptr;
+
+      // The column of each of the plugin's parameters, or -1
+      std::vector<int>        _columns;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // preset_bank_writer: Builds a preset bank
+   ////////////////////////////////////////////////////////////////////////////
+   class preset_bank_writer
+   {
+   public:
+
+      using parameter_list = preset_bank::parameter_list;
+
+      explicit                preset_bank_writer(parameter_list params);
+
+      // Start a preset (or replace one with the same name). The parameters
+      // that follow belong to this preset.
+      void                    add_preset(std::string_view name);
+      void                    set(int param, double value);
+
+      void                    write(ostream& str) const;
+      bool                    write(fs::path const& path) const;
+
+      std::size_t             size() const            { return _names.size(); }
+
+   private:
+
+      std::size_t             _num_params;
+      std::size_t             _num_words;
+      std::vector<std::uint64_t> _ids;
+      std::vector<std::string> _names;
+      std::unordered_map<std::string, std::size_t> _lookup;
+      std::vector<std::uint64_t> _bits;
+      std::vector<double>     _values;
+      std::size_t             _current = 0;
+   };
+
+   // Convert presets from JSON (see preset_parser) to a preset bank
+   bool convert_presets(
+      std::string_view json, preset_bank::parameter_list params
+    , preset_bank_writer& bank);
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   inline std::string_view preset_bank::name(std::size_t preset) const
+   {
+      auto const& n = _names[preset];
+      return { _strings + n.offset, n.size };
+   }
+
+   inline char const* preset_bank::record(std::size_t preset) const
+   {
+      return _records + preset * _record_size;
+   }
+
+   inline bool preset_bank::has(std::size_t preset, int param) const
+   {
+      if (std::size_t(param) >= _columns.size() || _columns[param] < 0)
+         return false;
+
+      auto col = std::size_t(_columns[param]);
+      word bits;
+      std::memcpy(&bits, record(preset) + (col / 64) * sizeof(word), sizeof(word));
+      return (bits >> (col % 64)) & 1;
+   }
+
+   inline double preset_bank::value(std::size_t preset, int param) const
+   {
+      auto col = std::size_t(_columns[param]);
+      auto num_words = (_num_params + 63) / 64;
+      double val;
+      std::memcpy(&val
+       , record(preset) + num_words * sizeof(word) + col * sizeof(double)
+       , sizeof(double));
+      return val;
+   }
+
+   template <typename F>
+   inline void preset_bank::for_each(std::size_t preset, F&& f) const
+   {
+      for (std::size_t i = 0; i != _columns.size(); ++i)
+      {
+         if (has(preset, int(i)))
+            f(int(i), value(preset, int(i)));
+      }
+   }
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_PRESET_JOURNAL_HPP_NOVEMBER_20_2019)
+#define QPLUG_PRESET_JOURNAL_HPP_NOVEMBER_20_2019
+
+#include <qplug/parameter.hpp>
+#include <qplug/plugin_state.hpp>
+#include <qplug/preset_store.hpp>
+#include <infra/iterator_range.hpp>
+#include <infra/filesystem.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // Preset journal: an append-only log of preset saves and deletes, so
+   // that saving a preset costs O(preset size) instead of rewriting the
+   // whole presets file. The journal file is:
+   //
+   //    magic       uint32            journal_magic
+   //    version     uint32            journal_version
+   //    records...
+   //
+   // and each record is:
+   //
+   //    size        uint32            size of the payload
+   //    checksum    uint64            FNV-1a of the payload
+   //    payload     op (uint8), preset name, then for journal_save, the
+   //                parameter ids and values (see ostream::write_array)
+   //
+   // A save record holds all the parameters of the preset, so replaying a
+   // record twice is harmless. Replay stops at the first incomplete or
+   // corrupt record (e.g. a write interrupted by a crash).
+   //
+   // Several processes may share the journal. Reads, appends and
+   // truncations take an exclusive lock on a lock file next to it (the
+   // journal's path, plus ".lock"), so none of them sees another's record
+   // half written.
+   ////////////////////////////////////////////////////////////////////////////
+   constexpr std::uint32_t journal_magic = 0x314A5051;   // "QPJ1"
+   constexpr std::uint32_t journal_version = 1;
+
+   enum journal_op : std::uint8_t
+   {
+      journal_save = 1,
+      journal_erase = 2
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // preset_journal: Records are encoded on the calling thread and written
+   // by a background writer thread, which runs while there is something
+   // to write. compact queues a rewrite of the main presets file(s). Once
+   // it succeeds, the records it includes are dropped from the journal;
+   // the ones appended since (e.g. by another process) are kept.
+   ////////////////////////////////////////////////////////////////////////////
+   class preset_journal
+   {
+   public:
+
+      using parameter_list = iterator_range<parameter const*>;
+
+      // Writes the presets, with the journal applied up to the position it
+      // returns (see replayed), or returns 0 if it failed
+      using compact_function = std::function<std::uint64_t()>;
+
+                              preset_journal() = default;
+                              preset_journal(preset_journal const&) = delete;
+                              ~preset_journal();
+
+      void                    open(fs::path const& path, parameter_list params);
+      bool                    is_open() const         { return !_path.empty(); }
+
+      // Apply the journal to the presets. Returns the number of records
+      // applied. Call this before writing to the journal.
+      std::size_t             replay(preset_store& presets);
+
+      // Apply the records written since the last replay (e.g. by another
+      // process). Unlike replay, an incomplete record at the end is left
+      // alone. Records are applied in the order they were written, this
+      // journal's included if another process wrote in between (which is
+      // harmless, once they are all written: see idle). Returns the number
+      // of records applied.
+      std::size_t             replay_more(preset_store& presets);
+
+      // The position up to which the journal is applied: replayed, or
+      // written here right after what was. Larger than the file if another
+      // process compacted it.
+      std::uint64_t           replayed() const        { return _replayed; }
+
+      // Start over: replay_more applies the whole journal (e.g. after the
+      // presets were reloaded)
+      void                    rewind()                { _replayed = 0; }
+
+      // Any thread
+      void                    save(preset_store const& presets, int preset);
+      void                    erase(std::string_view name);
+      void                    compact(compact_function write_main);
+
+      // The number of records since the last compaction was queued
+      std::size_t             size() const            { return _size; }
+
+      // Wait until everything queued is written
+      void                    flush();
+
+      // Nothing is queued or being written
+      bool                    idle();
+
+   private:
+
+      struct job
+      {
+         std::vector<char>    record;
+         compact_function     write_main;
+      };
+
+      std::size_t             read(preset_store& presets, bool repair);
+      void                    push(job&& j);
+      void                    writer();
+      bool                    append(std::vector<char> const& records);
+      bool                    drop(std::uint64_t pos);
+      bool                    clear();
+
+      fs::path                _path;
+      std::vector<std::uint64_t> _ids;
+      parameter_index         _index;
+      std::atomic<std::size_t> _size{ 0 };
+      std::atomic<std::uint64_t> _replayed{ 0 };
+
+      std::mutex              _mutex;
+      std::condition_variable _idle;
+      std::deque<job>         _jobs;
+      std::thread             _thread;
+      bool                    _running = false;
+   };
+}
+
+#endif
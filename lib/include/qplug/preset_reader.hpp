@@ -0,0 +1,483 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_PRESET_READER_HPP_NOVEMBER_24_2019)
+#define QPLUG_PRESET_READER_HPP_NOVEMBER_24_2019
+
+#include <qplug/presets.hpp>
+
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define QPLUG_PRESET_READER_SSE2
+# if defined(_MSC_VER)
+#  include <intrin.h>
+# endif
+#endif
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // parameter_names: A perfect hash of the parameter names. Build it once
+   // per parameter list, and use it for any number of reads. If names are
+   // repeated, the last parameter with the name is found (as with
+   // on_preset and for_each_preset).
+   ////////////////////////////////////////////////////////////////////////////
+   class parameter_names
+   {
+   public:
+
+      explicit                parameter_names(parameter_list params);
+
+      // The parameter with the name, or nullptr if there is none
+      parameter const*        find(std::string_view name) const;
+
+   private:
+
+      struct entry
+      {
+         std::string_view     name;
+         parameter const*     param = nullptr;
+      };
+
+      static constexpr std::uint64_t
+                              hash(std::string_view name, std::uint64_t seed);
+
+      std::uint64_t           _seed = 0;
+      std::uint64_t           _mask = 0;
+      std::vector<entry>      _table;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // read_preset and read_presets: A faster alternative to preset_parser
+   // with on_preset and for_each_preset. The grammar, the calls to f (or f1
+   // and f2) and the result are the same: read_presets(json, names, f1, f2)
+   // is equivalent to x3::phrase_parse(first, last, preset_parser{},
+   // x3::space, for_each_preset(params, f1, f2)).
+   //
+   // Strings and whitespace are scanned 16 characters at a time (SSE2),
+   // and numbers are converted with std::from_chars. Numbers that X3 could
+   // round differently (more than 15 digits, or an exponent), and inf and
+   // nan, are left to X3.
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename F>
+   bool read_preset(std::string_view json, parameter_names const& names, F&& f);
+
+   template <typename F1, typename F2>
+   bool read_presets(
+      std::string_view json, parameter_names const& names, F1&& f1, F2&& f2);
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Implementation
+   ////////////////////////////////////////////////////////////////////////////
+   constexpr std::uint64_t
+   parameter_names::hash(std::string_view name, std::uint64_t seed)
+   {
+      // FNV-1a (see parameter_hash), from a seeded offset basis
+      std::uint64_t h = 0xcbf29ce484222325ull ^ (seed * 0x9e3779b97f4a7c15ull);
+      for (char c : name)
+      {
+         h ^= std::uint8_t(c);
+         h *= 0x100000001b3ull;
+      }
+      return h ^ (h >> 32);
+   }
+
+   inline parameter_names::parameter_names(parameter_list params)
+   {
+      // The last parameter with a given name wins
+      std::unordered_map<std::string_view, parameter const*> unique;
+      for (auto const& param : params)
+         unique[param._name] = &param;
+
+      // Find a seed that puts every name in its own slot, in a table at
+      // least twice the number of names. Grow the table if none is found.
+      std::size_t size = 2;
+      while (size < unique.size() * 2)
+         size *= 2;
+
+      for (;;)
+      {
+         for (std::uint64_t seed = 1; seed != 64; ++seed)
+         {
+            _table.assign(size, entry{});
+            bool perfect = true;
+            for (auto const& [name, param] : unique)
+            {
+               auto& e = _table[hash(name, seed) & (size - 1)];
+               if (e.param)
+               {
+                  perfect = false;
+                  break;
+               }
+               e = { name, param };
+            }
+
+            if (perfect)
+            {
+               _seed = seed;
+               _mask = size - 1;
+               return;
+            }
+         }
+         size *= 2;
+      }
+   }
+
+   inline parameter const* parameter_names::find(std::string_view name) const
+   {
+      auto const& e = _table[hash(name, _seed) & _mask];
+      return (e.param && e.name == name)? e.param : nullptr;
+   }
+
+   namespace detail
+   {
+      constexpr bool is_space(char c)
+      {
+         // As x3::space
+         return c == ' ' || (c >= '\t' && c <= '\r');
+      }
+
+      constexpr bool is_digit(char c)
+      {
+         return c >= '0' && c <= '9';
+      }
+
+#if defined(QPLUG_PRESET_READER_SSE2)
+      inline int first_set(unsigned mask)
+      {
+# if defined(_MSC_VER)
+         unsigned long i;
+         _BitScanForward(&i, mask);
+         return int(i);
+# else
+         return __builtin_ctz(mask);
+# endif
+      }
+#endif
+
+      // The first character that is not whitespace
+      inline char const* skip_space(char const* first, char const* last)
+      {
+         // Usually there is little or no whitespace
+         if (first == last || !is_space(*first))
+            return first;
+
+#if defined(QPLUG_PRESET_READER_SSE2)
+         auto const space = _mm_set1_epi8(' ');
+         auto const below_tab = _mm_set1_epi8('\t' - 1);
+         auto const above_cr = _mm_set1_epi8('\r' + 1);
+         while (last - first >= 16)
+         {
+            auto chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(first));
+            auto ws = _mm_or_si128(
+               _mm_cmpeq_epi8(chunk, space)
+             , _mm_and_si128(
+                  _mm_cmpgt_epi8(chunk, below_tab)
+                , _mm_cmplt_epi8(chunk, above_cr))
+            );
+            if (auto mask = unsigned(~_mm_movemask_epi8(ws)) & 0xffff)
+               return first + first_set(mask);
+            first += 16;
+         }
+#endif
+         while (first != last && is_space(*first))
+            ++first;
+         return first;
+      }
+
+      // The first double quote or backslash
+      inline char const* find_quote(char const* first, char const* last)
+      {
+#if defined(QPLUG_PRESET_READER_SSE2)
+         auto const quote = _mm_set1_epi8('"');
+         auto const backslash = _mm_set1_epi8('\\');
+         while (last - first >= 16)
+         {
+            auto chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(first));
+            auto found = _mm_or_si128(
+               _mm_cmpeq_epi8(chunk, quote)
+             , _mm_cmpeq_epi8(chunk, backslash)
+            );
+            if (auto mask = unsigned(_mm_movemask_epi8(found)))
+               return first + first_set(mask);
+            first += 16;
+         }
+#endif
+         while (first != last && *first != '"' && *first != '\\')
+            ++first;
+         return first;
+      }
+
+      // Follows preset_parser, step by step, including where whitespace
+      // is skipped and where it fails
+      class preset_reader
+      {
+      public:
+
+         preset_reader(std::string_view json, parameter_names const& names)
+          : _first(json.data())
+          , _last(json.data() + json.size())
+          , _names(names)
+         {}
+
+         template <typename F>
+         bool preset(F& f);
+
+         template <typename F1, typename F2>
+         bool presets(F1& f1, F2& f2);
+
+      private:
+
+         void skip() { _first = skip_space(_first, _last); }
+
+         bool lit(char c)
+         {
+            skip();
+            if (_first != _last && *_first == c)
+            {
+               ++_first;
+               return true;
+            }
+            return false;
+         }
+
+         bool string(std::string_view& attr);
+         bool boolean(bool& attr);
+         bool integer(int& attr);
+         bool real(double& attr);
+
+         template <typename F>
+         bool pair(F& f);
+
+         char const*             _first;
+         char const*             _last;
+         parameter_names const&  _names;
+      };
+
+      inline bool preset_reader::string(std::string_view& attr)
+      {
+         skip();
+         if (_first == _last || *_first != '"')
+            return false;
+
+         // Only \" is an escape here. The client decodes the escapes (see
+         // extract_string).
+         auto i = _first + 1;
+         for (;;)
+         {
+            i = find_quote(i, _last);
+            if (i == _last)
+               return false;
+            if (*i == '"')
+               break;
+            i += (i + 1 != _last && i[1] == '"')? 2 : 1;
+         }
+
+         attr = std::string_view{ _first + 1, std::size_t(i - _first - 1) };
+         _first = i + 1;
+         return true;
+      }
+
+      inline bool preset_reader::boolean(bool& attr)
+      {
+         skip();
+         auto match = [this](std::string_view s)
+         {
+            if (std::size_t(_last - _first) < s.size()
+               || std::string_view{ _first, s.size() } != s)
+               return false;
+            _first += s.size();
+            return true;
+         };
+
+         if (match("true"))
+            attr = true;
+         else if (match("false"))
+            attr = false;
+         else
+            return false;
+         return true;
+      }
+
+      inline bool preset_reader::integer(int& attr)
+      {
+         skip();
+
+         // std::from_chars does not take a plus sign
+         auto from = _first;
+         if (from != _last && *from == '+')
+         {
+            if (++from == _last || !is_digit(*from))
+               return false;
+         }
+
+         auto [ptr, ec] = std::from_chars(from, _last, attr);
+         if (ec != std::errc{})
+            return false;
+         _first = ptr;
+         return true;
+      }
+
+      inline bool preset_reader::real(double& attr)
+      {
+         skip();
+
+#if defined(__cpp_lib_to_chars)
+         // [sign] digits [. digits], up to 15 digits and no exponent. X3
+         // gets the exact same (correctly rounded) result for these, as
+         // the digits and the power of 10 are exact in a double.
+         auto i = _first;
+         if (i != _last && (*i == '+' || *i == '-'))
+            ++i;
+         std::size_t digits = 0;
+         for (; i != _last && is_digit(*i); ++i)
+            ++digits;
+         if (i != _last && *i == '.')
+         {
+            for (++i; i != _last && is_digit(*i); ++i)
+               ++digits;
+         }
+
+         bool exponent = i != _last && (*i == 'e' || *i == 'E');
+         if (digits != 0 && digits <= 15 && !exponent)
+         {
+            auto from = (*_first == '+')? _first + 1 : _first;
+            auto [ptr, ec] = std::from_chars(from, i, attr);
+            if (ec == std::errc{} && ptr == i)
+            {
+               _first = i;
+               return true;
+            }
+         }
+#endif
+
+         static x3::real_parser<double> p;
+         return p.parse(_first, _last, x3::unused, x3::unused, attr);
+      }
+
+      template <typename F>
+      inline bool preset_reader::pair(F& f)
+      {
+         if (_first == _last)
+            return false;
+
+         std::string_view name;
+         if (!string(name))
+            return false;
+         if (!lit(':'))
+            return false;
+
+         auto param = _names.find(name);
+         if (!param)
+            return false;
+
+         switch (param->_type)
+         {
+            case parameter::bool_:
+            {
+               bool val;
+               if (!boolean(val))
+                  return false;
+               f(std::make_pair(name, val), *param);
+               return true;
+            }
+            case parameter::int_:
+            {
+               int val;
+               if (!integer(val))
+                  return false;
+               f(std::make_pair(name, val), *param);
+               return true;
+            }
+            case parameter::frequency:
+            case parameter::double_:
+            {
+               double val;
+               if (!real(val))
+                  return false;
+               f(std::make_pair(name, val), *param);
+               return true;
+            }
+            case parameter::note:
+            {
+               std::string_view val;
+               if (!string(val))
+                  return false;
+               f(std::make_pair(name, q::midi::note_number(val)), *param);
+               return true;
+            }
+         }
+         return false;
+      }
+
+      template <typename F>
+      inline bool preset_reader::preset(F& f)
+      {
+         if (_first == _last)
+            return false;
+
+         if (!lit('{'))
+            return false;
+
+         while (pair(f))
+         {
+            if (!lit(','))
+               break;
+         }
+
+         return lit('}');
+      }
+
+      template <typename F1, typename F2>
+      inline bool preset_reader::presets(F1& f1, F2& f2)
+      {
+         if (_first == _last)
+            return false;
+
+         if (!lit('{'))
+            return false;
+
+         std::string_view name;
+         while (string(name))
+         {
+            if (!lit(':'))
+               return false;
+            f2(name);
+
+            if (preset(f1))
+            {
+               if (lit(','))
+                  continue;
+            }
+         }
+
+         return lit('}');
+      }
+   }
+
+   template <typename F>
+   inline bool read_preset(std::string_view json, parameter_names const& names, F&& f)
+   {
+      detail::preset_reader reader{ json, names };
+      return reader.preset(f);
+   }
+
+   template <typename F1, typename F2>
+   inline bool read_presets(
+      std::string_view json, parameter_names const& names, F1&& f1, F2&& f2)
+   {
+      detail::preset_reader reader{ json, names };
+      return reader.presets(f1, f2);
+   }
+}
+
+#endif
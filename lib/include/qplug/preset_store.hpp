@@ -0,0 +1,223 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_PRESET_STORE_HPP_NOVEMBER_19_2019)
+#define QPLUG_PRESET_STORE_HPP_NOVEMBER_19_2019
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // preset_store: In-memory presets, indexed by parameter. Each preset is
+   // a bitset of the parameters it has and a value (plain) per parameter,
+   // all in two contiguous arrays (the same record layout as preset_bank).
+   // The names are kept once, in a table sorted by name.
+   //
+   // Presets are numbered 0 to size()-1. Adding a preset does not change
+   // the numbers of the others; erasing one moves the last preset into
+   // its place.
+   ////////////////////////////////////////////////////////////////////////////
+   class preset_store
+   {
+   public:
+
+      explicit                preset_store(std::size_t num_params = 0);
+                              preset_store(preset_store const& rhs);
+      preset_store&           operator=(preset_store rhs);
+
+      // Remove all presets and set the number of parameters
+      void                    reset(std::size_t num_params);
+      void                    swap(preset_store& other);
+
+      std::size_t             size() const            { return _slots.size(); }
+      bool                    empty() const           { return _slots.empty(); }
+      std::size_t             num_params() const      { return _num_params; }
+
+      // The preset with the given name, or -1 if not found
+      int                     find(std::string_view name) const;
+
+      // The preset with the given name, added (with no parameters) if
+      // there is none
+      int                     add(std::string_view name);
+      bool                    erase(std::string_view name);
+
+      std::string_view        name(int preset) const  { return _slots[preset]->first; }
+      bool                    has(int preset, int param) const;
+      double                  value(int preset, int param) const;
+      void                    set(int preset, int param, double value);
+
+      // Remove all the parameters of the preset
+      void                    clear(int preset);
+
+      // f(param, value) for each parameter in the preset
+                              template <typename F>
+      void                    for_each(int preset, F&& f) const;
+
+      // f(name, preset) for each preset, sorted by name
+                              template <typename F>
+      void                    for_each_preset(F&& f) const;
+
+   private:
+
+      using word = std::uint64_t;
+      using name_table = std::map<std::string, int, std::less<>>;
+
+      std::size_t             _num_params;
+      std::size_t             _num_words;
+      name_table              _names;
+      std::vector<name_table::iterator> _slots;
+      std::vector<word>       _bits;
+      std::vector<double>     _values;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   inline preset_store::preset_store(std::size_t num_params)
+   {
+      reset(num_params);
+   }
+
+   inline preset_store::preset_store(preset_store const& rhs)
+    : _num_params(rhs._num_params)
+    , _num_words(rhs._num_words)
+    , _names(rhs._names)
+    , _slots(rhs._slots.size())
+    , _bits(rhs._bits)
+    , _values(rhs._values)
+   {
+      // The slots point into our own name table
+      for (auto i = _names.begin(); i != _names.end(); ++i)
+         _slots[i->second] = i;
+   }
+
+   inline preset_store& preset_store::operator=(preset_store rhs)
+   {
+      swap(rhs);
+      return *this;
+   }
+
+   inline void preset_store::reset(std::size_t num_params)
+   {
+      _num_params = num_params;
+      _num_words = (num_params + 63) / 64;
+      _names.clear();
+      _slots.clear();
+      _bits.clear();
+      _values.clear();
+   }
+
+   inline void preset_store::swap(preset_store& other)
+   {
+      std::swap(_num_params, other._num_params);
+      std::swap(_num_words, other._num_words);
+      _names.swap(other._names);
+      _slots.swap(other._slots);
+      _bits.swap(other._bits);
+      _values.swap(other._values);
+   }
+
+   inline int preset_store::find(std::string_view name) const
+   {
+      auto i = _names.find(name);
+      return (i == _names.end())? -1 : i->second;
+   }
+
+   inline int preset_store::add(std::string_view name)
+   {
+      auto i = _names.find(name);
+      if (i != _names.end())
+         return i->second;
+
+      int preset = int(_slots.size());
+      _slots.push_back(_names.emplace(std::string{ name }, preset).first);
+      _bits.resize(_bits.size() + _num_words, 0);
+      _values.resize(_values.size() + _num_params, 0.0);
+      return preset;
+   }
+
+   inline bool preset_store::erase(std::string_view name)
+   {
+      auto i = _names.find(name);
+      if (i == _names.end())
+         return false;
+
+      auto preset = std::size_t(i->second);
+      auto last = _slots.size() - 1;
+      if (preset != last)
+      {
+         // Move the last preset into the hole
+         std::copy_n(_bits.begin() + last * _num_words, _num_words
+          , _bits.begin() + preset * _num_words);
+         std::copy_n(_values.begin() + last * _num_params, _num_params
+          , _values.begin() + preset * _num_params);
+         _slots[preset] = _slots[last];
+         _slots[preset]->second = int(preset);
+      }
+
+      _names.erase(i);
+      _slots.pop_back();
+      _bits.resize(last * _num_words);
+      _values.resize(last * _num_params);
+      return true;
+   }
+
+   inline bool preset_store::has(int preset, int param) const
+   {
+      if (std::size_t(param) >= _num_params)
+         return false;
+      return (_bits[preset * _num_words + param / 64] >> (param % 64)) & 1;
+   }
+
+   inline double preset_store::value(int preset, int param) const
+   {
+      return _values[preset * _num_params + param];
+   }
+
+   inline void preset_store::set(int preset, int param, double value)
+   {
+      if (std::size_t(param) >= _num_params)
+         return;
+      _bits[preset * _num_words + param / 64] |= word(1) << (param % 64);
+      _values[preset * _num_params + param] = value;
+   }
+
+   inline void preset_store::clear(int preset)
+   {
+      std::fill_n(_bits.begin() + preset * _num_words, _num_words, 0);
+   }
+
+   template <typename F>
+   inline void preset_store::for_each(int preset, F&& f) const
+   {
+      auto bits = _bits.data() + preset * _num_words;
+      auto values = _values.data() + preset * _num_params;
+      for (std::size_t w = 0; w != _num_words; ++w)
+      {
+         auto param = w * 64;
+         for (auto b = bits[w]; b != 0; b >>= 1, ++param)
+         {
+            if (b & 1)
+               f(int(param), values[param]);
+         }
+      }
+   }
+
+   template <typename F>
+   inline void preset_store::for_each_preset(F&& f) const
+   {
+      for (auto const& [name, preset] : _names)
+         f(std::string_view{ name }, preset);
+   }
+}
+
+#endif
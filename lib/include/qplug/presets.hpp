@@ -142,6 +142,7 @@ namespace cycfi::qplug
    inline std::optional<std::string> extract_string(std::string_view in)
    {
       std::string result;
+      result.reserve(in.size());
       using uchar = std::uint32_t;   // a unicode code point
       auto i = in.begin();
       auto last = in.end();
@@ -175,7 +176,7 @@ namespace cycfi::qplug
                   if (!r)
                      return {};
 
-                  i = ii; // update iterator position
+                  i = ii - 1; // update iterator position (to the last digit)
                   using insert_iter = std::back_insert_iterator<std::string>;
                   insert_iter out_iter(result);
                   boost::utf8_output_iterator<insert_iter> utf8_iter(out_iter);
@@ -185,7 +186,11 @@ namespace cycfi::qplug
          }
          else
          {
-            result += ch;
+            // Copy the plain characters up to the next escape at once
+            auto run = i;
+            while (i + 1 < last && i[1] != '\\' && !std::iscntrl(i[1]))
+               ++i;
+            result.append(run, i + 1);
          }
       }
       return result;
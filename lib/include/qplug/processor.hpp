@@ -7,26 +7,51 @@
 #define QPLUG_PROCESSOR_HPP_OCTOBER_17_2016
 
 #include <qplug/parameter.hpp>
+#include <qplug/event_queue.hpp>
+#include <qplug/parameter_table.hpp>
+#include <qplug/parameter_ramp.hpp>
+#include <qplug/worker_pool.hpp>
+#include <qplug/load_meter.hpp>
+#include <qplug/parameter_snapshot.hpp>
+#include <qplug/parameter_morph.hpp>
 #include <q/support/audio_stream.hpp>
+#include <q/support/midi.hpp>
+#include <infra/iterator_range.hpp>
 #include <memory>
 #include <vector>
+#include <algorithm>
+#include <chrono>
 #include <type_traits>
 
 #if defined(IPLUG2)
 # include "IPlug_include_in_plug_hdr.h"
 class iplug2_plugin;
 using base_processor = iplug2_plugin;
+#elif defined(QPLUG_HEADLESS)
+class headless_plugin;
+using base_processor = headless_plugin;
 #endif
 
 namespace cycfi::qplug
 {
+   ////////////////////////////////////////////////////////////////////////////
+   // A MIDI message at a specific frame offset within the current block.
+   ////////////////////////////////////////////////////////////////////////////
+   struct midi_event
+   {
+      std::uint32_t           frame;
+      q::midi::raw_message    msg;
+   };
+
+   using midi_event_queue = event_queue<midi_event>;
+
    ////////////////////////////////////////////////////////////////////////////
    // The processor
    ////////////////////////////////////////////////////////////////////////////
    class processor : public q::audio_stream
    {
    public:
-                              processor(iplug2_plugin& base)
+                              processor(base_processor& base)
                                : _base(base)
                               {}
                               processor(processor const&) = delete;
@@ -45,23 +70,162 @@ namespace cycfi::qplug
                               template <typename... T>
       void                    parameters(T&&... param);
 
+      // Compile-time dispatch (see parameter_table.hpp). The table must
+      // outlive the processor; declare it constexpr at namespace scope.
+                              template <typename Derived, typename... T>
+      void                    parameters(parameter_table<Derived, T...> const& table);
+
+      // Parameter changes are applied on the audio thread, between blocks
+      // or (sample accurate) between segments. Changes made on other
+      // threads (e.g. the UI or preset recall) are published lock-free and
+      // picked up at the start of the next block.
       virtual void            on_parameter_change(int id, double value) {}
       virtual void            update_parameter(int id, double value);
 
+      // The current parameter values, and the parameters that changed since
+      // the previous block (see parameter_snapshot). Audio thread only.
+      parameter_snapshot const&
+                              parameter_values() const { return _parameters; }
+
+      // Morph the parameters from one set of values to another (see
+      // parameter_morph and controller::morph_preset). The values are
+      // applied at the start of each block, as parameter changes, without
+      // notifying the host. With ms == 0, the morph follows morph_position,
+      // which may be bound to a host-automatable parameter, e.g.:
+      //
+      //    parameters(..., &processor::morph_position);
+      //
+      // The morph continues until stopped, or until a timed morph is done.
+      // Any thread, one at a time. Returns the morph's id: morph_done gives
+      // it (any thread) once a timed morph got to its end.
+      std::uint32_t           morph(
+                                 std::vector<double> const& from
+                               , std::vector<double> const& to
+                               , double ms
+                               , double switch_point = 0.5
+                              );
+      void                    stop_morph();
+      std::uint32_t           morph_done() const { return _morph.done(); }
+
+      // Audio thread
+      void                    morph_position(double pos) { _morph.position(pos); }
+      bool                    morphing() const { return _morph.active(); }
+
+      // Receive MIDI on the audio thread. Messages are passed to proc via
+      // q::midi::dispatch, with the frame offset within the block as time.
+      // proc must outlive the processor.
+                              template <typename MIDIProcessor>
+      void                    receive_midi(MIDIProcessor& proc);
+
+      // Return true to receive host parameter changes and MIDI messages as
+      // sample accurate events (see parameter_events, midi_events,
+      // for_each_segment and for_each_ramp). Otherwise, all changes and
+      // messages are applied before process is called.
+      virtual bool            sample_accurate() const { return false; }
+
+      parameter_event_queue const&
+                              parameter_events() const { return _parameter_events; }
+      midi_event_queue const& midi_events() const { return _midi_events; }
+
+      // Split the block at parameter and MIDI event boundaries. Parameter
+      // changes are applied and MIDI messages dispatched at each boundary,
+      // then f(first, last) is called for each segment of frames
+      // [first, last). Parameter changes go before MIDI messages at the
+      // same frame.
+                              template <typename F>
+      void                    for_each_segment(std::size_t frames, F&& f);
+
+      // Linear ramp segments for parameter id, starting from the value from.
+      // f(first, last, start, end) is called for each segment of frames
+      // [first, last), where the value goes from start to end (VST3 point
+      // queue semantics).
+                              template <typename F>
+      void                    for_each_ramp(
+                                 int id, double from, std::size_t frames, F&& f) const;
+
+      // Per-block ramp for parameter id, smoothed as specified by
+      // parameter::smooth. The ramp is updated before process is called,
+      // and restarts at the frame of each sample accurate event.
+      parameter_ramp const&   smoothed(int id) const { return _ramps[id]; }
+
+      // Return n > 0 to process independent groups of n channels in
+      // parallel (e.g. 1 if all channels are independent, 4 for first order
+      // ambisonics). process_group is then called for each group, from a
+      // worker pool, instead of process. The last group may be smaller.
+      // Groups run concurrently: process_group may read the parameters,
+      // smoothed and parameter_events, but must not use for_each_segment.
+      virtual std::size_t     channel_group_size() const { return 0; }
+      virtual void            process_group(
+                                 std::size_t group
+                               , in_channels const& in
+                               , out_channels const& out
+                              ) {}
+
+      // DSP load of each block, measured from the start to the end of the
+      // block's processing (including parameter and MIDI handling). Safe
+      // to read from any thread (e.g. a CPU meter in the UI).
+      load_meter const&       dsp_load() const { return _load; }
+
    private:
 
       friend base_processor;
 
+      using parameter_list = iterator_range<parameter const*>;
+
+      void                    init_parameters(parameter_list params);
+      void                    prepare(std::size_t max_frames);
       void                    parameter_change(int id, double value);
+      void                    parameter_change(int id, double value, int frame);
+      void                    parameter_change(parameter_event const& ev);
+      void                    apply_parameter(int id, double value);
+      void                    publish_parameter(int id, double value);
+      void                    publish_parameters(parameter_value_list const& values);
+      void                    apply_published_parameters();
+      void                    apply_morph(std::size_t frames);
+      void                    midi_message(q::midi::raw_message msg, std::size_t frame);
+      void                    dispatch_midi(midi_event const& ev);
+      void                    begin_block(std::size_t frames);
+      void                    process_block(
+                                 float const** in, std::size_t num_in
+                               , float** out, std::size_t num_out
+                               , std::size_t frames
+                              );
+      void                    end_block();
+
+                              template <typename T>
+      void                    add_parameter(T&& param);
 
-                              template <typename T, typename... Rest>
-      void                    add_parameter(int id, T&& param, Rest&&... rest);
+      void                    dispatch_parameter(int id, double value);
 
       using param_change = std::function<void(double)>;
       using parameter_change_list = std::vector<param_change>;
+      using midi_function = void(*)(void*, q::midi::raw_message, std::size_t);
+      using ramp_list = std::vector<parameter_ramp>;
+      using smoothed_list = std::vector<int>;
 
       base_processor&         _base;
       parameter_change_list   _on_parameter_change;
+      parameter_binding const* _bindings = nullptr;
+      std::size_t             _num_bindings = 0;
+      void*                   _bindings_self = nullptr;
+      parameter_event_queue   _parameter_events;
+      std::size_t             _events_consumed = 0;
+      midi_event_queue        _midi_events;
+      std::size_t             _midi_consumed = 0;
+      void*                   _midi_receiver = nullptr;
+      midi_function           _midi_dispatch = nullptr;
+      parameter_snapshot      _parameters;
+      parameter_morph         _morph;
+      ramp_list               _ramps;
+      smoothed_list           _smoothed;
+      std::vector<double>     _smooth_ms;
+      std::unique_ptr<worker_pool> _workers;
+
+      using clock = std::chrono::steady_clock;
+
+      load_meter              _load;
+      clock::time_point       _block_start;
+      std::size_t             _block_frames = 0;
    };
 
    using processor_ptr = std::unique_ptr<processor>;
@@ -84,8 +248,8 @@ namespace cycfi::qplug
       }
    }
 
-   template <typename T, typename... Rest>
-   inline void processor::add_parameter(int id, T&& param, Rest&&... rest)
+   template <typename T>
+   inline void processor::add_parameter(T&& param)
    {
       if constexpr(std::is_member_function_pointer<T>::value)
       {
@@ -107,17 +271,110 @@ namespace cycfi::qplug
             }
          );
       }
-
-      if constexpr(sizeof...(rest) != 0)
-         add_parameter(id+1, std::forward<Rest>(rest)...);
    }
 
    template <typename... T>
    inline void processor::parameters(T&&... param)
    {
       _on_parameter_change.clear();
-      if constexpr(sizeof...(T) != 0)
-         add_parameter(0, std::forward<T>(param)...);
+      _bindings = nullptr;
+      _num_bindings = 0;
+      _bindings_self = nullptr;
+      _on_parameter_change.reserve(sizeof...(T));
+
+      // A fold, not a recursion: thousands of parameters stay well within
+      // the compiler's template depth
+      (add_parameter(std::forward<T>(param)), ...);
+   }
+
+   template <typename Derived, typename... T>
+   inline void processor::parameters(parameter_table<Derived, T...> const& table)
+   {
+      static_assert(std::is_base_of<processor, Derived>::value,
+         "Derived must be a processor");
+
+      _on_parameter_change.clear();
+      _bindings = table.bindings();
+      _num_bindings = table.size;
+      _bindings_self = static_cast<Derived*>(this);
+   }
+
+   inline void processor::dispatch_parameter(int id, double value)
+   {
+      if (std::size_t(id) < _num_bindings)
+      {
+         auto const& b = _bindings[id];
+         b.apply(b.binding, _bindings_self, value);
+      }
+   }
+
+   template <typename MIDIProcessor>
+   inline void processor::receive_midi(MIDIProcessor& proc)
+   {
+      _midi_receiver = &proc;
+      _midi_dispatch =
+         [](void* receiver, q::midi::raw_message msg, std::size_t time)
+         {
+            q::midi::dispatch(msg, time, *static_cast<MIDIProcessor*>(receiver));
+         };
+   }
+
+   template <typename F>
+   inline void processor::for_each_segment(std::size_t frames, F&& f)
+   {
+      std::size_t first = 0;
+      while (true)
+      {
+         bool more_params = _events_consumed != _parameter_events.size();
+         bool more_midi = _midi_consumed != _midi_events.size();
+         if (!more_params && !more_midi)
+            break;
+
+         // Merge the parameter and MIDI events in frame order
+         bool param_next = more_params && (!more_midi
+            || _parameter_events[_events_consumed].frame <= _midi_events[_midi_consumed].frame);
+
+         auto next = param_next?
+            _parameter_events[_events_consumed].frame : _midi_events[_midi_consumed].frame;
+         auto frame = std::min<std::size_t>(next, frames);
+         if (frame > first)
+         {
+            f(first, frame);
+            first = frame;
+         }
+
+         if (param_next)
+         {
+            parameter_change(_parameter_events[_events_consumed++]);
+         }
+         else
+         {
+            dispatch_midi(_midi_events[_midi_consumed++]);
+         }
+      }
+      if (first < frames)
+         f(first, frames);
+   }
+
+   template <typename F>
+   inline void processor::for_each_ramp(
+      int id, double from, std::size_t frames, F&& f) const
+   {
+      std::size_t first = 0;
+      for (auto const& ev : _parameter_events)
+      {
+         if (ev.id != id)
+            continue;
+         auto frame = std::min<std::size_t>(ev.frame, frames);
+         if (frame > first)
+         {
+            f(first, frame, from, ev.value);
+            first = frame;
+         }
+         from = ev.value;
+      }
+      if (first < frames)
+         f(first, frames, from, from);
    }
 }
 
@@ -0,0 +1,160 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_PROGRAM_INDEX_HPP_NOVEMBER_22_2019)
+#define QPLUG_PROGRAM_INDEX_HPP_NOVEMBER_22_2019
+
+#include <qplug/persistent_map.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // program_index: Maps preset names to Program IDs and back. Presets
+   // without a Program ID have the id -1. If several presets have the same
+   // id, the first by name owns it.
+   //
+   // The generation changes with every change to the index, so that lists
+   // built from it (e.g. controller::preset_list) can be cached.
+   //
+   // The index does not own the names: they must outlive it, and any copy
+   // of it. The names it returns are the names it was given.
+   //
+   // Copies share their data (see persistent_map): copying is O(1), and
+   // set and erase are O(log n).
+   ////////////////////////////////////////////////////////////////////////////
+   class program_index
+   {
+   public:
+
+      void                    clear();
+      void                    set(std::string_view name, int id);
+      bool                    erase(std::string_view name);
+
+      bool                    has(std::string_view name) const;
+      std::size_t             size() const            { return _ids.size(); }
+      std::uint64_t           generation() const      { return _generation; }
+
+      // The id of the preset, or -1 if it has none (or is not found)
+      int                     find(std::string_view name) const;
+
+      // The preset that owns the id, or "" if there is none
+      std::string_view        find(int id) const;
+
+      // f(name, id) for each preset, sorted by name
+                              template <typename F>
+      void                    for_each(F&& f) const;
+
+   private:
+
+      using name_list = std::vector<std::string_view>;   // Sorted
+      using name_list_ptr = std::shared_ptr<name_list const>;
+
+      void                    link(std::string_view name, int id);
+      void                    unlink(std::string_view name, int id);
+
+      persistent_map<std::string_view, int> _ids;
+      persistent_map<int, name_list_ptr> _names;
+      std::uint64_t           _generation = 0;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   inline void program_index::clear()
+   {
+      _ids.clear();
+      _names.clear();
+      ++_generation;
+   }
+
+   inline void program_index::set(std::string_view name, int id)
+   {
+      if (id < 0)
+         id = -1;
+
+      if (auto i = _ids.find(name))
+      {
+         if (*i == id)
+            return;
+         unlink(name, *i);
+      }
+
+      _ids.set(name, id);
+      link(name, id);
+      ++_generation;
+   }
+
+   inline bool program_index::erase(std::string_view name)
+   {
+      auto i = _ids.find(name);
+      if (!i)
+         return false;
+      unlink(name, *i);
+      _ids.erase(name);
+      ++_generation;
+      return true;
+   }
+
+   // The name lists are shared with the copies: they are copied, not
+   // changed in place. They are short (the presets with the same id).
+   inline void program_index::link(std::string_view name, int id)
+   {
+      if (id < 0)
+         return;
+
+      auto list = _names.find(id);
+      auto names = list? name_list{ **list } : name_list{};
+      names.insert(std::lower_bound(names.begin(), names.end(), name), name);
+      _names.set(id, std::make_shared<name_list const>(std::move(names)));
+   }
+
+   inline void program_index::unlink(std::string_view name, int id)
+   {
+      auto list = _names.find(id);
+      if (!list)
+         return;
+
+      auto names = **list;
+      auto pos = std::lower_bound(names.begin(), names.end(), name);
+      if (pos != names.end() && *pos == name)
+         names.erase(pos);
+      if (names.empty())
+         _names.erase(id);
+      else
+         _names.set(id, std::make_shared<name_list const>(std::move(names)));
+   }
+
+   inline bool program_index::has(std::string_view name) const
+   {
+      return _ids.find(name) != nullptr;
+   }
+
+   inline int program_index::find(std::string_view name) const
+   {
+      auto i = _ids.find(name);
+      return i? *i : -1;
+   }
+
+   inline std::string_view program_index::find(int id) const
+   {
+      auto list = _names.find(id);
+      return list? (*list)->front() : std::string_view{ "" };
+   }
+
+   template <typename F>
+   inline void program_index::for_each(F&& f) const
+   {
+      _ids.for_each(
+         [&](std::string_view name, int id) { f(name, id); }
+      );
+   }
+}
+
+#endif
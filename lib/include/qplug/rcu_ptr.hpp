@@ -0,0 +1,200 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_RCU_PTR_HPP_NOVEMBER_28_2019)
+#define QPLUG_RCU_PTR_HPP_NOVEMBER_28_2019
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // rcu_ptr: An immutable object, shared by any number of readers and
+   // replaced by writers (read-copy-update).
+   //
+   // Readers never lock or wait: read() registers the reader in the
+   // current epoch (a counter in one of a few cache lines, picked by
+   // thread, so that readers on different threads do not contend), and
+   // returns the object. The object stays valid while the reader is held.
+   //
+   // Writers publish a new object, and retire the old one. Retired objects
+   // are deleted once no reader can be using them: after the epoch has
+   // advanced twice, which it does (when a writer publishes or calls
+   // reclaim) once every reader in the previous epoch is done. Writers
+   // must be serialized by the caller.
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename T>
+   class rcu_ptr
+   {
+   public:
+
+      class reader;
+
+      explicit                rcu_ptr(std::unique_ptr<T const> p = {});
+                              rcu_ptr(rcu_ptr const&) = delete;
+                              ~rcu_ptr();
+
+      rcu_ptr&                operator=(rcu_ptr const&) = delete;
+
+      // Any thread. Lock-free.
+      reader                  read() const;
+
+      // Writers, one at a time
+      void                    publish(std::unique_ptr<T const> p);
+      void                    reclaim();
+      std::size_t             retired() const      { return _retired.size(); }
+
+   private:
+
+      static constexpr std::size_t num_stripes = 16;
+
+      struct alignas(64) stripe
+      {
+         std::atomic<std::size_t> readers{ 0 };
+      };
+
+      using epoch_stripes = stripe[num_stripes];
+
+      static std::size_t      this_stripe();
+      bool                    has_readers(std::uint64_t epoch) const;
+
+      std::atomic<T const*>   _ptr;
+      std::atomic<std::uint64_t> _epoch{ 2 };
+      mutable epoch_stripes   _stripes[3];
+
+      // Writers only
+      std::vector<std::pair<T const*, std::uint64_t>> _retired;
+   };
+
+   template <typename T>
+   class rcu_ptr<T>::reader
+   {
+   public:
+
+                              reader(reader&& rhs)
+                               : _p(rhs._p), _readers(rhs._readers)
+                              {
+                                 rhs._readers = nullptr;
+                              }
+
+                              ~reader()
+                              {
+                                 if (_readers)
+                                    _readers->fetch_sub(1, std::memory_order_release);
+                              }
+
+                              reader(reader const&) = delete;
+      reader&                 operator=(reader const&) = delete;
+
+      T const*                get() const          { return _p; }
+      T const&                operator*() const    { return *_p; }
+      T const*                operator->() const   { return _p; }
+      explicit                operator bool() const { return _p != nullptr; }
+
+   private:
+
+      friend class rcu_ptr;
+
+                              reader(T const* p, std::atomic<std::size_t>* readers)
+                               : _p(p), _readers(readers)
+                              {}
+
+      T const*                _p;
+      std::atomic<std::size_t>* _readers;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename T>
+   inline rcu_ptr<T>::rcu_ptr(std::unique_ptr<T const> p)
+    : _ptr(p.release())
+   {}
+
+   template <typename T>
+   inline rcu_ptr<T>::~rcu_ptr()
+   {
+      // There must be no readers left
+      delete _ptr.load(std::memory_order_relaxed);
+      for (auto const& [p, epoch] : _retired)
+         delete p;
+   }
+
+   template <typename T>
+   inline std::size_t rcu_ptr<T>::this_stripe()
+   {
+      static std::atomic<std::size_t> next{ 0 };
+      thread_local std::size_t stripe_ = next.fetch_add(1) % num_stripes;
+      return stripe_;
+   }
+
+   template <typename T>
+   inline typename rcu_ptr<T>::reader rcu_ptr<T>::read() const
+   {
+      auto stripe_ = this_stripe();
+      for (;;)
+      {
+         // Register in the current epoch. If the epoch moved on meanwhile,
+         // a writer may have missed us: try again.
+         auto epoch = _epoch.load();
+         auto& readers = _stripes[epoch % 3][stripe_].readers;
+         readers.fetch_add(1);
+         if (_epoch.load() == epoch)
+            return { _ptr.load(), &readers };
+         readers.fetch_sub(1, std::memory_order_release);
+      }
+   }
+
+   template <typename T>
+   inline void rcu_ptr<T>::publish(std::unique_ptr<T const> p)
+   {
+      if (auto old = _ptr.exchange(p.release()))
+         _retired.emplace_back(old, _epoch.load());
+      reclaim();
+   }
+
+   template <typename T>
+   inline bool rcu_ptr<T>::has_readers(std::uint64_t epoch) const
+   {
+      for (auto const& s : _stripes[epoch % 3])
+      {
+         if (s.readers.load() != 0)
+            return true;
+      }
+      return false;
+   }
+
+   template <typename T>
+   inline void rcu_ptr<T>::reclaim()
+   {
+      if (_retired.empty())
+         return;
+
+      // The epoch advances when the readers of the previous epoch are
+      // done (all readers are then in the current epoch). An object
+      // retired in epoch e is unreachable from epoch e + 1 on, and once in
+      // epoch e + 2, the readers of epoch e are done with it.
+      for (int i = 0; i != 2; ++i)
+      {
+         auto epoch = _epoch.load();
+         if (has_readers(epoch - 1))
+            break;
+         _epoch.store(epoch + 1);
+      }
+
+      auto epoch = _epoch.load();
+      auto i = _retired.begin();
+      for (; i != _retired.end() && i->second + 2 <= epoch; ++i)
+         delete i->first;
+      _retired.erase(_retired.begin(), i);
+   }
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_RT_CHECK_HPP_NOVEMBER_12_2019)
+#define QPLUG_RT_CHECK_HPP_NOVEMBER_12_2019
+
+#include <cstddef>
+#include <cstdio>
+
+namespace cycfi::qplug::rt_check
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // Realtime safety checker. In builds with QPLUG_RT_CHECK (Linux only),
+   // memory allocation, mutex locking and file I/O are intercepted, and
+   // calls made by a thread inside a scope (e.g. the audio callback) are
+   // recorded as violations, with a stack trace. Otherwise, everything here
+   // compiles to nothing.
+   //
+   // The interception replaces malloc and friends in the executable, so it
+   // is meant for the headless tools and tests, not for plugins loaded by
+   // a host.
+   //
+   // Scopes nest. A scope with a null `where` turns checking off until it
+   // ends. Work handed to other threads on behalf of a scope (e.g. by
+   // worker_pool) is checked by entering current() on those threads.
+   ////////////////////////////////////////////////////////////////////////////
+   class scope
+   {
+   public:
+#if defined(QPLUG_RT_CHECK)
+      explicit                scope(char const* where);
+                              ~scope();
+#else
+      explicit                scope(char const* /*where*/) {}
+#endif
+                              scope(scope const&) = delete;
+
+   private:
+#if defined(QPLUG_RT_CHECK)
+      char const*             _outer;
+#endif
+   };
+
+#if defined(QPLUG_RT_CHECK)
+   constexpr bool             enabled = true;
+
+   char const*                current();
+   std::size_t                violations();
+   void                       print_report(std::FILE* out);
+   void                       reset();
+#else
+   constexpr bool             enabled = false;
+
+   inline char const*         current() { return nullptr; }
+   inline std::size_t         violations() { return 0; }
+   inline void                print_report(std::FILE* /*out*/) {}
+   inline void                reset() {}
+#endif
+}
+
+#endif
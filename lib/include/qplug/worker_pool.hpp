@@ -0,0 +1,90 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_WORKER_POOL_HPP_NOVEMBER_10_2019)
+#define QPLUG_WORKER_POOL_HPP_NOVEMBER_10_2019
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace cycfi::qplug
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // worker_pool: Runs a batch of jobs on a set of worker threads and the
+   // calling thread, returning only when all jobs are done. Intended to be
+   // called from the audio thread: run does not allocate and never takes a
+   // lock. Jobs are claimed from an atomic counter and the caller spins on
+   // a completion count (the barrier) while helping with the jobs.
+   //
+   // Idle workers spin briefly before going to sleep, so back to back
+   // blocks are picked up immediately. Waking sleeping workers is a
+   // notification only; if one is missed, the worker wakes up on its own
+   // shortly after and the caller does the remaining work in the meantime.
+   //
+   // The workers run the jobs inside the caller's rt_check::scope.
+   ////////////////////////////////////////////////////////////////////////////
+   class worker_pool
+   {
+   public:
+
+      explicit                worker_pool(std::size_t num_workers = default_size());
+                              worker_pool(worker_pool const&) = delete;
+                              ~worker_pool();
+
+      // Call f(i) for all i in [0, n). f may be called concurrently.
+                              template <typename F>
+      void                    run(std::size_t n, F&& f);
+
+      std::size_t             size() const { return _workers.size(); }
+      static std::size_t      default_size();
+
+   private:
+
+      using job_function = void(*)(void* context, std::size_t i);
+
+      void                    run(std::size_t n, job_function f, void* context);
+      void                    work(std::uint32_t generation);
+      void                    worker();
+
+      // The generation (upper 32 bits) and the next job index (lower 32
+      // bits), packed so that claiming a job can never cross generations.
+      std::atomic<std::uint64_t> _jobs{ 0 };
+      std::atomic<std::size_t>   _num_jobs{ 0 };
+      std::atomic<job_function>  _function{ nullptr };
+      std::atomic<void*>         _context{ nullptr };
+      std::atomic<std::size_t>   _done{ 0 };
+      std::atomic<char const*>   _scope{ nullptr };
+
+      std::atomic<bool>          _stop{ false };
+      std::atomic<int>           _sleeping{ 0 };
+      std::mutex                 _mutex;
+      std::condition_variable    _wakeup;
+      std::vector<std::thread>   _workers;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename F>
+   inline void worker_pool::run(std::size_t n, F&& f)
+   {
+      using function_type = std::remove_reference_t<F>;
+      run(n,
+         [](void* context, std::size_t i)
+         {
+            (*static_cast<function_type*>(context))(i);
+         },
+         const_cast<void*>(static_cast<void const*>(&f))
+      );
+   }
+}
+
+#endif
@@ -4,16 +4,32 @@
    Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
 =============================================================================*/
 #include <qplug/controller.hpp>
-#include <qplug/presets.hpp>
+#include <qplug/directory_watcher.hpp>
+#include <qplug/factory_presets.hpp>
+#include <qplug/persistent_map.hpp>
+#include <qplug/preset_reader.hpp>
+#include <qplug/preset_bank.hpp>
+#include <qplug/preset_store.hpp>
+#include <qplug/preset_journal.hpp>
+#include <qplug/program_index.hpp>
+#include <qplug/rcu_ptr.hpp>
 #include <infra/filesystem.hpp>
 #include <elements/support/resource_paths.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <cstdlib>
 #include <fstream>
+#include <optional>
+#include <tuple>
+#include <unordered_set>
 
 #if defined(IPLUG2)
 # include "iplug2/iplug2_plugin.hpp"
+#elif defined(QPLUG_HEADLESS)
+# include "headless/headless_plugin.hpp"
 #endif
 
 #if defined(_WIN32)
@@ -23,9 +39,6 @@
 
 namespace cycfi::qplug
 {
-   using preset_info = std::map<std::string, double>;
-   using preset_info_map = std::map<std::string, preset_info>;
-
 #if defined(__APPLE__)
    fs::path home = getenv("HOME");
    fs::path presets_parent = home / "Library/Audio/Presets";
@@ -60,6 +73,22 @@ namespace cycfi::qplug
       return get_preset_path();
    }
 
+#endif
+
+#if defined(__linux__)
+
+   fs::path presets_path()
+   {
+      fs::path base;
+      if (auto data_home = getenv("XDG_DATA_HOME"))
+         base = data_home;
+      else if (auto home = getenv("HOME"))
+         base = fs::path{ home } / ".local/share";
+      else
+         base = fs::temp_directory_path();
+      return base / PLUG_MFR;
+   }
+
 #endif
 
    fs::path presets_file()
@@ -67,46 +96,463 @@ namespace cycfi::qplug
       return presets_path() / PLUG_NAME"_presets.json";
    }
 
-   // Factory presets:
-   preset_info_map   _factory_presets;
-   std::mutex        _factory_presets_mutex;
+   fs::path presets_bank_file()
+   {
+      return presets_path() / PLUG_NAME"_presets.qpb";
+   }
+
+   fs::path presets_journal_file()
+   {
+      return presets_path() / PLUG_NAME"_presets.journal";
+   }
+
+   // The published user presets, one store (of one preset) each, by name
+   using user_preset_map =
+      persistent_map<std::string_view, std::shared_ptr<preset_store const>>;
+
+   // The preset list, sorted: presets without a Program ID first (the
+   // factory presets, then the user presets, by name), then the rest by
+   // ID. The presets with an ID are keyed by ID only.
+   struct preset_list_key
+   {
+      int                  id;
+      int                  source;  // 0: factory, 1: user
+      std::string_view     name;
+
+      bool operator<(preset_list_key const& rhs) const
+      {
+         return std::tie(id, source, name) < std::tie(rhs.id, rhs.source, rhs.name);
+      }
+   };
+
+   using preset_list_map = persistent_map<preset_list_key, std::string_view>;
+
+   // The presets are shared by all instances. Writers (loading, saving and
+   // deleting) take turns under _presets_mutex, and publish an immutable
+   // snapshot of the presets when done. Readers never lock: they read the
+   // current snapshot (see rcu_ptr).
+   //
+   // The snapshots share what did not change: saving or deleting a preset
+   // only copies that preset, and updates the indexes and the preset list
+   // in O(log n).
+   struct preset_snapshot
+   {
+      std::shared_ptr<preset_bank const>     factory_bank;
+      std::shared_ptr<preset_store const>    factory_presets;
+      std::shared_ptr<program_index const>   factory_programs;
+      std::shared_ptr<preset_bank const>     bank;
+      user_preset_map                        presets;
+      std::shared_ptr<program_index const>   programs;
+      std::uint64_t                          generation = 0;
+      preset_list_map                        preset_list;
+   };
+
+   // Factory presets, compiled into the plugin, or from
+   // factory_presets.qpb if there is one, or else from
+   // factory_presets.json:
+   std::shared_ptr<preset_bank>           _factory_bank = std::make_shared<preset_bank>();
+   std::shared_ptr<preset_store const>    _factory_presets = std::make_shared<preset_store>();
+   std::shared_ptr<program_index const>   _factory_programs = std::make_shared<program_index>();
+
+   // User presets. A user bank is decoded into _presets before the first
+   // save or delete (and is then left out of the snapshots).
+   std::shared_ptr<preset_bank>           _bank = std::make_shared<preset_bank>();
+   bool                                   _bank_decoded = false;
+   preset_store                           _presets;
+   program_index                          _programs;
+   user_preset_map                        _published_presets;
+   preset_list_map                        _preset_list;
+
+   std::uint64_t                          _generation = 0;
+   std::mutex                             _presets_mutex;
+
+   // Preset names, as given out by the program indexes (e.g. by
+   // preset_list). They are never freed, so that they remain valid when
+   // presets are deleted, or banks unmapped. Requires _presets_mutex.
+   std::unordered_set<std::string>        _preset_names;
+
+   std::string_view intern(std::string_view name)
+   {
+      return *_preset_names.emplace(name).first;
+   }
+
+   // A user preset takes the ID from a factory preset
+   preset_list_map make_preset_list(
+      program_index const& factory_programs
+    , program_index const& programs)
+   {
+      preset_list_map r;
+      auto&& add =
+         [&r](program_index const& index, int source)
+         {
+            index.for_each(
+               [&](std::string_view name, int id)
+               {
+                  if (id < 0)
+                     r.set({ -1, source, name }, name);
+                  else if (index.find(id) == name)
+                     r.set({ id, 0, {} }, name);
+               }
+            );
+         };
+
+      add(factory_programs, 0);
+      add(programs, 1);
+      return r;
+   }
+
+   // Update the preset list for the Program ID. Requires _presets_mutex.
+   void update_preset_list(int id)
+   {
+      auto name = _programs.find(id);
+      if (name.empty())
+         name = _factory_programs->find(id);
+      if (name.empty())
+         _preset_list.erase({ id, 0, {} });
+      else
+         _preset_list.set({ id, 0, {} }, name);
+   }
+
+   // A copy of the preset, in a store of its own
+   std::shared_ptr<preset_store const> copy_preset(preset_store const& presets, int preset)
+   {
+      auto copy = std::make_shared<preset_store>(presets.num_params());
+      auto i = copy->add(presets.name(preset));
+      presets.for_each(preset,
+         [&copy, i](int param, double value) { copy->set(i, param, value); }
+      );
+      return copy;
+   }
+
+   // Requires _presets_mutex
+   user_preset_map make_user_preset_map(preset_store const& presets)
+   {
+      user_preset_map r;
+      presets.for_each_preset(
+         [&](std::string_view name, int preset)
+         {
+            r.set(intern(name), copy_preset(presets, preset));
+         }
+      );
+      return r;
+   }
+
+   std::unique_ptr<preset_snapshot const> make_snapshot()
+   {
+      auto snapshot = std::make_unique<preset_snapshot>();
+      if (_factory_bank->is_open())
+         snapshot->factory_bank = _factory_bank;
+      snapshot->factory_presets = _factory_presets;
+      snapshot->factory_programs = _factory_programs;
+      if (!_bank_decoded && _bank->is_open())
+         snapshot->bank = _bank;
+      snapshot->presets = _published_presets;
+      snapshot->programs = std::make_shared<program_index const>(_programs);
+      snapshot->generation = _generation;
+      snapshot->preset_list = _preset_list;
+      return snapshot;
+   }
+
+   rcu_ptr<preset_snapshot> _snapshot{ make_snapshot() };
+
+   // The current presets. Hold on to the reader while using them.
+   rcu_ptr<preset_snapshot>::reader current_presets()
+   {
+      return _snapshot.read();
+   }
+
+   // Publish the presets, after _published_presets, _programs and
+   // _preset_list are updated. Requires _presets_mutex.
+   void publish_snapshot()
+   {
+      ++_generation;
+      _snapshot.publish(make_snapshot());
+   }
+
+   // Publish all the presets, after they are (re)loaded. Requires
+   // _presets_mutex.
+   void publish_presets()
+   {
+      _published_presets = make_user_preset_map(_presets);
+      _preset_list = make_preset_list(*_factory_programs, _programs);
+      publish_snapshot();
+   }
+
+   // Saved and deleted user presets are written to the journal, and the
+   // presets file is rewritten (compacted) after every
+   // journal_compact_size changes.
+   preset_journal    _journal;
+   constexpr std::size_t journal_compact_size = 64;
+
+   // Loading is shared by all instances, and may run in the background
+   std::mutex        _load_mutex;
+
+   // The size and time of a file, to tell when it is rewritten
+   using file_stamp = std::pair<std::uintmax_t, fs::file_time_type>;
+
+   file_stamp stamp_file(fs::path const& path)
+   {
+      std::error_code ec;
+      auto size = fs::file_size(path, ec);
+      if (ec)
+         return {};
+      return { size, fs::last_write_time(path, ec) };
+   }
+
+   // The user presets files (JSON and bank)
+   using presets_stamp = std::pair<file_stamp, file_stamp>;
+
+   presets_stamp stamp_user_presets()
+   {
+      return { stamp_file(presets_file()), stamp_file(presets_bank_file()) };
+   }
+
+   // The user presets files as last loaded or written by this process. If
+   // they change, another process rewrote them. Set by the loads and by
+   // compaction, on the journal's writer, hence its own mutex.
+   presets_stamp     _presets_stamp;
+   std::mutex        _stamp_mutex;
+
+   presets_stamp get_presets_stamp()
+   {
+      std::lock_guard<std::mutex> lock(_stamp_mutex);
+      return _presets_stamp;
+   }
+
+   void set_presets_stamp(presets_stamp const& stamp)
+   {
+      std::lock_guard<std::mutex> lock(_stamp_mutex);
+      _presets_stamp = stamp;
+   }
+
+   // The number of times the presets were changed by another process
+   std::atomic<std::uint64_t> _external_changes{ 0 };
+
+   // Watches the user presets files for changes by other processes (see
+   // reload_user_presets). Started by the first load.
+   std::unique_ptr<directory_watcher> _watcher;
+
+   // A preset, in one of the preset stores or banks
+   struct preset_ref
+   {
+      preset_store const*  store = nullptr;
+      preset_bank const*   bank = nullptr;
+      int                  index = -1;
+
+      explicit operator bool() const { return store || bank; }
 
-   // User presets:
-   preset_info_map   _presets;
-   std::mutex        _presets_mutex;
+      // f(param, value) for each parameter in the preset
+      template <typename F>
+      void for_each(F&& f) const
+      {
+         if (store)
+            store->for_each(index, f);
+         else
+            bank->for_each(index, f);
+      }
+
+      std::optional<double> get(int param) const
+      {
+         if (store && store->has(index, param))
+            return store->value(index, param);
+         if (bank && bank->has(index, param))
+            return bank->value(index, param);
+         return {};
+      }
+   };
+
+   preset_ref lookup_preset(
+      preset_store const& presets, preset_bank const* bank, std::string_view name)
+   {
+      if (auto i = presets.find(name); i >= 0)
+         return { &presets, nullptr, i };
+      if (bank)
+      {
+         if (auto i = bank->find(name); i >= 0)
+            return { nullptr, bank, i };
+      }
+      return {};
+   }
+
+   preset_ref find_user_preset(preset_snapshot const& presets, std::string_view name)
+   {
+      if (auto preset = presets.presets.find(name))
+         return { preset->get(), nullptr, 0 };
+      if (auto bank = presets.bank.get())
+      {
+         if (auto i = bank->find(name); i >= 0)
+            return { nullptr, bank, i };
+      }
+      return {};
+   }
+
+   preset_ref find_factory_preset(preset_snapshot const& presets, std::string_view name)
+   {
+      return lookup_preset(*presets.factory_presets, presets.factory_bank.get(), name);
+   }
+
+   // A user preset first
+   preset_ref lookup_preset(preset_snapshot const& presets, std::string_view name)
+   {
+      auto preset = find_user_preset(presets, name);
+      return preset? preset : find_factory_preset(presets, name);
+   }
+
+   // Presets store notes as MIDI notes. The backends and the processor see
+   // them as enumerations starting at 0 (the _min note).
+   double plain_value(parameter const& param, double preset_value)
+   {
+      return (param._type == parameter::note)? preset_value - param._min : preset_value;
+   }
+
+   // f(name, preset) for each preset in the store and bank
+   template <typename F>
+   void visit_presets(preset_store const& presets, preset_bank const* bank, F&& f)
+   {
+      presets.for_each_preset(
+         [&](std::string_view name, int i)
+         {
+            f(name, preset_ref{ &presets, nullptr, i });
+         }
+      );
+      for (std::size_t i = 0; bank && i != bank->size(); ++i)
+         f(bank->name(i), preset_ref{ nullptr, bank, int(i) });
+   }
+
+   int program_id_param(controller::parameter_list params)
+   {
+      int i = 0;
+      for (auto const& param : params)
+      {
+         if (std::strcmp(param._name, "Program ID") == 0)
+            return i;
+         ++i;
+      }
+      return -1;
+   }
+
+   int program_id(preset_ref preset, int id_param)
+   {
+      auto id = preset.get(id_param);
+      return id? int(*id) : -1;
+   }
+
+   // Requires _presets_mutex
+   void index_programs(
+      program_index& programs
+    , preset_store const& presets
+    , preset_bank const* bank
+    , controller::parameter_list params)
+   {
+      auto id_param = program_id_param(params);
+      programs.clear();
+      visit_presets(presets, bank,
+         [&](std::string_view name, preset_ref preset)
+         {
+            programs.set(intern(name), program_id(preset, id_param));
+         }
+      );
+   }
+
+   // The preset with the Program ID, a factory preset first
+   std::string_view program_owner(
+      program_index const& factory_programs, program_index const& programs, int id)
+   {
+      if (auto name = factory_programs.find(id); !name.empty())
+         return name;
+      return programs.find(id);
+   }
+
+   // Update the published presets, the program index and the preset list
+   // for the one user preset that was saved or deleted. The rest is
+   // shared with the current snapshot. Requires _presets_mutex.
+   void update_user_preset(std::string_view name, int id_param)
+   {
+      name = intern(name);
+      auto old_id = _programs.find(name);
+      _preset_list.erase({ -1, 1, name });
+
+      if (auto preset = _presets.find(name); preset >= 0)
+      {
+         _published_presets.set(name, copy_preset(_presets, preset));
+         _programs.set(name, program_id({ &_presets, nullptr, preset }, id_param));
+         if (auto id = _programs.find(name); id < 0)
+            _preset_list.set({ -1, 1, name }, name);
+         else
+            update_preset_list(id);
+      }
+      else
+      {
+         _published_presets.erase(name);
+         _programs.erase(name);
+      }
+
+      if (old_id >= 0)
+         update_preset_list(old_id);
+   }
+
+   // Before modifying the user presets. Requires _presets_mutex.
+   void prepare_user_presets(controller::parameter_list params)
+   {
+      if (_presets.empty())
+         _presets.reset(params.size());
+      if (!_journal.is_open())
+         _journal.open(presets_journal_file(), params);
+
+      if (_bank_decoded || !_bank->is_open())
+         return;
+
+      for (std::size_t i = 0; i != _bank->size(); ++i)
+      {
+         auto preset = _presets.add(_bank->name(i));
+         _bank->for_each(i,
+            [preset](int param, double value)
+            {
+               _presets.set(preset, param, value);
+            }
+         );
+      }
+      _bank_decoded = true;
+      _published_presets = make_user_preset_map(_presets);
+   }
+
+   bool is_newer(fs::path const& a, fs::path const& b)
+   {
+      std::error_code ec;
+      auto a_time = fs::last_write_time(a, ec);
+      if (ec)
+         return false;
+      auto b_time = fs::last_write_time(b, ec);
+      return ec || a_time >= b_time;
+   }
 
    bool load_all_presets(
       std::string const& src
     , controller::parameter_list params
-    , preset_info_map& presets)
+    , preset_store& presets)
    {
-      char const* f = src.data();
-      char const* l = f + src.size();
-      std::string current_preset;
+      int current_preset = -1;
+      presets.reset(params.size());
 
       auto&& on_param =
-         [&presets, &current_preset](auto const& p, parameter const& param)
+         [&presets, &current_preset, params](auto const& p, parameter const& param)
          {
-            std::string key(p.first.begin(), p.first.end());
-            presets[current_preset][key] = p.second;
+            presets.set(current_preset, int(&param - params.begin()), p.second);
          };
 
       auto&& on_preset_name =
-         [&current_preset](std::string_view name)
+         [&presets, &current_preset](std::string_view name)
          {
-            current_preset = std::string(name.begin(), name.end());
+            current_preset = presets.add(name);
          };
 
-      auto attr = for_each_preset(params, on_param, on_preset_name);
-      if (x3::phrase_parse(f, l, preset_parser{}, x3::space, attr))
-         return true;
-      return false;
+      return read_presets(src, parameter_names{ params }, on_param, on_preset_name);
    }
 
    bool load_all_presets(
       fs::path const& preset_file
     , controller::parameter_list params
-    , preset_info_map& presets)
+    , preset_store& presets)
    {
       if (!fs::exists(preset_file))
          return false;
@@ -119,94 +565,302 @@ namespace cycfi::qplug
       return load_all_presets(src, params, presets);
    }
 
-   bool load_all_presets(controller::parameter_list params)
+   // Factory presets compiled into the plugin (see factory_presets.hpp).
+   // The table was checked against the parameters when it was built.
+   void load_compiled_presets(
+      factory_preset_table const& table
+    , controller::parameter_list params
+    , preset_store& presets)
+   {
+      presets.reset(params.size());
+      if (table.num_params != params.size())
+         return;
+
+      for (std::size_t i = 0; i != table.size; ++i)
+      {
+         auto const& preset = table.presets[i];
+         auto id = presets.add(preset.name);
+         for (std::size_t j = 0; j != preset.size; ++j)
+            presets.set(id, preset.values[j].param, preset.values[j].value);
+      }
+   }
+
+   // Write all the user presets to the presets file, and to the user
+   // bank if there is one. Succeeds if the presets file was written; if
+   // only the bank fails, the (newer) presets file is used next time.
+   bool write_user_presets(user_preset_map const& presets, controller::parameter_list params)
    {
-      bool no_user_presets = false;
       try
       {
          if (!fs::exists(presets_path()))
             fs::create_directory(presets_path());
+
+         // Write to a temporary file first, so that the presets file is
+         // never left half written
+         auto tmp = presets_file();
+         tmp += ".tmp";
+         std::ofstream file(tmp);
+
+         file << '{';
+         int i = 0;
+         presets.for_each(
+            [&](std::string_view name, auto const& preset)
+            {
+               file << ((i++ == 0)? "\n" : ",\n");
+               file << "  \"" << name << "\" : {";
+               int j = 0;
+               preset->for_each(0,
+                  [&](int param, double val)
+                  {
+                     file << ((j++ == 0)? "\n" : ",\n");
+                     file << "    \"" << params[param]._name << "\" : ";
+                     params[param].print(file, val);
+                  }
+               );
+               file << "\n  }";
+            }
+         );
+         file << "\n}\n";
+         file.close();
+         if (!file)
+            return false;
+         fs::rename(tmp, presets_file());
+
+         // Keep the user bank, if there is one, in sync
+         if (fs::exists(presets_bank_file()))
+         {
+            preset_bank_writer bank{ params };
+            presets.for_each(
+               [&](std::string_view name, auto const& preset)
+               {
+                  bank.add_preset(name);
+                  preset->for_each(0,
+                     [&bank](int param, double value) { bank.set(param, value); }
+                  );
+               }
+            );
+            bank.write(presets_bank_file());
+         }
       }
       catch (fs::filesystem_error fe)
       {
-         no_user_presets = true;
+         return false;
       }
       catch (...)
       {
-         no_user_presets = true;
+         return false;
       }
+      return true;
+   }
 
-      // Load factory presets
-      if (_factory_presets.empty())
-      {
-         fs::path full_path = elements::find_file("factory_presets.json");
-         preset_info_map loading_presets;
-         if (load_all_presets(full_path, params, loading_presets))
+   // Rewrite the presets file in the background, with the published user
+   // presets. Requires _presets_mutex.
+   //
+   // The presets are taken when the file is written, with the position
+   // in the journal they include, so that the records other processes
+   // appended (and that were not replayed here yet) are kept in the
+   // journal. Don't wait for the journal while holding _presets_mutex: the
+   // journal's writer takes it here.
+   void compact_user_presets(controller::parameter_list params)
+   {
+      _journal.compact(
+         [params]() -> std::uint64_t
          {
-            std::lock_guard<std::mutex> lock(_factory_presets_mutex);
-            _factory_presets.swap(loading_presets);
+            user_preset_map presets;
+            std::uint64_t pos;
+            {
+               std::lock_guard<std::mutex> lock(_presets_mutex);
+               presets = _published_presets;
+               pos = _journal.replayed();
+            }
+            if (!write_user_presets(presets, params))
+               return 0;
+            set_presets_stamp(stamp_user_presets());
+            return pos;
          }
-      }
+      );
+   }
 
-      // Load user presets
-      if (!no_user_presets && _presets.empty())
+   bool has_journal()
+   {
+      std::error_code ec;
+      auto size = fs::file_size(presets_journal_file(), ec);
+      return !ec && size > 2 * sizeof(std::uint32_t);
+   }
+
+   // Load the user presets files: the bank, unless the JSON file is newer
+   // (e.g. it was edited by hand). Returns true if the bank was opened.
+   bool load_user_presets(
+      controller::parameter_list params, preset_bank& bank, preset_store& presets)
+   {
+      if (is_newer(presets_bank_file(), presets_file())
+         && bank.open(presets_bank_file(), params))
+         return true;
+      load_all_presets(presets_file(), params, presets);
+      return false;
+   }
+
+   // Pick up the changes another process made to the user presets, on the
+   // watcher's thread. New journal records are read and applied as they
+   // come. If the presets files were rewritten (another process compacted
+   // its journal), they are loaded again, outside the lock, and the
+   // journal is applied from the start. Readers are never blocked: they
+   // see the changes once they are published.
+   void reload_user_presets(controller::parameter_list params)
+   {
+      std::optional<presets_stamp> loaded;
+      auto loading_bank = std::make_shared<preset_bank>();
+      preset_store loading_presets;
+      for (;;)
       {
-         preset_info_map loading_presets;
-         if (load_all_presets(presets_file(), params, loading_presets))
+         // The changes made here are applied already. The journal is
+         // replayed in the order it was written, theirs included, so wait
+         // until it is all written.
+         _journal.flush();
          {
             std::lock_guard<std::mutex> lock(_presets_mutex);
-            _presets.swap(loading_presets);
+            if (!_journal.is_open())
+               return;
+            if (!_journal.idle())
+               continue;
+
+            std::error_code ec;
+            auto journal_size = fs::file_size(presets_journal_file(), ec);
+            auto stamp = stamp_user_presets();
+            bool rewritten = stamp != get_presets_stamp()
+               || (!ec && journal_size < _journal.replayed());
+
+            if (!rewritten || loaded == stamp)
+            {
+               if (rewritten)
+               {
+                  _bank = loading_bank;
+                  _bank_decoded = false;
+                  _presets.swap(loading_presets);
+                  set_presets_stamp(stamp);
+                  _journal.rewind();
+               }
+
+               std::size_t applied = 0;
+               if (!ec && journal_size > std::max<std::uint64_t>(
+                  _journal.replayed(), 2 * sizeof(std::uint32_t)))
+               {
+                  prepare_user_presets(params);
+                  applied = _journal.replay_more(_presets);
+               }
+
+               if (rewritten || applied)
+               {
+                  index_programs(
+                     _programs, _presets, _bank_decoded? nullptr : _bank.get(), params);
+                  publish_presets();
+                  ++_external_changes;
+               }
+               return;
+            }
+
+            // Load the files first (again, if they changed meanwhile)
+            loaded = stamp;
          }
-      }
 
-      return !no_user_presets;
+         loading_bank = std::make_shared<preset_bank>();
+         loading_presets.reset(params.size());
+         if (!load_user_presets(params, *loading_bank, loading_presets))
+            loading_bank->close();
+      }
    }
 
-   bool save_all_presets(controller::parameter_list params)
+   bool load_all_presets(controller::parameter_list params)
    {
+      std::lock_guard<std::mutex> load_lock(_load_mutex);
+      bool no_user_presets = false;
       try
       {
          if (!fs::exists(presets_path()))
             fs::create_directory(presets_path());
+      }
+      catch (fs::filesystem_error fe)
+      {
+         no_user_presets = true;
+      }
+      catch (...)
+      {
+         no_user_presets = true;
+      }
 
-         std::ofstream file(presets_file());
+      // Load factory presets. The bank is only mapped here; its presets
+      // are decoded as they are used.
+      if (_factory_presets->empty() && !_factory_bank->is_open())
+      {
+         auto loading_bank = std::make_shared<preset_bank>();
+         auto loading_presets = std::make_shared<preset_store>();
+         if (auto table = compiled_factory_presets())
+         {
+            load_compiled_presets(*table, params, *loading_presets);
+         }
+         else if (!loading_bank->open(elements::find_file("factory_presets.qpb"), params)
+            && !load_all_presets(
+               elements::find_file("factory_presets.json"), params, *loading_presets))
+         {
+            loading_presets = std::make_shared<preset_store>();
+         }
 
+         auto programs = std::make_shared<program_index>();
          std::lock_guard<std::mutex> lock(_presets_mutex);
+         index_programs(*programs, *loading_presets, loading_bank.get(), params);
+         _factory_bank = loading_bank;
+         _factory_presets = loading_presets;
+         _factory_programs = programs;
+         publish_presets();
+      }
 
-         file << '{';
-         int i = 0;
-         for (auto const& [name, program] : _presets)
+      // Load user presets
+      std::lock_guard<std::mutex> lock(_presets_mutex);
+      if (!no_user_presets && _presets.empty() && !_bank->is_open())
+      {
+         auto loading_bank = std::make_shared<preset_bank>();
+         preset_store loading_presets;
+         set_presets_stamp(stamp_user_presets());
+         if (load_user_presets(params, *loading_bank, loading_presets))
          {
-            file << ((i++ == 0)? "\n" : ",\n");
-            file << "  \"" << name << "\" : {";
-            int j = 0;
-            for (auto const& param : params)
-            {
-               // Continue if we do not have such a field
-               auto name = param._name;
-               auto iter = program.find(name);
-               if (iter == program.end())
-                  continue;
-
-               file << ((j++ == 0)? "\n" : ",\n");
-               file << "    \"" << name << "\" : ";
+            _bank = loading_bank;
+            _bank_decoded = false;
+         }
+         else
+         {
+            _presets.swap(loading_presets);
+         }
 
-               auto val = iter->second;
-               param.print(file, val);
-            }
-            file << "\n  }";
+         // Fold in the changes since the last compaction
+         if (!_journal.is_open())
+            _journal.open(presets_journal_file(), params);
+         bool replayed = false;
+         if (has_journal())
+         {
+            prepare_user_presets(params);
+            replayed = _journal.replay(_presets) > 0;
          }
-         file << "\n}\n";
+         index_programs(_programs, _presets, _bank_decoded? nullptr : _bank.get(), params);
+         publish_presets();
+         if (replayed)
+            compact_user_presets(params);
       }
-      catch (fs::filesystem_error fe)
-      {
-         return false;
-      }
-      catch (...)
+
+      // Keep up with the changes other processes make
+      if (!no_user_presets && !_watcher)
       {
-         return false;
+         _watcher = std::make_unique<directory_watcher>(
+            presets_path()
+          , directory_watcher::file_names{
+               presets_file().filename().string()
+             , presets_bank_file().filename().string()
+             , presets_journal_file().filename().string()
+            }
+          , [params] { reload_user_presets(params); }
+         );
       }
-      return true;
+
+      return !no_user_presets;
    }
 
    controller::controller(base_controller& base)
@@ -232,10 +886,33 @@ namespace cycfi::qplug
       on_set_parameter(id, value);
    }
 
-   void controller::recall_parameter(int id, double value)
+   void controller::recall_parameters(parameter_value_list& values)
    {
-      _base.recall_parameter(id, value);
-      on_recall_parameter(id, value);
+      // values are plain. Keep only the ones that change, normalized.
+      auto last = values.begin();
+      for (auto v : values)
+      {
+         v.value = normalize_parameter(v.id, v.value);
+         if (v.value != get_parameter_normalized(v.id))
+            *last++ = v;
+      }
+      values.erase(last, values.end());
+      if (values.empty())
+         return;
+
+      _base.recall_parameters(values);
+
+      if (auto view_ = view())
+      {
+         _recalling = true;
+         for (auto const& v : values)
+            update_ui_parameter(v.id, get_parameter_normalized(v.id));
+         _recalling = false;
+         view_->refresh();
+      }
+
+      for (auto const& v : values)
+         on_recall_parameter(v.id, v.value);
    }
 
    void controller::begin_edit(int id)
@@ -287,101 +964,180 @@ namespace cycfi::qplug
 
    bool controller::load_all_presets()
    {
-      return qplug::load_all_presets(parameters());
+      if (_presets_loading.valid())
+      {
+         _presets_loading.wait();
+         poll_presets();
+         return _user_presets;
+      }
+      _external_changes_seen = _external_changes;
+      _user_presets = qplug::load_all_presets(parameters());
+      _presets_loaded = true;
+      return _user_presets;
    }
 
-   bool controller::load_preset(std::string_view name)
+   void controller::load_all_presets_async()
    {
-      if (name == "Default")
+      if (_presets_loaded || _presets_loading.valid())
+         return;
+      _presets_loading = std::async(std::launch::async,
+         [params = parameters()]
+         {
+            return qplug::load_all_presets(params);
+         }
+      );
+   }
+
+   void controller::poll_presets()
+   {
+      using namespace std::chrono_literals;
+      poll_morph();
+      if (_presets_loaded)
       {
-         int i = 0;
-         for (auto const& param : parameters())
+         if (auto changes = _external_changes.load(); changes != _external_changes_seen)
          {
-            auto val = normalize_parameter(i, param._init);
-            recall_parameter(i++, val);
+            _external_changes_seen = changes;
+            on_presets_changed();
          }
-         return true;
+         return;
       }
 
-      std::lock_guard<std::mutex> lock1(_presets_mutex);
-      std::lock_guard<std::mutex> lock2(_factory_presets_mutex);
+      if (!_presets_loading.valid()
+         || _presets_loading.wait_for(0s) != std::future_status::ready)
+         return;
 
-      auto preset_iter = _presets.find(std::string(name.begin(), name.end()));
-      auto preset_iter_end =_presets.end();
+      _external_changes_seen = _external_changes;
+      _user_presets = _presets_loading.get();
+      _presets_loaded = true;
+      on_presets_loaded();
+   }
 
-      if (preset_iter == _presets.end())
-      {
-         preset_iter = _factory_presets.find(std::string(name.begin(), name.end()));
-         preset_iter_end = _factory_presets.end();
-      }
+   void controller::wait_for_presets() const
+   {
+      // Changes to the user presets made before they are loaded would be
+      // lost (or would prevent loading them)
+      if (_presets_loading.valid())
+         _presets_loading.wait();
+   }
 
-      if (preset_iter != preset_iter_end)
+   bool controller::load_preset(std::string_view name)
+   {
+      parameter_value_list values;
+      if (name == "Default")
       {
          int i = 0;
-         auto& preset = preset_iter->second;
          for (auto const& param : parameters())
-         {
-            auto param_iter = preset.find(param._name);
-            if (param_iter != preset.end())
+            values.push_back({ i++, param.init_value() });
+      }
+      else
+      {
+         // Copy the preset, and let go of the presets before recalling it
+         auto params = parameters();
+         auto presets = current_presets();
+         auto preset = lookup_preset(*presets, name);
+         if (!preset)
+            return false;
+
+         values.reserve(params.size());
+         preset.for_each(
+            [&](int i, double value)
             {
-               auto val = normalize_parameter(i, param_iter->second);
-               recall_parameter(i, val);
+               values.push_back({ i, plain_value(params[i], value) });
             }
-            ++i;
-         }
-         return true;
+         );
       }
-      return false;
+
+      recall_parameters(values);
+      return true;
    }
 
-   std::string_view controller::find_preset(int program_id) const
+   bool controller::morph_preset(
+      std::string_view from, std::string_view to, double ms, double switch_point)
    {
-      auto&& find_preset = [program_id](auto const& presets) -> std::string_view
+      // Both start from the current values. Presets only have the
+      // parameters saved in them.
+      auto params = parameters();
+      std::vector<double> start(params.size());
+      for (std::size_t i = 0; i != params.size(); ++i)
+         start[i] = get_parameter(int(i));
+      auto end = start;
+
+      auto presets = current_presets();
+      auto overlay = [&](std::string_view name, std::vector<double>& values)
       {
-         for (auto const& [name, program] : presets)
+         if (name == "Default")
          {
-            auto iter = program.find("Program ID");
-            if (iter != program.end() && iter->second == program_id)
-               return name;
+            for (std::size_t i = 0; i != params.size(); ++i)
+               values[i] = params[i].init_value();
+            return true;
          }
-         return "";
+
+         auto preset = lookup_preset(*presets, name);
+         if (!preset)
+            return false;
+         preset.for_each(
+            [&](int i, double value) { values[i] = plain_value(params[i], value); });
+         return true;
       };
 
-      auto r = find_preset(_factory_presets);
-      return r.empty()? find_preset(_presets) : r;
+      if (!from.empty() && !overlay(from, start))
+         return false;
+      if (!overlay(to, end))
+         return false;
+
+      auto id = _base.morph_parameters(start, end, ms, switch_point);
+
+      // The host gets the values a timed morph ends on (see poll_morph)
+      _morph_end.clear();
+      _morph_id = 0;
+      if (ms > 0.0)
+      {
+         for (std::size_t i = 0; i != end.size(); ++i)
+            _morph_end.push_back({ int(i), end[i] });
+         _morph_id = id;
+      }
+      return true;
    }
 
-   int controller::find_preset_id(std::string_view name) const
+   void controller::stop_morph()
    {
-      std::lock_guard<std::mutex> lock1(_presets_mutex);
-      std::lock_guard<std::mutex> lock2(_factory_presets_mutex);
+      _morph_id = 0;
+      _base.stop_morph();
+   }
 
-      auto preset_iter = _presets.find(std::string(name.begin(), name.end()));
-      auto preset_iter_end =_presets.end();
+   void controller::poll_morph()
+   {
+      if (_morph_id == 0 || _base.morph_done() != _morph_id)
+         return;
+      _morph_id = 0;
+      recall_parameters(_morph_end);
+   }
 
-      if (preset_iter == _presets.end())
-      {
-         preset_iter = _factory_presets.find(std::string(name.begin(), name.end()));
-         preset_iter_end = _factory_presets.end();
-      }
+   std::string_view controller::find_preset(int program_id) const
+   {
+      auto presets = current_presets();
+      return program_owner(*presets->factory_programs, *presets->programs, program_id);
+   }
 
-      if (preset_iter != preset_iter_end)
-      {
-         auto const& preset = preset_iter->second;
-         auto iter = preset.find("Program ID");
-         if (iter != preset.end())
-            return iter->second;
-      }
-      return -1;
+   int controller::find_preset_id(std::string_view name) const
+   {
+      auto presets = current_presets();
+      if (presets->programs->has(name))
+         return presets->programs->find(name);
+      return presets->factory_programs->find(name);
    }
 
    void controller::save_preset(std::string_view name) const
    {
+      wait_for_presets();
+      std::lock_guard<std::mutex> lock(_presets_mutex);
       {
-         std::lock_guard<std::mutex> lock(_presets_mutex);
-         auto &preset = _presets[std::string(name.begin(), name.end())];
+         auto params = parameters();
+         auto id_param = program_id_param(params);
+         prepare_user_presets(params);
+         auto preset = _presets.add(name);
          int i = 0;
-         for (auto const &param : parameters())
+         for (auto const &param : params)
          {
             // Skip if we do not want to save this param
             if (!param._save_in_preset)
@@ -395,47 +1151,55 @@ namespace cycfi::qplug
             {
                // See if there's a conflict of IDs
                int pc = get_parameter(i);
-               auto pc_owner = find_preset(pc);
+               auto pc_owner = program_owner(*_factory_programs, _programs, pc);
                if (pc_owner != "" && pc_owner != name)
                {
                   // If there's a conflict, assign the owner_preset's ID with
                   // the preset's old ID
-                  auto& owner_preset = _presets[std::string(pc_owner.begin(), pc_owner.end())];
-                  owner_preset[param._name] = preset[param._name];
+                  auto owner_preset = _presets.add(pc_owner);
+                  _presets.set(owner_preset, i
+                   , _presets.has(preset, i)? _presets.value(preset, i) : 0.0);
+                  _journal.save(_presets, owner_preset);
+                  update_user_preset(pc_owner, id_param);
                }
             }
 
             if (param._type == parameter::note)
             {
                auto range =  param._max - param._min;
-               preset[param._name] =
-                  (get_parameter_normalized(i++) * range) + param._min
-               ;
+               _presets.set(preset, i
+                , (get_parameter_normalized(i) * range) + param._min);
+               ++i;
             }
             else
             {
-               preset[param._name] = get_parameter(i++);
+               _presets.set(preset, i, get_parameter(i));
+               ++i;
             }
          }
+         _journal.save(_presets, preset);
+         update_user_preset(name, id_param);
       }
-      save_all_presets(parameters());
+
+      publish_snapshot();
+      if (_journal.size() >= journal_compact_size)
+         compact_user_presets(parameters());
    }
 
    bool controller::delete_preset(std::string_view name)
    {
-      bool proceed = false;
-      {
-         std::lock_guard<std::mutex> lock(_presets_mutex);
-         auto preset_iter = _presets.find(std::string(name.begin(), name.end()));
-         if (preset_iter != _presets.end())
-         {
-            _presets.erase(preset_iter);
-            proceed = true;
-         }
-      }
-      if (proceed)
-         save_all_presets(parameters());
-      return proceed;
+      wait_for_presets();
+      std::lock_guard<std::mutex> lock(_presets_mutex);
+      prepare_user_presets(parameters());
+      if (!_presets.erase(name))
+         return false;
+
+      _journal.erase(name);
+      update_user_preset(name, program_id_param(parameters()));
+      publish_snapshot();
+      if (_journal.size() >= journal_compact_size)
+         compact_user_presets(parameters());
+      return true;
    }
 
    bool controller::has_preset(int id) const
@@ -445,59 +1209,30 @@ namespace cycfi::qplug
 
    bool controller::has_preset(std::string_view name) const
    {
-      // Search the factory presets
-      if (has_factory_preset(name))
-         return true;
-
-      // Search the user presets
-      std::string preset_name{ name.begin(), name.end() };
-      std::lock_guard<std::mutex> lock(_presets_mutex);
-      auto i = _presets.find(preset_name);
-      return i != _presets.end();
+      return bool(lookup_preset(*current_presets(), name));
    }
 
    bool controller::has_factory_preset(std::string_view name) const
    {
-      // Search the factory presets
-      std::string preset_name{ name.begin(), name.end() };
-      std::lock_guard<std::mutex> lock(_factory_presets_mutex);
-      auto i = _factory_presets.find(preset_name);
-      return i != _factory_presets.end();
+      return bool(find_factory_preset(*current_presets(), name));
+   }
+
+   std::uint64_t controller::presets_generation() const
+   {
+      return current_presets()->generation;
    }
 
    controller::preset_names_list controller::preset_list() const
    {
-      std::map<int, std::string_view> rmap;
+      auto presets = current_presets();
       preset_names_list r;
-
-      auto&& add =
-         [&rmap, &r](auto const& name, auto const& program)
+      r.reserve(presets->preset_list.size());
+      presets->preset_list.for_each(
+         [&r](preset_list_key const& key, std::string_view name)
          {
-            // If there's a "Program ID", we store it in the
-            // result sorted by the ID
-            auto iter = program.find("Program ID");
-            if (iter != program.end())
-               rmap[iter->second] = name;
-            else
-               r.push_back({ name, -1 });
-         };
-
-      // Get the factory presets
-      {
-         std::lock_guard<std::mutex> lock(_factory_presets_mutex);
-         for (auto const& [name, program] : _factory_presets)
-            add(name, program);
-      }
-
-      // Get the user presets
-      {
-         std::lock_guard<std::mutex> lock(_presets_mutex);
-         for (auto const& [name, program] : _presets)
-            add(name, program);
-      }
-
-      for (auto const& [id, name] : rmap)
-         r.push_back({ name, id });
+            r.push_back({ name, key.id });
+         }
+      );
       return r;
    }
 
@@ -505,4 +1240,15 @@ namespace cycfi::qplug
    {
       return _base.host_name();
    }
+
+   void controller::state_changed()
+   {
+      _dirty = true;
+      _base.invalidate_state();
+   }
+
+   load_meter const& controller::dsp_load() const
+   {
+      return _base.dsp_load();
+   }
 }
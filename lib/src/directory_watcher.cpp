@@ -0,0 +1,217 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <qplug/directory_watcher.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <string_view>
+
+#if defined(__linux__)
+# include <fcntl.h>
+# include <poll.h>
+# include <sys/inotify.h>
+# include <unistd.h>
+#endif
+
+namespace cycfi::qplug
+{
+   namespace
+   {
+      // Changes that come within this time of each other are reported
+      // once (e.g. a file being written in several chunks)
+      constexpr int settle_ms = 20;
+   }
+
+   directory_watcher::directory_watcher(
+      fs::path const& dir
+    , file_names files
+    , callback on_change
+    , mode mode_
+    , duration interval
+   )
+    : _dir(dir)
+    , _files(std::move(files))
+    , _on_change(std::move(on_change))
+    , _interval(interval)
+   {
+#if defined(__linux__)
+      if (mode_ == notify)
+      {
+         _notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+         if (_notify_fd >= 0)
+         {
+            auto events = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE
+               | IN_MOVED_FROM | IN_MOVED_TO;
+            if (inotify_add_watch(_notify_fd, _dir.string().c_str(), events) < 0
+               || pipe2(_wake_fd, O_NONBLOCK | O_CLOEXEC) != 0)
+            {
+               ::close(_notify_fd);
+               _notify_fd = -1;
+            }
+         }
+      }
+#endif
+      _polling = _notify_fd < 0;
+      _thread = std::thread{ [this] { watch(); } };
+   }
+
+   directory_watcher::~directory_watcher()
+   {
+      {
+         std::lock_guard<std::mutex> lock(_mutex);
+         _stop = true;
+      }
+      _cond.notify_all();
+#if defined(__linux__)
+      if (_wake_fd[1] >= 0)
+      {
+         char c = 0;
+         [[maybe_unused]] auto r = ::write(_wake_fd[1], &c, 1);
+      }
+#endif
+
+      // Wait for the watcher to be done, then let it go. Don't join: this
+      // may run while a plugin library is being unloaded, where joining
+      // can deadlock (see preset_journal).
+      {
+         std::unique_lock<std::mutex> lock(_mutex);
+         _cond.wait(lock, [this] { return _done; });
+      }
+      if (_thread.joinable())
+         _thread.detach();
+
+#if defined(__linux__)
+      for (auto fd : { _notify_fd, _wake_fd[0], _wake_fd[1] })
+      {
+         if (fd >= 0)
+            ::close(fd);
+      }
+#endif
+   }
+
+   void directory_watcher::watch()
+   {
+      if (_notify_fd >= 0)
+         watch_notify();
+
+      // Poll if notify is not available, or stopped working
+      bool stop;
+      {
+         std::lock_guard<std::mutex> lock(_mutex);
+         stop = _stop;
+      }
+      if (!stop)
+         watch_poll();
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      _done = true;
+      _cond.notify_all();
+   }
+
+   void directory_watcher::watch_notify()
+   {
+#if defined(__linux__)
+      for (;;)
+      {
+         pollfd fds[] = { { _notify_fd, POLLIN, 0 }, { _wake_fd[0], POLLIN, 0 } };
+         if (::poll(fds, 2, -1) < 0)
+         {
+            if (errno == EINTR)
+               continue;
+            break;
+         }
+         if (fds[1].revents)
+            return;
+
+         if (fds[0].revents & POLLIN)
+         {
+            if (!read_events())
+               continue;
+
+            // Let the change settle, then take the rest of it along
+            if (::poll(&fds[1], 1, settle_ms) > 0)
+               return;
+            read_events();
+            _on_change();
+         }
+         else if (fds[0].revents)
+         {
+            break;
+         }
+      }
+
+      // inotify failed. Fall back to polling.
+      ::close(_notify_fd);
+      _notify_fd = -1;
+#endif
+   }
+
+   // True if any of the events is for one of our files
+   bool directory_watcher::read_events()
+   {
+      bool changed = false;
+#if defined(__linux__)
+      alignas(inotify_event) char buff[4096];
+      for (;;)
+      {
+         auto size = ::read(_notify_fd, buff, sizeof(buff));
+         if (size <= 0)
+            break;
+
+         for (char const* p = buff; p < buff + size; )
+         {
+            auto event = reinterpret_cast<inotify_event const*>(p);
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+               changed = true;   // Events were lost
+            }
+            else if (event->len)
+            {
+               std::string_view name{ event->name };
+               if (std::find(_files.begin(), _files.end(), name) != _files.end())
+                  changed = true;
+            }
+            p += sizeof(inotify_event) + event->len;
+         }
+      }
+#endif
+      return changed;
+   }
+
+   void directory_watcher::watch_poll()
+   {
+      auto last = stat_files();
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (!_cond.wait_for(lock, _interval, [this] { return _stop; }))
+      {
+         lock.unlock();
+         auto files = stat_files();
+         if (files != last)
+         {
+            last = std::move(files);
+            _on_change();
+         }
+         lock.lock();
+      }
+   }
+
+   std::vector<directory_watcher::file_state> directory_watcher::stat_files() const
+   {
+      std::vector<file_state> files;
+      for (auto const& name : _files)
+      {
+         file_state f;
+         std::error_code ec;
+         auto path = _dir / name;
+         f.size = fs::file_size(path, ec);
+         f.exists = !ec;
+         if (f.exists)
+            f.time = fs::last_write_time(path, ec);
+         files.push_back(f);
+      }
+      return files;
+   }
+}
@@ -0,0 +1,175 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <qplug/factory_presets.hpp>
+#include <qplug/preset_reader.hpp>
+#include <qplug/preset_store.hpp>
+
+#include <cmath>
+#include <limits>
+#include <string>
+
+namespace cycfi::qplug
+{
+   namespace
+   {
+      // Set before main, by the generated table (if the plugin has one)
+      factory_preset_table const* _compiled_presets = nullptr;
+
+      // A C++ string literal with the bytes of s
+      void write_string(std::ostream& out, std::string_view s)
+      {
+         static char const* digits = "01234567";
+         out << '"';
+         for (char c : s)
+         {
+            auto uc = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\')
+               out << '\\' << c;
+            else if (uc >= 0x20 && uc < 0x7f)
+               out << c;
+            else  // Octal, which unlike hex takes at most 3 digits
+               out << '\\' << digits[uc >> 6] << digits[(uc >> 3) & 7] << digits[uc & 7];
+         }
+         out << '"';
+      }
+
+      void write_value(std::ostream& out, double value)
+      {
+         if (std::isnan(value))
+            out << "std::numeric_limits<double>::quiet_NaN()";
+         else if (std::isinf(value))
+            out << (value < 0? "-" : "") << "std::numeric_limits<double>::infinity()";
+         else
+            out << value;
+      }
+   }
+
+   bool register_factory_presets(factory_preset_table const& table)
+   {
+      _compiled_presets = &table;
+      return true;
+   }
+
+   factory_preset_table const* compiled_factory_presets()
+   {
+      return _compiled_presets;
+   }
+
+   bool write_factory_presets(
+      std::string_view json
+    , iterator_range<parameter const*> params
+    , std::ostream& out
+    , std::ostream& err
+   )
+   {
+      // Read the presets the way the controller does, so that repeated
+      // presets and parameters come out the same
+      preset_store presets{ params.size() };
+      int current_preset = -1;
+      std::string_view current_name;
+
+      auto&& on_param =
+         [&presets, &current_preset, params](auto const& p, parameter const& param)
+         {
+            presets.set(current_preset, int(&param - params.begin()), p.second);
+         };
+
+      auto&& on_preset_name =
+         [&presets, &current_preset, &current_name](std::string_view name)
+         {
+            current_preset = presets.add(name);
+            current_name = name;
+         };
+
+      if (!read_presets(json, parameter_names{ params }, on_param, on_preset_name))
+      {
+         err << "Error: Invalid presets";
+         if (!current_name.empty())
+         {
+            err << ", or a parameter that the plugin does not have, in preset \""
+               << current_name << '"';
+         }
+         err << std::endl;
+         return false;
+      }
+
+      auto precision = out.precision(std::numeric_limits<double>::max_digits10);
+
+      out <<
+         "// Generated by the presets tool from the factory presets. Do not edit.\n"
+         "#include <qplug/factory_presets.hpp>\n"
+         "#include <limits>\n"
+         "\n"
+         "namespace cycfi::qplug\n"
+         "{\n"
+         "   namespace\n"
+         "   {\n"
+         ;
+
+      presets.for_each_preset(
+         [&](std::string_view name, int preset)
+         {
+            int n = 0;
+            presets.for_each(preset,
+               [&](int param, double value)
+               {
+                  if (n++ == 0)
+                  {
+                     out << "      constexpr factory_preset_value preset_" << preset << "[] =\n";
+                     out << "      {\n         { ";
+                  }
+                  else
+                  {
+                     out << "\n       , { ";
+                  }
+                  out << param << ", ";
+                  write_value(out, value);
+                  out << " }";
+               }
+            );
+            if (n)
+               out << "\n      };\n\n";
+         }
+      );
+
+      if (!presets.empty())
+      {
+         out << "      constexpr factory_preset presets[] =\n      {\n";
+         int i = 0;
+         presets.for_each_preset(
+            [&](std::string_view name, int preset)
+            {
+               std::size_t n = 0;
+               presets.for_each(preset, [&n](int, double) { ++n; });
+
+               out << ((i++ == 0)? "         { " : "       , { ");
+               write_string(out, name);
+               if (n)
+                  out << ", preset_" << preset << ", " << n << " }\n";
+               else
+                  out << ", nullptr, 0 }\n";
+            }
+         );
+         out << "      };\n\n";
+      }
+
+      out << "      constexpr factory_preset_table table =\n";
+      if (presets.empty())
+         out << "         { nullptr, 0, " << params.size() << " };\n";
+      else
+         out << "         { presets, " << presets.size() << ", " << params.size() << " };\n";
+
+      out <<
+         "\n"
+         "      [[maybe_unused]] bool const registered = register_factory_presets(table);\n"
+         "   }\n"
+         "}\n"
+         ;
+
+      out.precision(precision);
+      return bool(out);
+   }
+}
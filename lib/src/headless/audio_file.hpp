@@ -0,0 +1,275 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_HEADLESS_AUDIO_FILE_HPP_NOVEMBER_8_2019)
+#define QPLUG_HEADLESS_AUDIO_FILE_HPP_NOVEMBER_8_2019
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace cycfi::qplug::headless
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // Minimal streaming audio file I/O for offline rendering. WAV files (PCM
+   // 16, 24 and 32 bits and 32 bit float) and raw 32 bit float interleaved
+   // files are supported. A path of "-" means stdin or stdout (raw only).
+   // Frames are read and written interleaved.
+   ////////////////////////////////////////////////////////////////////////////
+   class audio_file_reader
+   {
+   public:
+                              audio_file_reader(
+                                 std::string const& path, bool raw
+                               , std::uint32_t sps, std::size_t channels);
+                              ~audio_file_reader();
+
+      std::size_t             read(float* frames, std::size_t count);
+      std::uint32_t           sps() const       { return _sps; }
+      std::size_t             channels() const  { return _channels; }
+
+   private:
+
+      void                    read_wav_header();
+
+      std::FILE*              _file;
+      std::uint32_t           _sps;
+      std::size_t             _channels;
+      std::uint16_t           _format = 3;      // IEEE float
+      std::uint16_t           _bits = 32;
+      std::size_t             _remaining = std::size_t(-1);
+      std::vector<char>       _buff;
+   };
+
+   class audio_file_writer
+   {
+   public:
+                              audio_file_writer(
+                                 std::string const& path, bool raw
+                               , std::uint32_t sps, std::size_t channels);
+                              ~audio_file_writer();
+
+      void                    write(float const* frames, std::size_t count);
+
+   private:
+
+      void                    write_wav_header();
+
+      std::FILE*              _file;
+      bool                    _raw;
+      std::uint32_t           _sps;
+      std::size_t             _channels;
+      std::size_t             _frames = 0;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inline implementation
+   ////////////////////////////////////////////////////////////////////////////
+   namespace detail
+   {
+      inline std::FILE* open_file(std::string const& path, bool write)
+      {
+         if (path == "-")
+            return write? stdout : stdin;
+         auto file = std::fopen(path.c_str(), write? "wb" : "rb");
+         if (!file)
+            throw std::runtime_error{ "Error: Cannot open \"" + path + "\"" };
+         return file;
+      }
+
+      template <typename T>
+      inline T read_le(std::FILE* file)
+      {
+         unsigned char b[sizeof(T)];
+         if (std::fread(b, 1, sizeof(T), file) != sizeof(T))
+            throw std::runtime_error{ "Error: Unexpected end of file" };
+         T val = 0;
+         for (std::size_t i = 0; i != sizeof(T); ++i)
+            val |= T(b[i]) << (i * 8);
+         return val;
+      }
+
+      template <typename T>
+      inline void write_le(std::FILE* file, T val)
+      {
+         unsigned char b[sizeof(T)];
+         for (std::size_t i = 0; i != sizeof(T); ++i)
+            b[i] = (val >> (i * 8)) & 0xff;
+         std::fwrite(b, 1, sizeof(T), file);
+      }
+   }
+
+   inline audio_file_reader::audio_file_reader(
+      std::string const& path, bool raw
+    , std::uint32_t sps, std::size_t channels)
+    : _file(detail::open_file(path, false))
+    , _sps(sps)
+    , _channels(channels)
+   {
+      if (!raw)
+         read_wav_header();
+   }
+
+   inline audio_file_reader::~audio_file_reader()
+   {
+      if (_file != stdin)
+         std::fclose(_file);
+   }
+
+   inline void audio_file_reader::read_wav_header()
+   {
+      char id[4];
+      auto read_id = [&]()
+      {
+         if (std::fread(id, 1, 4, _file) != 4)
+            throw std::runtime_error{ "Error: Unexpected end of file" };
+         return std::string{ id, 4 };
+      };
+
+      if (read_id() != "RIFF")
+         throw std::runtime_error{ "Error: Not a WAV file" };
+      detail::read_le<std::uint32_t>(_file);
+      if (read_id() != "WAVE")
+         throw std::runtime_error{ "Error: Not a WAV file" };
+
+      bool has_format = false;
+      while (true)
+      {
+         auto chunk = read_id();
+         auto size = detail::read_le<std::uint32_t>(_file);
+         if (chunk == "fmt ")
+         {
+            _format = detail::read_le<std::uint16_t>(_file);
+            _channels = detail::read_le<std::uint16_t>(_file);
+            _sps = detail::read_le<std::uint32_t>(_file);
+            detail::read_le<std::uint32_t>(_file);    // byte rate
+            detail::read_le<std::uint16_t>(_file);    // block align
+            _bits = detail::read_le<std::uint16_t>(_file);
+            if (_format == 0xfffe && size >= 40)      // WAVE_FORMAT_EXTENSIBLE
+            {
+               std::fseek(_file, 8, SEEK_CUR);
+               _format = detail::read_le<std::uint16_t>(_file);
+               std::fseek(_file, size - 26, SEEK_CUR);
+            }
+            else
+            {
+               std::fseek(_file, size - 16, SEEK_CUR);
+            }
+            has_format = true;
+         }
+         else if (chunk == "data")
+         {
+            if (!has_format)
+               throw std::runtime_error{ "Error: Missing WAV format chunk" };
+            _remaining = size / ((_bits / 8) * _channels);
+            break;
+         }
+         else
+         {
+            std::fseek(_file, size + (size & 1), SEEK_CUR);
+         }
+      }
+
+      bool supported =
+         (_format == 1 && (_bits == 16 || _bits == 24 || _bits == 32)) ||
+         (_format == 3 && _bits == 32)
+         ;
+      if (!supported)
+         throw std::runtime_error{ "Error: Unsupported WAV sample format" };
+   }
+
+   inline std::size_t audio_file_reader::read(float* frames, std::size_t count)
+   {
+      count = std::min(count, _remaining);
+      auto bytes = _bits / 8;
+      _buff.resize(count * _channels * bytes);
+      auto n = std::fread(_buff.data(), bytes * _channels, count, _file);
+      if (_remaining != std::size_t(-1))
+         _remaining -= n;
+
+      auto p = reinterpret_cast<unsigned char const*>(_buff.data());
+      auto samples = n * _channels;
+      for (std::size_t i = 0; i != samples; ++i, p += bytes)
+      {
+         if (_format == 3)
+         {
+            std::uint32_t bits = p[0] | (p[1] << 8) | (p[2] << 16) | (std::uint32_t(p[3]) << 24);
+            std::memcpy(&frames[i], &bits, 4);
+         }
+         else if (_bits == 16)
+         {
+            frames[i] = std::int16_t(p[0] | (p[1] << 8)) / 32768.0f;
+         }
+         else if (_bits == 24)
+         {
+            std::int32_t s = (p[0] << 8) | (p[1] << 16) | (std::uint32_t(p[2]) << 24);
+            frames[i] = (s >> 8) / 8388608.0f;
+         }
+         else
+         {
+            std::int32_t s = p[0] | (p[1] << 8) | (p[2] << 16) | (std::uint32_t(p[3]) << 24);
+            frames[i] = s / 2147483648.0f;
+         }
+      }
+      return n;
+   }
+
+   inline audio_file_writer::audio_file_writer(
+      std::string const& path, bool raw
+    , std::uint32_t sps, std::size_t channels)
+    : _file(detail::open_file(path, true))
+    , _raw(raw)
+    , _sps(sps)
+    , _channels(channels)
+   {
+      if (!_raw)
+         write_wav_header();
+   }
+
+   inline audio_file_writer::~audio_file_writer()
+   {
+      if (!_raw)
+      {
+         // Patch the sizes, now that we know them
+         std::fseek(_file, 0, SEEK_SET);
+         write_wav_header();
+      }
+      if (_file != stdout)
+         std::fclose(_file);
+      else
+         std::fflush(_file);
+   }
+
+   inline void audio_file_writer::write_wav_header()
+   {
+      std::uint32_t data_size = _frames * _channels * 4;
+      std::fwrite("RIFF", 1, 4, _file);
+      detail::write_le<std::uint32_t>(_file, 36 + data_size);
+      std::fwrite("WAVEfmt ", 1, 8, _file);
+      detail::write_le<std::uint32_t>(_file, 16);
+      detail::write_le<std::uint16_t>(_file, 3);   // IEEE float
+      detail::write_le<std::uint16_t>(_file, _channels);
+      detail::write_le<std::uint32_t>(_file, _sps);
+      detail::write_le<std::uint32_t>(_file, _sps * _channels * 4);
+      detail::write_le<std::uint16_t>(_file, _channels * 4);
+      detail::write_le<std::uint16_t>(_file, 32);
+      std::fwrite("data", 1, 4, _file);
+      detail::write_le<std::uint32_t>(_file, data_size);
+   }
+
+   inline void audio_file_writer::write(float const* frames, std::size_t count)
+   {
+      // Samples are written in native byte order. All our supported
+      // platforms are little endian, as required by WAV.
+      std::fwrite(frames, sizeof(float) * _channels, count, _file);
+      _frames += count;
+   }
+}
+
+#endif
@@ -0,0 +1,102 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include "headless_plugin.hpp"
+#include <qplug/preset_bank.hpp>
+#include <qplug/factory_presets.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+// Preset converter: converts a JSON presets file (e.g. factory_presets.json
+// or <PLUG_NAME>_presets.json) to a binary preset bank (.qpb), or factory
+// presets to a C++ table to compile into the plugin, using the plugin's
+// parameters.
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   char const* usage =
+      "Usage: presets input.json output.qpb\n"
+      "       presets input.json output.cpp\n"
+      "\n"
+      "Converts JSON presets to a preset bank. Install the bank next to (or\n"
+      "instead of) the JSON file: factory_presets.qpb is used in place of\n"
+      "factory_presets.json, and <name>_presets.qpb in place of\n"
+      "<name>_presets.json, unless the JSON file is newer.\n"
+      "\n"
+      "With a .cpp output, converts factory presets to a table to compile\n"
+      "into the plugin (see PLUG_FACTORY_PRESETS), which is then used in\n"
+      "place of factory_presets.qpb and factory_presets.json.\n"
+      ;
+}
+
+int main(int argc, char const* argv[])
+{
+   if (argc != 3)
+   {
+      std::cerr << usage;
+      return 1;
+   }
+
+   headless_plugin plugin;
+   auto params = plugin.controller().parameters();
+
+   std::string src;
+   {
+      std::ifstream file(argv[1]);
+      if (!file)
+      {
+         std::cerr << "Error: Cannot open \"" << argv[1] << '"' << std::endl;
+         return 1;
+      }
+      src.assign(
+         (std::istreambuf_iterator<char>(file))
+       , std::istreambuf_iterator<char>());
+   }
+
+   if (cycfi::fs::path{ argv[2] }.extension() == ".cpp")
+   {
+      // Invalid presets fail the build: remove the table, so that the
+      // next build does not go on with a stale one
+      std::ostringstream table;
+      if (!cycfi::qplug::write_factory_presets(src, params, table, std::cerr))
+      {
+         std::error_code ec;
+         cycfi::fs::remove(argv[2], ec);
+         std::cerr << "Error: Invalid presets in \"" << argv[1] << '"' << std::endl;
+         return 1;
+      }
+
+      std::ofstream file(argv[2]);
+      if (!(file << table.str()))
+      {
+         std::cerr << "Error: Cannot write \"" << argv[2] << '"' << std::endl;
+         return 1;
+      }
+
+      std::cerr << "Factory presets written to " << argv[2] << std::endl;
+      return 0;
+   }
+
+   cycfi::qplug::preset_bank_writer bank{ params };
+   if (!cycfi::qplug::convert_presets(src, params, bank))
+   {
+      std::cerr << "Error: Invalid presets in \"" << argv[1] << '"' << std::endl;
+      return 1;
+   }
+
+   if (!bank.write(argv[2]))
+   {
+      std::cerr << "Error: Cannot write \"" << argv[2] << '"' << std::endl;
+      return 1;
+   }
+
+   std::cerr << bank.size() << " presets written to " << argv[2] << std::endl;
+   return 0;
+}
@@ -0,0 +1,256 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include "headless_plugin.hpp"
+#include <qplug/data_stream.hpp>
+#include <qplug/rt_check.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace
+{
+   using parameter = qplug::parameter;
+
+   // We follow the iPlug2 conventions for the plain values and their
+   // normalization, so processors see the same values in both backends.
+   // Notes are enumerations starting at 0 (the parameter's _min note).
+
+   double min_value(parameter const& param)
+   {
+      return (param._type == parameter::note)? 0.0 : param._min;
+   }
+
+   double max_value(parameter const& param)
+   {
+      return (param._type == parameter::note)?
+         param._max - param._min : param._max;
+   }
+
+   double to_normalized(parameter const& param, double val)
+   {
+      auto min = min_value(param);
+      auto max = max_value(param);
+      val = std::clamp(val, min, max);
+
+      switch (param._type)
+      {
+         case parameter::double_:
+            return std::pow((val - min) / (max - min), 1.0 / param._curve);
+
+         case parameter::frequency:
+            return std::log(val / min) / std::log(max / min);
+
+         default:
+            return (val - min) / (max - min);
+      }
+   }
+
+   double from_normalized(parameter const& param, double val)
+   {
+      auto min = min_value(param);
+      auto max = max_value(param);
+      val = std::clamp(val, 0.0, 1.0);
+
+      switch (param._type)
+      {
+         case parameter::double_:
+            return min + std::pow(val, param._curve) * (max - min);
+
+         case parameter::frequency:
+            return min * std::exp(val * std::log(max / min));
+
+         default:
+            return min + std::round(val * (max - min));
+      }
+   }
+}
+
+headless_plugin::headless_plugin(
+   controller_factory make_controller
+ , processor_factory make_processor
+ , std::uint32_t sps
+ , std::size_t max_frames
+)
+ : _controller(make_controller(*this))
+ , _sps(sps)
+ , _max_frames(max_frames)
+{
+   _params = _controller->parameters();
+   _index = qplug::parameter_index{ _params };
+   _values.resize(_params.size());
+   for (std::size_t i = 0; i != _params.size(); ++i)
+      _values[i] = _params[i].init_value();
+
+   _processor = make_processor(*this);
+   _processor->init_parameters(_params);
+   reset(sps, max_frames);
+}
+
+void headless_plugin::reset(std::uint32_t sps, std::size_t max_frames)
+{
+   _sps = sps;
+   _max_frames = max_frames;
+   _processor->prepare(_max_frames);
+   _processor->reset();
+}
+
+void headless_plugin::activate(bool active)
+{
+   if (active)
+      _processor->activate();
+   else
+      _processor->deactivate();
+}
+
+void headless_plugin::process(
+   float const** in, std::size_t in_channels
+ , float** out, std::size_t out_channels
+ , std::size_t frames
+)
+{
+   qplug::rt_check::scope rt{ "process" };
+   _processor->begin_block(frames);
+   _processor->process_block(in, in_channels, out, out_channels, frames);
+   _processor->end_block();
+}
+
+void headless_plugin::automate(int id, double value, int frame)
+{
+   qplug::rt_check::scope rt{ "automate" };
+   if (std::size_t(id) >= _values.size())
+      return;
+   set_value(id, value);
+   _controller->on_parameter_change(id, get_parameter_normalized(id));
+   _processor->parameter_change(id, _values[id], frame);
+}
+
+void headless_plugin::midi(q::midi::raw_message msg, std::size_t frame)
+{
+   qplug::rt_check::scope rt{ "midi" };
+   _processor->midi_message(msg, frame);
+   _controller->process_midi(msg, frame);
+}
+
+void headless_plugin::idle()
+{
+   _controller->poll_presets();
+}
+
+int headless_plugin::find_parameter(std::string_view name) const
+{
+   return _index.find(name);
+}
+
+headless_plugin::state_buffer headless_plugin::save_state() const
+{
+   state_buffer buff;
+   qplug::vector_ostream str{ buff };
+   _controller->on_save_begin();
+
+   qplug::save_parameters(str, _index, [this](int id) { return _values[id]; });
+
+   _controller->save_state(str);
+   _controller->on_save_end();
+   return buff;
+}
+
+bool headless_plugin::load_state(char const* data, std::size_t size)
+{
+   _controller->on_load_begin(qplug::version());
+
+   qplug::memory_istream str{ data, size };
+   bool ok = qplug::load_parameters(str, _index,
+      [this](int id, double value)
+      {
+         set_value(id, value);
+         _processor->publish_parameter(id, _values[id]);
+      }
+   );
+
+   if (!ok)
+      return false;
+
+   try
+   {
+      _controller->load_state(str);
+   }
+   catch (...)
+   {
+      return false;
+   }
+   _controller->on_load_end();
+   return true;
+}
+
+void headless_plugin::set_parameter(int id, double value)
+{
+   if (std::size_t(id) < _values.size())
+   {
+      _values[id] = from_normalized(id, value);
+      _processor->publish_parameter(id, _values[id]);
+   }
+}
+
+void headless_plugin::recall_parameters(qplug::parameter_value_list const& values)
+{
+   qplug::parameter_value_list plain;
+   plain.reserve(values.size());
+   for (auto const& v : values)
+   {
+      if (std::size_t(v.id) < _values.size())
+      {
+         _values[v.id] = from_normalized(v.id, v.value);
+         plain.push_back({ v.id, _values[v.id] });
+      }
+   }
+   _processor->publish_parameters(plain);
+}
+
+std::uint32_t headless_plugin::morph_parameters(
+   std::vector<double> const& from
+ , std::vector<double> const& to
+ , double ms
+ , double switch_point
+)
+{
+   return _processor->morph(from, to, ms, switch_point);
+}
+
+void headless_plugin::stop_morph()
+{
+   _processor->stop_morph();
+}
+
+void headless_plugin::edit_parameter(int id, double value)
+{
+   set_parameter(id, value);
+}
+
+double headless_plugin::normalize_parameter(int id, double val) const
+{
+   return to_normalized(_params[id], val);
+}
+
+double headless_plugin::get_parameter(int id) const
+{
+   return _values[id];
+}
+
+double headless_plugin::get_parameter_normalized(int id) const
+{
+   return to_normalized(_params[id], _values[id]);
+}
+
+double headless_plugin::from_normalized(int id, double val) const
+{
+   return ::from_normalized(_params[id], val);
+}
+
+void headless_plugin::set_value(int id, double value)
+{
+   auto const& param = _params[id];
+   _values[id] = std::clamp(value, min_value(param), max_value(param));
+}
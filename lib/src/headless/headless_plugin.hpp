@@ -0,0 +1,128 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_HEADLESS_PLUGIN_HPP_NOVEMBER_8_2019)
+#define QPLUG_HEADLESS_PLUGIN_HPP_NOVEMBER_8_2019
+
+#include <elements/view.hpp>
+#include <qplug/controller.hpp>
+#include <qplug/processor.hpp>
+#include <qplug/parameter.hpp>
+#include <qplug/plugin_state.hpp>
+#include <memory>
+#include <vector>
+#include <string_view>
+
+namespace elements = cycfi::elements;
+namespace qplug = cycfi::qplug;
+namespace q = cycfi::q;
+
+///////////////////////////////////////////////////////////////////////////////
+// headless_plugin: A pure C++ backend with no host, no UI and no plugin SDK.
+// It implements the same surface as iplug2_plugin, so any plugin can be
+// driven directly (e.g. offline rendering, benchmarks and tests).
+///////////////////////////////////////////////////////////////////////////////
+class headless_plugin
+{
+public:
+
+   using controller_ptr = std::unique_ptr<qplug::controller>;
+   using processor_ptr = std::unique_ptr<qplug::processor>;
+   using controller_factory = controller_ptr(*)(headless_plugin& base);
+   using processor_factory = processor_ptr(*)(headless_plugin& base);
+   using state_buffer = std::vector<char>;
+
+                           headless_plugin(std::uint32_t sps = 44100, std::size_t max_frames = 512)
+                            : headless_plugin(
+                                 qplug::make_controller, qplug::make_processor
+                               , sps, max_frames)
+                           {}
+
+                           headless_plugin(
+                              controller_factory make_controller
+                            , processor_factory make_processor
+                            , std::uint32_t sps = 44100
+                            , std::size_t max_frames = 512
+                           );
+
+                           headless_plugin(headless_plugin const&) = delete;
+
+   // Host side
+   void                    reset(std::uint32_t sps, std::size_t max_frames);
+   void                    activate(bool active);
+   void                    bypass(bool bypassed_) { _bypassed = bypassed_; }
+   void                    process(
+                              float const** in, std::size_t in_channels
+                            , float** out, std::size_t out_channels
+                            , std::size_t frames
+                           );
+
+   // Host parameter change (e.g. automation). value is a plain value.
+   // frame is the offset into the next block, or -1 if not sample accurate.
+   void                    automate(int id, double value, int frame = -1);
+
+   // Host MIDI input. frame is the offset into the next block.
+   void                    midi(q::midi::raw_message msg, std::size_t frame = 0);
+
+   // Host idle, on the UI thread. Delivers presets loaded in the
+   // background (see controller::load_all_presets_async).
+   void                    idle();
+
+   int                     find_parameter(std::string_view name) const;
+   std::size_t             num_parameters() const { return _values.size(); }
+
+   state_buffer            save_state() const;
+   bool                    load_state(char const* data, std::size_t size);
+
+   qplug::controller&      controller() const { return *_controller; }
+   qplug::processor&       processor() const { return *_processor; }
+   std::size_t             max_frames() const { return _max_frames; }
+
+   // Controller and processor side
+   elements::view*         view() const { return nullptr; }
+   void                    resize_view(elements::extent size) {}
+
+   void                    set_parameter(int id, double value);
+   void                    recall_parameters(qplug::parameter_value_list const& values);
+   std::uint32_t           morph_parameters(
+                              std::vector<double> const& from
+                            , std::vector<double> const& to
+                            , double ms
+                            , double switch_point
+                           );
+   void                    stop_morph();
+   std::uint32_t           morph_done() const { return _processor->morph_done(); }
+   void                    begin_edit(int id) {}
+   void                    edit_parameter(int id, double value);
+   void                    end_edit(int id) {}
+   double                  normalize_parameter(int id, double val) const;
+   double                  get_parameter(int id) const;
+   double                  get_parameter_normalized(int id) const;
+   double                  from_normalized(int id, double val) const;
+
+   std::uint32_t           sps() const { return _sps; }
+   bool                    bypassed() const { return _bypassed; }
+
+   std::string_view        host_name() const { return "Headless"; }
+   void                    invalidate_state() {}
+   qplug::load_meter const& dsp_load() const { return _processor->dsp_load(); }
+
+private:
+
+   using parameter_list = qplug::controller::parameter_list;
+
+   void                    set_value(int id, double value);
+
+   controller_ptr          _controller;
+   processor_ptr           _processor;
+   parameter_list          _params;
+   qplug::parameter_index  _index;
+   std::vector<double>     _values;
+   std::uint32_t           _sps;
+   std::size_t             _max_frames;
+   bool                    _bypassed = false;
+};
+
+#endif
@@ -0,0 +1,257 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include "headless_plugin.hpp"
+#include "audio_file.hpp"
+#include <qplug/rt_check.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// Offline renderer: streams audio from a file (or stdin) through the
+// plugin's processor and writes the result to a file (or stdout), as fast
+// as possible.
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   using namespace cycfi::qplug::headless;
+
+   char const* usage =
+      "Usage: render [options] input output\n"
+      "\n"
+      "  input, output          WAV files, or raw 32 bit float interleaved files\n"
+      "                         (\"-\" for stdin/stdout)\n"
+      "\n"
+      "Options:\n"
+      "  -b, --block N          block size in frames (default: 512)\n"
+      "  -a, --automation FILE  parameter automation script\n"
+      "  -r, --raw              input and output are raw\n"
+      "  -s, --sps N            sample rate of raw input (default: 44100)\n"
+      "  -c, --channels N       channels of raw input (default: 2)\n"
+      "  -o, --out-channels N   output channels (default: input channels)\n"
+      "\n"
+      "Automation scripts have one parameter change per line:\n"
+      "\n"
+      "  <time in seconds> <parameter id or name> <plain value>\n"
+      "\n"
+      "Names with spaces are double quoted. Lines starting with # are ignored.\n"
+      ;
+
+   struct options
+   {
+      std::string    input;
+      std::string    output;
+      std::string    automation;
+      std::size_t    block = 512;
+      bool           raw = false;
+      std::uint32_t  sps = 44100;
+      std::size_t    channels = 2;
+      std::size_t    out_channels = 0;
+   };
+
+   options parse_options(int argc, char const* argv[])
+   {
+      options opts;
+      std::vector<std::string> files;
+
+      for (int i = 1; i < argc; ++i)
+      {
+         std::string arg = argv[i];
+         auto value = [&]() -> std::string
+         {
+            if (++i == argc)
+               throw std::runtime_error{ "Error: Missing value for " + arg };
+            return argv[i];
+         };
+
+         if (arg == "-b" || arg == "--block")
+            opts.block = std::stoul(value());
+         else if (arg == "-a" || arg == "--automation")
+            opts.automation = value();
+         else if (arg == "-r" || arg == "--raw")
+            opts.raw = true;
+         else if (arg == "-s" || arg == "--sps")
+            opts.sps = std::stoul(value());
+         else if (arg == "-c" || arg == "--channels")
+            opts.channels = std::stoul(value());
+         else if (arg == "-o" || arg == "--out-channels")
+            opts.out_channels = std::stoul(value());
+         else if (arg.size() > 1 && arg[0] == '-')
+            throw std::runtime_error{ "Error: Unknown option " + arg };
+         else
+            files.push_back(arg);
+      }
+
+      if (files.size() != 2 || opts.block == 0)
+         throw std::runtime_error{ usage };
+      opts.input = files[0];
+      opts.output = files[1];
+      return opts;
+   }
+
+   struct automation_event
+   {
+      std::size_t    frame;
+      int            id;
+      double         value;
+   };
+
+   std::vector<automation_event>
+   load_automation(std::string const& path, headless_plugin const& plugin, std::uint32_t sps)
+   {
+      std::vector<automation_event> events;
+      if (path.empty())
+         return events;
+
+      std::ifstream file(path);
+      if (!file)
+         throw std::runtime_error{ "Error: Cannot open \"" + path + "\"" };
+
+      std::string line;
+      for (int line_no = 1; std::getline(file, line); ++line_no)
+      {
+         std::istringstream str(line);
+         double time;
+         if (!(str >> time))
+         {
+            // Skip blank lines and comments
+            if (line.find_first_not_of(" \t\r") == std::string::npos
+               || line[line.find_first_not_of(" \t")] == '#')
+               continue;
+            throw std::runtime_error{
+               "Error: Bad automation at line " + std::to_string(line_no) };
+         }
+
+         std::string name;
+         str >> std::ws;
+         if (str.peek() == '"')
+            str >> std::quoted(name);
+         else
+            str >> name;
+
+         double value;
+         if (!(str >> value))
+            throw std::runtime_error{
+               "Error: Bad automation at line " + std::to_string(line_no) };
+
+         int id = -1;
+         auto is_digit = [](unsigned char c) { return std::isdigit(c); };
+         if (!name.empty() && std::all_of(name.begin(), name.end(), is_digit))
+            id = std::stoi(name);
+         else
+            id = plugin.find_parameter(name);
+
+         if (id < 0 || std::size_t(id) >= plugin.num_parameters())
+            throw std::runtime_error{ "Error: Unknown parameter " + name };
+
+         events.push_back({ std::size_t(std::lround(time * sps)), id, value });
+      }
+
+      std::stable_sort(events.begin(), events.end(),
+         [](auto const& a, auto const& b) { return a.frame < b.frame; });
+      return events;
+   }
+
+   void render(options const& opts)
+   {
+      audio_file_reader reader{ opts.input, opts.raw, opts.sps, opts.channels };
+      auto sps = reader.sps();
+      auto in_channels = reader.channels();
+      auto out_channels = opts.out_channels? opts.out_channels : in_channels;
+      auto block = opts.block;
+
+      headless_plugin plugin{ sps, block };
+      auto events = load_automation(opts.automation, plugin, sps);
+      audio_file_writer writer{ opts.output, opts.raw, sps, out_channels };
+
+      std::vector<float> in_frames(block * in_channels);
+      std::vector<float> out_frames(block * out_channels);
+      std::vector<std::vector<float>> in_buffs(in_channels, std::vector<float>(block));
+      std::vector<std::vector<float>> out_buffs(out_channels, std::vector<float>(block));
+      std::vector<float const*> in_ptrs;
+      std::vector<float*> out_ptrs;
+      for (auto& buff : in_buffs)
+         in_ptrs.push_back(buff.data());
+      for (auto& buff : out_buffs)
+         out_ptrs.push_back(buff.data());
+
+      auto start = std::chrono::steady_clock::now();
+      std::chrono::duration<double> process_time{ 0 };
+
+      plugin.activate(true);
+      std::size_t pos = 0;
+      auto event = events.begin();
+      while (auto n = reader.read(in_frames.data(), block))
+      {
+         for (std::size_t ch = 0; ch != in_channels; ++ch)
+            for (std::size_t i = 0; i != n; ++i)
+               in_buffs[ch][i] = in_frames[i * in_channels + ch];
+
+         for (; event != events.end() && event->frame < pos + n; ++event)
+         {
+            auto offset = (event->frame > pos)? event->frame - pos : 0;
+            plugin.automate(event->id, event->value, offset);
+         }
+
+         auto t = std::chrono::steady_clock::now();
+         plugin.process(in_ptrs.data(), in_channels, out_ptrs.data(), out_channels, n);
+         process_time += std::chrono::steady_clock::now() - t;
+
+         for (std::size_t ch = 0; ch != out_channels; ++ch)
+            for (std::size_t i = 0; i != n; ++i)
+               out_frames[i * out_channels + ch] = out_buffs[ch][i];
+
+         writer.write(out_frames.data(), n);
+         pos += n;
+      }
+      plugin.activate(false);
+
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      double audio_time = double(pos) / sps;
+      std::cerr
+         << "Rendered " << pos << " frames (" << audio_time << " s) in "
+         << elapsed.count() << " s, process: " << process_time.count() << " s, "
+         << "realtime factor: " << (audio_time / elapsed.count()) << 'x'
+         << std::endl;
+
+      auto load = plugin.dsp_load().stats();
+      std::cerr
+         << "DSP load per block: avg " << load.avg << "%, p99 " << load.p99
+         << "%, max " << load.max << "%, overruns: " << load.overruns
+         << std::endl;
+   }
+}
+
+int main(int argc, char const* argv[])
+{
+   try
+   {
+      render(parse_options(argc, argv));
+   }
+   catch (std::exception const& e)
+   {
+      std::cerr << e.what() << std::endl;
+      return 1;
+   }
+
+   // In realtime safety checking builds, fail if the processor allocated,
+   // locked or did file I/O
+   if (cycfi::qplug::rt_check::violations())
+   {
+      cycfi::qplug::rt_check::print_report(stderr);
+      return 2;
+   }
+   return 0;
+}
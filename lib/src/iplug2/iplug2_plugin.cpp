@@ -5,6 +5,7 @@
 =============================================================================*/
 #include "iplug2_plugin.hpp"
 #include <qplug/data_stream.hpp>
+#include <qplug/rt_check.hpp>
 #include <infra/filesystem.hpp>
 #include "IPlug_include_in_plug_src.h"
 #include <sstream>
@@ -77,32 +78,36 @@ iplug2_plugin::iplug2_plugin(InstanceInfo const& info, controller_ptr&& cptr)
   : Plugin(info, MakeConfig(cptr->parameters().size(), 1))
   , _controller(std::forward<controller_ptr>(cptr))
   , _processor(qplug::make_processor(*this))
+  , _index(_controller->parameters())
 {
    auto params = _controller->parameters();
    for (std::size_t i = 0; i != params.size(); ++i)
       register_parameter(i, params[i]);
+   _processor->init_parameters(params);
+
+   // Don't keep OpenWindow waiting on the disk. The preset menu fills in
+   // when the presets are ready (see OnIdle).
+   _controller->load_all_presets_async();
 }
 
 void iplug2_plugin::ProcessBlock(sample** inputs, sample** outputs, int frames)
 {
-   _processor->process(
-      q::audio_channels<float const>{
-         const_cast<float const**>(inputs)
-       , std::size_t(NInChansConnected())
-       , std::size_t(frames)
-      }
-      , q::audio_channels<float>{
-         outputs
-       , std::size_t(NOutChansConnected())
-       , std::size_t(frames)
-      }
+   qplug::rt_check::scope rt{ "ProcessBlock" };
+   _processor->begin_block(frames);
+   _processor->process_block(
+      const_cast<float const**>(inputs), std::size_t(NInChansConnected())
+    , outputs, std::size_t(NOutChansConnected())
+    , std::size_t(frames)
    );
+   _processor->end_block();
 }
 
 void iplug2_plugin::ProcessMidiMsg(const IMidiMsg& msg)
 {
+   qplug::rt_check::scope rt{ "ProcessMidiMsg" };
    q::midi::raw_message raw_midi = { 0 };
    raw_midi.data = msg.mStatus | (msg.mData1 << 8) | (msg.mData2 << 16);
+   _processor->midi_message(raw_midi, msg.mOffset);
    _controller->process_midi(raw_midi, msg.mOffset);
 }
 
@@ -114,7 +119,7 @@ void* iplug2_plugin::OpenWindow(void* parent)
       _view = std::make_unique<elements::view>(elements::extent{ PLUG_WIDTH, PLUG_HEIGHT });
 
    _controller->on_attach_view();
-   _controller->load_all_presets();
+   _controller->poll_presets();
 
    for (int id = 0; id != NParams(); ++id)
       _controller->update_ui_parameter(id, GetParam(id)->GetNormalized());
@@ -129,8 +134,14 @@ void iplug2_plugin::CloseWindow()
    _view.reset();
 }
 
+void iplug2_plugin::OnIdle()
+{
+   _controller->poll_presets();
+}
+
 void iplug2_plugin::OnReset()
 {
+   _processor->prepare(GetBlockSize());
    _processor->reset();
 }
 
@@ -241,19 +252,48 @@ void iplug2_plugin::set_parameter(int id, double value)
    if (param)
    {
       param->SetNormalized(value);
-      _processor->parameter_change(id, GetParam(id)->Value());
+      invalidate_state();
+      _processor->publish_parameter(id, GetParam(id)->Value());
    }
 }
 
-void iplug2_plugin::recall_parameter(int id, double value)
+void iplug2_plugin::recall_parameters(qplug::parameter_value_list const& values)
 {
-   IParam* param = mParams.Get(id);
-   if (param)
+   // values are normalized. The processor gets them all at once, in the
+   // same block, and the controller updates the view.
+   qplug::parameter_value_list plain;
+   plain.reserve(values.size());
+
+   ENTER_PARAMS_MUTEX
+   for (auto const& v : values)
    {
-      param->SetNormalized(value);
-      OnParamChange(id, kPresetRecall);
-      OnParamChangeUI(id, kPresetRecall);
+      if (IParam* param = mParams.Get(v.id))
+      {
+         param->SetNormalized(v.value);
+         plain.push_back({ v.id, param->Value() });
+      }
    }
+   LEAVE_PARAMS_MUTEX
+
+   invalidate_state();
+   _processor->publish_parameters(plain);
+   for (auto const& v : plain)
+      OnParamChangeUI(v.id, kPresetRecall);
+}
+
+std::uint32_t iplug2_plugin::morph_parameters(
+   std::vector<double> const& from
+ , std::vector<double> const& to
+ , double ms
+ , double switch_point
+)
+{
+   return _processor->morph(from, to, ms, switch_point);
+}
+
+void iplug2_plugin::stop_morph()
+{
+   _processor->stop_morph();
 }
 
 void iplug2_plugin::begin_edit(int id)
@@ -271,13 +311,16 @@ void iplug2_plugin::end_edit(int id)
    EndInformHostOfParamChangeFromUI(id);
 }
 
-void iplug2_plugin::OnParamChange(int id, EParamSource source, int /*sampleOffset*/)
+void iplug2_plugin::OnParamChange(int id, EParamSource source, int sampleOffset)
 {
+   // Only host changes arrive on the audio thread
+   qplug::rt_check::scope rt{ source == kHost? "OnParamChange" : nullptr };
+   invalidate_state();
    if (source != kUI && _view)
       _controller->update_ui_parameter(id, GetParam(id)->GetNormalized());
    if (source == kHost)
       _controller->on_parameter_change(id, GetParam(id)->GetNormalized());
-   _processor->parameter_change(id, GetParam(id)->Value());
+   _processor->parameter_change(id, GetParam(id)->Value(), sampleOffset);
 }
 
 #if defined(VST3_API)
@@ -563,23 +606,6 @@ bool iplug2_plugin::OnKeyUp(const IKeyPress& key)
 
 namespace
 {
-   struct iplug2_ostream : qplug::ostream
-   {
-      iplug2_ostream(IByteChunk& chunk)
-       : _chunk(chunk)
-      {}
-
-      ostream& write(const char* s, std::size_t size) override
-      {
-         if (_ok)
-            _ok &= _chunk.PutBytes(s, size) > 0;
-         return *this;
-      }
-
-      IByteChunk& _chunk;
-      bool        _ok = true;
-   };
-
    struct iplug2_istream : qplug::istream
    {
       iplug2_istream(IByteChunk const& chunk, int start_pos)
@@ -605,43 +631,48 @@ namespace
 bool iplug2_plugin::SerializeState(IByteChunk& chunk) const
 {
    IByteChunk::InitChunkWithIPlugVer(chunk);
-   iplug2_ostream str{ chunk };
-   _controller->on_save_begin();
+   std::lock_guard<std::mutex> lock(_state_mutex);
 
-   int num_params = mParams.GetSize();
-   str << num_params;
-   for (int i = 0; i < num_params; ++i)
-   {
-      IParam* param = mParams.Get(i);
-      str << param->GetName() << param->Value();
-   }
+   // on_save_begin and on_save_end bracket every save, cached or not.
+   // on_save_begin may still change the state (see state_changed).
+   _controller->on_save_begin();
 
-   try
+   // Hosts ask for the state often (autosave, undo points). Serialize the
+   // parameters and the controller's state only if they changed since the
+   // last time. A change made while we are building bumps the generation
+   // again, so it is picked up next time.
+   auto generation = _state_generation.load(std::memory_order_acquire);
+   if (generation != _cached_generation)
    {
-      _controller->save_state(str);
+      _state_cache_misses.fetch_add(1, std::memory_order_relaxed);
+      _state_cache.clear();
+      _cached_generation = 0;
+      qplug::vector_ostream str{ _state_cache };
+      qplug::save_parameters(str, _index,
+         [this](int id) { return GetParam(id)->Value(); });
+      try
+      {
+         _controller->save_state(str);
+      }
+      catch (...)
+      {
+         return false;
+      }
+      _cached_generation = generation;
    }
-   catch (...)
+   else
    {
-      return false;
+      _state_cache_hits.fetch_add(1, std::memory_order_relaxed);
    }
-
    _controller->on_save_end();
-   return str._ok;
+
+   return _state_cache.empty()
+      || chunk.PutBytes(_state_cache.data(), int(_state_cache.size())) > 0;
 }
 
-namespace
+void iplug2_plugin::invalidate_state()
 {
-   IParam* get_param(std::string_view name, WDL_PtrList<IParam> const& params)
-   {
-      int n = params.GetSize();
-      for (int i = 0; i < n; ++i)
-      {
-         IParam* param = params.Get(i);
-         if (param && param->GetName() == name)
-            return param;
-      }
-      return nullptr;
-   }
+   _state_generation.fetch_add(1, std::memory_order_release);
 }
 
 int iplug2_plugin::UnserializeState(IByteChunk const& chunk, int start_pos)
@@ -651,23 +682,19 @@ int iplug2_plugin::UnserializeState(IByteChunk const& chunk, int start_pos)
    _controller->on_load_begin(version);
 
    iplug2_istream str{ chunk, start_pos };
-   int num_params;
-   str >> num_params;
 
    ENTER_PARAMS_MUTEX
-   for (int i = 0; i < num_params; ++i)
-   {
-      std::string name;
-      double value;
-      str >> name >> value;
-
-      auto param = get_param(name, mParams);
-      if (param)
-         param->Set(value);
-   }
+   bool ok = qplug::load_parameters(str, _index,
+      [this](int id, double value) { GetParam(id)->Set(value); });
    OnParamReset(kPresetRecall);
    LEAVE_PARAMS_MUTEX
 
+   if (!ok)
+      return false;
+
+   // The parameters were replaced
+   invalidate_state();
+
    try
    {
       _controller->load_state(str);
@@ -677,7 +704,7 @@ int iplug2_plugin::UnserializeState(IByteChunk const& chunk, int start_pos)
       return false;
    }
    _controller->on_load_end();
-   return start_pos;
+   return start_pos + int(str.pos());
 }
 
 double iplug2_plugin::get_parameter(int id) const
@@ -11,8 +11,12 @@
 #include <qplug/controller.hpp>
 #include <qplug/processor.hpp>
 #include <qplug/parameter.hpp>
+#include <qplug/plugin_state.hpp>
+#include <atomic>
 #include <memory>
 #include <map>
+#include <mutex>
+#include <vector>
 
 using namespace iplug;
 namespace elements = cycfi::elements;
@@ -36,6 +40,7 @@ public:
    void                    ProcessBlock(sample** in, sample** out, int frames) override;
    void                    ProcessMidiMsg(const IMidiMsg& msg) override;
    void                    OnParamChange(int id, EParamSource source, int sampleOffset = -1) override;
+   void                    OnIdle() override;
 
 #if defined(VST3_API)
    bool                    OnKeyDown(IKeyPress const& key) override;
@@ -49,7 +54,15 @@ public:
    void                    resize_view(elements::extent size);
 
    void                    set_parameter(int id, double value);
-   void                    recall_parameter(int id, double value);
+   void                    recall_parameters(qplug::parameter_value_list const& values);
+   std::uint32_t           morph_parameters(
+                              std::vector<double> const& from
+                            , std::vector<double> const& to
+                            , double ms
+                            , double switch_point
+                           );
+   void                    stop_morph();
+   std::uint32_t           morph_done() const { return _processor->morph_done(); }
    void                    begin_edit(int id);
    void                    edit_parameter(int id, double value);
    void                    end_edit(int id);
@@ -62,6 +75,14 @@ public:
 
    std::string_view        host_name() const;
 
+   // SerializeState caches the serialized state until a parameter changes,
+   // or the controller calls state_changed. Hosts may ask for the state
+   // from any thread; the counts are safe to read from any thread too.
+   void                    invalidate_state();
+   std::size_t             state_cache_hits() const { return _state_cache_hits.load(std::memory_order_relaxed); }
+   std::size_t             state_cache_misses() const { return _state_cache_misses.load(std::memory_order_relaxed); }
+   qplug::load_meter const& dsp_load() const { return _processor->dsp_load(); }
+
 private:
 
    using key_code = elements::key_code;
@@ -73,7 +94,17 @@ private:
    view_ptr                _view;
    controller_ptr          _controller;
    processor_ptr           _processor;
+   qplug::parameter_index  _index;
    key_map                 _keys = {};
+
+   using state_buffer = std::vector<char>;
+
+   std::atomic<std::uint64_t> _state_generation{ 1 };
+   mutable std::mutex      _state_mutex;        // For the cache
+   mutable std::uint64_t   _cached_generation = 0;
+   mutable state_buffer    _state_cache;
+   mutable std::atomic<std::size_t> _state_cache_hits{ 0 };
+   mutable std::atomic<std::size_t> _state_cache_misses{ 0 };
 };
 
 #endif
\ No newline at end of file
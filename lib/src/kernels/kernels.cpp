@@ -0,0 +1,194 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include "kernels_impl.hpp"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+# include <intrin.h>
+# include <immintrin.h>
+#endif
+
+namespace cycfi::qplug
+{
+   namespace detail
+   {
+      namespace
+      {
+         // The portable implementation, compiled with the default flags
+         struct scalar
+         {
+            using vec = float;
+            static constexpr std::size_t width = 1;
+
+            static vec load(float const* p)     { return *p; }
+            static void store(float* p, vec v)  { *p = v; }
+            static vec set1(float x)            { return x; }
+            static vec iota()                   { return 0.0f; }
+            static vec add(vec a, vec b)        { return a + b; }
+            static vec mul(vec a, vec b)        { return a * b; }
+            static vec madd(vec a, vec b, vec c){ return a * b + c; }
+            static vec abs(vec a)               { return (a < 0.0f)? -a : a; }
+            static vec max(vec a, vec b)        { return (a < b)? b : a; }
+            static float hsum(vec a)            { return a; }
+            static float hmax(vec a)            { return a; }
+
+            static void zip(vec a, vec b, vec& lo, vec& hi)
+            {
+               lo = a;
+               hi = b;
+            }
+
+            static void unzip(vec lo, vec hi, vec& a, vec& b)
+            {
+               a = lo;
+               b = hi;
+            }
+         };
+
+         constexpr kernel_table scalar_table = make_kernel_table<scalar>();
+      }
+
+      // Constant initialized, so the kernels are usable even from static
+      // initializers that run before the CPU detection below.
+      kernel_table active_kernels = scalar_table;
+   }
+
+   namespace
+   {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+      // These also check that the OS saves the wider registers
+      struct cpu_features
+      {
+         cpu_features()
+         {
+            __builtin_cpu_init();
+            sse2 = __builtin_cpu_supports("sse2");
+            avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            avx512 = __builtin_cpu_supports("avx512f");
+         }
+
+         bool sse2, avx2, avx512;
+      };
+
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+
+      struct cpu_features
+      {
+         cpu_features()
+         {
+            int info[4];
+            __cpuid(info, 0);
+            int max_leaf = info[0];
+
+            __cpuid(info, 1);
+            sse2 = info[3] & (1 << 26);
+            bool fma = info[2] & (1 << 12);
+            bool osxsave = info[2] & (1 << 27);
+
+            // The OS must save the YMM (and for AVX-512, the ZMM) state
+            auto xcr0 = osxsave? _xgetbv(0) : 0;
+            bool ymm = (xcr0 & 0x06) == 0x06;
+            bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+            avx2 = avx512 = false;
+            if (max_leaf >= 7)
+            {
+               __cpuidex(info, 7, 0);
+               avx2 = ymm && fma && (info[1] & (1 << 5));
+               avx512 = zmm && (info[1] & (1 << 16));
+            }
+         }
+
+         bool sse2, avx2, avx512;
+      };
+
+#else
+
+      struct cpu_features
+      {
+         bool sse2 = false, avx2 = false, avx512 = false;
+      };
+
+#endif
+
+      cpu_features const& cpu()
+      {
+         static cpu_features const features;
+         return features;
+      }
+
+      kernel_isa select_kernels()
+      {
+         for (auto isa : { kernel_isa::avx512, kernel_isa::avx2, kernel_isa::sse2, kernel_isa::neon })
+         {
+            if (auto table = kernel_table_for(isa))
+            {
+               detail::active_kernels = *table;
+               return isa;
+            }
+         }
+         return kernel_isa::scalar;
+      }
+
+      kernel_isa const active_isa = select_kernels();
+   }
+
+   kernel_isa active_kernel_isa()
+   {
+      return active_isa;
+   }
+
+   char const* kernel_isa_name(kernel_isa isa)
+   {
+      switch (isa)
+      {
+         case kernel_isa::sse2:     return "sse2";
+         case kernel_isa::avx2:     return "avx2";
+         case kernel_isa::avx512:   return "avx512";
+         case kernel_isa::neon:     return "neon";
+         default:                   return "scalar";
+      }
+   }
+
+   kernel_table const* kernel_table_for(kernel_isa isa)
+   {
+      switch (isa)
+      {
+         case kernel_isa::sse2:     return cpu().sse2? detail::sse2_kernels : nullptr;
+         case kernel_isa::avx2:     return cpu().avx2? detail::avx2_kernels : nullptr;
+         case kernel_isa::avx512:   return cpu().avx512? detail::avx512_kernels : nullptr;
+         case kernel_isa::neon:     return detail::neon_kernels;  // Always there on ARMv8
+         default:                   return &detail::scalar_table;
+      }
+   }
+
+   namespace kernels
+   {
+      void interleave(float* out, float const* const* in, std::size_t channels, std::size_t n)
+      {
+         if (channels == 2)
+         {
+            qplug::detail::active_kernels.interleave2(out, in[0], in[1], n);
+            return;
+         }
+         for (std::size_t i = 0; i != n; ++i)
+            for (std::size_t ch = 0; ch != channels; ++ch)
+               *out++ = in[ch][i];
+      }
+
+      void deinterleave(float* const* out, float const* in, std::size_t channels, std::size_t n)
+      {
+         if (channels == 2)
+         {
+            qplug::detail::active_kernels.deinterleave2(out[0], out[1], in, n);
+            return;
+         }
+         for (std::size_t i = 0; i != n; ++i)
+            for (std::size_t ch = 0; ch != channels; ++ch)
+               out[ch][i] = *in++;
+      }
+   }
+}
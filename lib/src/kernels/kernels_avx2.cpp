@@ -0,0 +1,80 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include "kernels_impl.hpp"
+
+// Compiled with -mavx2 -mfma (/arch:AVX2 on MSVC). See CMakeLists.txt.
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+
+#include <immintrin.h>
+
+namespace cycfi::qplug::detail
+{
+   namespace
+   {
+      struct avx2
+      {
+         using vec = __m256;
+         static constexpr std::size_t width = 8;
+
+         static vec load(float const* p)     { return _mm256_loadu_ps(p); }
+         static void store(float* p, vec v)  { _mm256_storeu_ps(p, v); }
+         static vec set1(float x)            { return _mm256_set1_ps(x); }
+         static vec iota()                   { return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); }
+         static vec add(vec a, vec b)        { return _mm256_add_ps(a, b); }
+         static vec mul(vec a, vec b)        { return _mm256_mul_ps(a, b); }
+         static vec madd(vec a, vec b, vec c){ return _mm256_fmadd_ps(a, b, c); }
+         static vec abs(vec a)               { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+         static vec max(vec a, vec b)        { return _mm256_max_ps(a, b); }
+
+         static float hsum(vec a)
+         {
+            auto t = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+            t = _mm_add_ps(t, _mm_movehl_ps(t, t));
+            t = _mm_add_ss(t, _mm_shuffle_ps(t, t, 1));
+            return _mm_cvtss_f32(t);
+         }
+
+         static float hmax(vec a)
+         {
+            auto t = _mm_max_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+            t = _mm_max_ps(t, _mm_movehl_ps(t, t));
+            t = _mm_max_ss(t, _mm_shuffle_ps(t, t, 1));
+            return _mm_cvtss_f32(t);
+         }
+
+         static void zip(vec a, vec b, vec& lo, vec& hi)
+         {
+            // unpack works within 128 bit lanes; fix up the lane order
+            auto l = _mm256_unpacklo_ps(a, b);   // a0 b0 a1 b1 | a4 b4 a5 b5
+            auto h = _mm256_unpackhi_ps(a, b);   // a2 b2 a3 b3 | a6 b6 a7 b7
+            lo = _mm256_permute2f128_ps(l, h, 0x20);
+            hi = _mm256_permute2f128_ps(l, h, 0x31);
+         }
+
+         static void unzip(vec lo, vec hi, vec& a, vec& b)
+         {
+            // shuffle works within 128 bit lanes; fix up the pair order
+            auto ea = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)); // a0 a1 a4 a5 | a2 a3 a6 a7
+            auto eb = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+            a = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(ea), _MM_SHUFFLE(3, 1, 2, 0)));
+            b = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(eb), _MM_SHUFFLE(3, 1, 2, 0)));
+         }
+      };
+
+      constexpr kernel_table table = make_kernel_table<avx2>();
+   }
+
+   kernel_table const* const avx2_kernels = &table;
+}
+
+#else
+
+namespace cycfi::qplug::detail
+{
+   kernel_table const* const avx2_kernels = nullptr;
+}
+
+#endif
@@ -0,0 +1,73 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include "kernels_impl.hpp"
+
+// Compiled with -mavx512f (/arch:AVX512 on MSVC). See CMakeLists.txt.
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+
+namespace cycfi::qplug::detail
+{
+   namespace
+   {
+      struct avx512
+      {
+         using vec = __m512;
+         static constexpr std::size_t width = 16;
+
+         static vec load(float const* p)     { return _mm512_loadu_ps(p); }
+         static void store(float* p, vec v)  { _mm512_storeu_ps(p, v); }
+         static vec set1(float x)            { return _mm512_set1_ps(x); }
+         static vec add(vec a, vec b)        { return _mm512_add_ps(a, b); }
+         static vec mul(vec a, vec b)        { return _mm512_mul_ps(a, b); }
+         static vec madd(vec a, vec b, vec c){ return _mm512_fmadd_ps(a, b, c); }
+         static vec abs(vec a)               { return _mm512_abs_ps(a); }
+         static vec max(vec a, vec b)        { return _mm512_max_ps(a, b); }
+         static float hsum(vec a)            { return _mm512_reduce_add_ps(a); }
+         static float hmax(vec a)            { return _mm512_reduce_max_ps(a); }
+
+         static vec iota()
+         {
+            return _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+         }
+
+         static void zip(vec a, vec b, vec& lo, vec& hi)
+         {
+            // Indices 16 and up select from b
+            auto lo_index = _mm512_setr_epi32(
+               0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+            auto hi_index = _mm512_setr_epi32(
+               8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+            lo = _mm512_permutex2var_ps(a, lo_index, b);
+            hi = _mm512_permutex2var_ps(a, hi_index, b);
+         }
+
+         static void unzip(vec lo, vec hi, vec& a, vec& b)
+         {
+            auto even = _mm512_setr_epi32(
+               0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+            auto odd = _mm512_setr_epi32(
+               1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+            a = _mm512_permutex2var_ps(lo, even, hi);
+            b = _mm512_permutex2var_ps(lo, odd, hi);
+         }
+      };
+
+      constexpr kernel_table table = make_kernel_table<avx512>();
+   }
+
+   kernel_table const* const avx512_kernels = &table;
+}
+
+#else
+
+namespace cycfi::qplug::detail
+{
+   kernel_table const* const avx512_kernels = nullptr;
+}
+
+#endif
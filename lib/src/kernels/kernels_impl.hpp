@@ -0,0 +1,233 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(QPLUG_KERNELS_IMPL_HPP_NOVEMBER_11_2019)
+#define QPLUG_KERNELS_IMPL_HPP_NOVEMBER_11_2019
+
+#include <qplug/kernels.hpp>
+
+///////////////////////////////////////////////////////////////////////////////
+// The kernels, written once over a SIMD abstraction S and instantiated by
+// each ISA specific source file, compiled with its own instruction set
+// flags. S provides:
+//
+//    vec                           the vector type
+//    width                         floats per vec
+//    load(p), store(p, v)          unaligned load and store
+//    set1(x), iota()               broadcast, and { 0, 1, 2... }
+//    add(a, b), mul(a, b)
+//    madd(a, b, c)                 a * b + c
+//    abs(a), max(a, b)
+//    hsum(a), hmax(a)              horizontal sum and maximum
+//    zip(a, b, lo, hi)             interleave a and b into lo and hi
+//    unzip(lo, hi, a, b)           the inverse of zip
+//
+// Everything here has internal linkage (anonymous namespace). The same
+// inline functions compiled with different instruction sets in different
+// source files must not be merged by the linker, or AVX code may end up
+// running on a CPU without AVX. For the same reason, the kernels do not
+// call into the standard library.
+///////////////////////////////////////////////////////////////////////////////
+namespace cycfi::qplug::detail
+{
+   namespace
+   {
+      template <typename S>
+      struct kernels_impl
+      {
+         using vec = typename S::vec;
+         static constexpr std::size_t w = S::width;
+
+         static void clear(float* out, std::size_t n)
+         {
+            std::size_t i = 0;
+            auto zero = S::set1(0.0f);
+            for (; i + w <= n; i += w)
+               S::store(out + i, zero);
+            for (; i != n; ++i)
+               out[i] = 0.0f;
+         }
+
+         static void copy(float* out, float const* in, std::size_t n)
+         {
+            std::size_t i = 0;
+            for (; i + w <= n; i += w)
+               S::store(out + i, S::load(in + i));
+            for (; i != n; ++i)
+               out[i] = in[i];
+         }
+
+         static void gain(float* out, float const* in, float g, std::size_t n)
+         {
+            std::size_t i = 0;
+            auto vg = S::set1(g);
+            for (; i + w <= n; i += w)
+               S::store(out + i, S::mul(S::load(in + i), vg));
+            for (; i != n; ++i)
+               out[i] = in[i] * g;
+         }
+
+         static void gain_buffer(
+            float* out, float const* in, float const* g, float scale, std::size_t n)
+         {
+            std::size_t i = 0;
+            auto vs = S::set1(scale);
+            for (; i + w <= n; i += w)
+               S::store(out + i, S::mul(S::load(in + i), S::mul(S::load(g + i), vs)));
+            for (; i != n; ++i)
+               out[i] = in[i] * (g[i] * scale);
+         }
+
+         static void gain_ramp(
+            float* out, float const* in, float from, float to, std::size_t n)
+         {
+            if (n == 0)
+               return;
+
+            // The gain at frame i is from + step * (i + 1), computed from
+            // the index rather than accumulated, so there is no drift.
+            float step = (to - from) / n;
+            std::size_t i = 0;
+            auto vstep = S::set1(step);
+            auto vindex = S::add(S::iota(), S::set1(1.0f));
+            auto vw = S::set1(float(w));
+            auto vfrom = S::set1(from);
+            for (; i + w <= n; i += w)
+            {
+               auto g = S::madd(vindex, vstep, vfrom);
+               S::store(out + i, S::mul(S::load(in + i), g));
+               vindex = S::add(vindex, vw);
+            }
+            for (; i != n; ++i)
+               out[i] = in[i] * (from + step * float(i + 1));
+         }
+
+         static void mix(float* out, float const* in, float g, std::size_t n)
+         {
+            std::size_t i = 0;
+            auto vg = S::set1(g);
+            for (; i + w <= n; i += w)
+               S::store(out + i, S::madd(S::load(in + i), vg, S::load(out + i)));
+            for (; i != n; ++i)
+               out[i] += in[i] * g;
+         }
+
+         static void pan(
+            float* left, float* right, float const* in
+          , float gl, float gr, std::size_t n)
+         {
+            std::size_t i = 0;
+            auto vgl = S::set1(gl);
+            auto vgr = S::set1(gr);
+            for (; i + w <= n; i += w)
+            {
+               auto x = S::load(in + i);
+               S::store(left + i, S::mul(x, vgl));
+               S::store(right + i, S::mul(x, vgr));
+            }
+            for (; i != n; ++i)
+            {
+               left[i] = in[i] * gl;
+               right[i] = in[i] * gr;
+            }
+         }
+
+         static float peak(float const* in, std::size_t n)
+         {
+            std::size_t i = 0;
+            auto vmax = S::set1(0.0f);
+            for (; i + w <= n; i += w)
+               vmax = S::max(vmax, S::abs(S::load(in + i)));
+            float result = S::hmax(vmax);
+            for (; i != n; ++i)
+            {
+               float x = (in[i] < 0.0f)? -in[i] : in[i];
+               if (x > result)
+                  result = x;
+            }
+            return result;
+         }
+
+         static float sum_squares(float const* in, std::size_t n)
+         {
+            std::size_t i = 0;
+            auto vsum = S::set1(0.0f);
+            for (; i + w <= n; i += w)
+            {
+               auto x = S::load(in + i);
+               vsum = S::madd(x, x, vsum);
+            }
+            float result = S::hsum(vsum);
+            for (; i != n; ++i)
+               result += in[i] * in[i];
+            return result;
+         }
+
+         static void interleave2(
+            float* out, float const* left, float const* right, std::size_t n)
+         {
+            std::size_t i = 0;
+            for (; i + w <= n; i += w)
+            {
+               vec lo, hi;
+               S::zip(S::load(left + i), S::load(right + i), lo, hi);
+               S::store(out + 2*i, lo);
+               S::store(out + 2*i + w, hi);
+            }
+            for (; i != n; ++i)
+            {
+               out[2*i] = left[i];
+               out[2*i + 1] = right[i];
+            }
+         }
+
+         static void deinterleave2(
+            float* left, float* right, float const* in, std::size_t n)
+         {
+            std::size_t i = 0;
+            for (; i + w <= n; i += w)
+            {
+               vec a, b;
+               S::unzip(S::load(in + 2*i), S::load(in + 2*i + w), a, b);
+               S::store(left + i, a);
+               S::store(right + i, b);
+            }
+            for (; i != n; ++i)
+            {
+               left[i] = in[2*i];
+               right[i] = in[2*i + 1];
+            }
+         }
+      };
+
+      template <typename S>
+      constexpr kernel_table make_kernel_table()
+      {
+         using impl = kernels_impl<S>;
+         return {
+            &impl::clear
+          , &impl::copy
+          , &impl::gain
+          , &impl::gain_buffer
+          , &impl::gain_ramp
+          , &impl::mix
+          , &impl::pan
+          , &impl::peak
+          , &impl::sum_squares
+          , &impl::interleave2
+          , &impl::deinterleave2
+         };
+      }
+   }
+
+   // Defined in the ISA specific source files. The tables for instruction
+   // sets that the build does not support are null.
+   extern kernel_table const* const sse2_kernels;
+   extern kernel_table const* const avx2_kernels;
+   extern kernel_table const* const avx512_kernels;
+   extern kernel_table const* const neon_kernels;
+}
+
+#endif
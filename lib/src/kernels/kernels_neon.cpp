@@ -0,0 +1,67 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include "kernels_impl.hpp"
+
+// NEON is part of the base ARMv8 (64 bit) instruction set; no flags needed.
+#if defined(__aarch64__) || defined(_M_ARM64)
+
+#include <arm_neon.h>
+
+namespace cycfi::qplug::detail
+{
+   namespace
+   {
+      struct neon
+      {
+         using vec = float32x4_t;
+         static constexpr std::size_t width = 4;
+
+         static vec load(float const* p)     { return vld1q_f32(p); }
+         static void store(float* p, vec v)  { vst1q_f32(p, v); }
+         static vec set1(float x)            { return vdupq_n_f32(x); }
+         static vec add(vec a, vec b)        { return vaddq_f32(a, b); }
+         static vec mul(vec a, vec b)        { return vmulq_f32(a, b); }
+         static vec madd(vec a, vec b, vec c){ return vfmaq_f32(c, a, b); }
+         static vec abs(vec a)               { return vabsq_f32(a); }
+         static vec max(vec a, vec b)        { return vmaxq_f32(a, b); }
+         static float hsum(vec a)            { return vaddvq_f32(a); }
+         static float hmax(vec a)            { return vmaxvq_f32(a); }
+
+         static vec iota()
+         {
+            float const index[] = { 0, 1, 2, 3 };
+            return vld1q_f32(index);
+         }
+
+         static void zip(vec a, vec b, vec& lo, vec& hi)
+         {
+            auto z = vzipq_f32(a, b);
+            lo = z.val[0];
+            hi = z.val[1];
+         }
+
+         static void unzip(vec lo, vec hi, vec& a, vec& b)
+         {
+            auto u = vuzpq_f32(lo, hi);
+            a = u.val[0];
+            b = u.val[1];
+         }
+      };
+
+      constexpr kernel_table table = make_kernel_table<neon>();
+   }
+
+   kernel_table const* const neon_kernels = &table;
+}
+
+#else
+
+namespace cycfi::qplug::detail
+{
+   kernel_table const* const neon_kernels = nullptr;
+}
+
+#endif
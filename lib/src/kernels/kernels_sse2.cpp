@@ -0,0 +1,71 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include "kernels_impl.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+namespace cycfi::qplug::detail
+{
+   namespace
+   {
+      struct sse2
+      {
+         using vec = __m128;
+         static constexpr std::size_t width = 4;
+
+         static vec load(float const* p)     { return _mm_loadu_ps(p); }
+         static void store(float* p, vec v)  { _mm_storeu_ps(p, v); }
+         static vec set1(float x)            { return _mm_set1_ps(x); }
+         static vec iota()                   { return _mm_setr_ps(0, 1, 2, 3); }
+         static vec add(vec a, vec b)        { return _mm_add_ps(a, b); }
+         static vec mul(vec a, vec b)        { return _mm_mul_ps(a, b); }
+         static vec madd(vec a, vec b, vec c){ return _mm_add_ps(_mm_mul_ps(a, b), c); }
+         static vec abs(vec a)               { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+         static vec max(vec a, vec b)        { return _mm_max_ps(a, b); }
+
+         static float hsum(vec a)
+         {
+            auto t = _mm_add_ps(a, _mm_movehl_ps(a, a));
+            t = _mm_add_ss(t, _mm_shuffle_ps(t, t, 1));
+            return _mm_cvtss_f32(t);
+         }
+
+         static float hmax(vec a)
+         {
+            auto t = _mm_max_ps(a, _mm_movehl_ps(a, a));
+            t = _mm_max_ss(t, _mm_shuffle_ps(t, t, 1));
+            return _mm_cvtss_f32(t);
+         }
+
+         static void zip(vec a, vec b, vec& lo, vec& hi)
+         {
+            lo = _mm_unpacklo_ps(a, b);
+            hi = _mm_unpackhi_ps(a, b);
+         }
+
+         static void unzip(vec lo, vec hi, vec& a, vec& b)
+         {
+            a = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+            b = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+         }
+      };
+
+      constexpr kernel_table table = make_kernel_table<sse2>();
+   }
+
+   kernel_table const* const sse2_kernels = &table;
+}
+
+#else
+
+namespace cycfi::qplug::detail
+{
+   kernel_table const* const sse2_kernels = nullptr;
+}
+
+#endif
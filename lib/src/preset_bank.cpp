@@ -0,0 +1,369 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <qplug/preset_bank.hpp>
+#include <qplug/plugin_state.hpp>
+#include <qplug/preset_reader.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+
+#if defined(_WIN32)
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace cycfi::qplug
+{
+   namespace
+   {
+      std::size_t num_words(std::size_t num_params)
+      {
+         return (num_params + 63) / 64;
+      }
+
+#if defined(_WIN32)
+
+      char const* map_file(fs::path const& path, std::size_t& size, void*& mapping)
+      {
+         HANDLE file = CreateFileW(
+            path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ
+          , nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+         if (file == INVALID_HANDLE_VALUE)
+            return nullptr;
+
+         LARGE_INTEGER file_size;
+         char const* data = nullptr;
+         if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+         {
+            mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping)
+            {
+               data = static_cast<char const*>(
+                  MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+               if (data)
+               {
+                  size = std::size_t(file_size.QuadPart);
+               }
+               else
+               {
+                  CloseHandle(mapping);
+                  mapping = nullptr;
+               }
+            }
+         }
+         CloseHandle(file);
+         return data;
+      }
+
+      void unmap_file(char const* data, std::size_t size, void* mapping)
+      {
+         UnmapViewOfFile(data);
+         CloseHandle(mapping);
+      }
+
+#else
+
+      char const* map_file(fs::path const& path, std::size_t& size, void*& /*mapping*/)
+      {
+         int fd = ::open(path.string().c_str(), O_RDONLY);
+         if (fd < 0)
+            return nullptr;
+
+         struct stat st;
+         char const* data = nullptr;
+         if (::fstat(fd, &st) == 0 && st.st_size > 0)
+         {
+            auto p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+               data = static_cast<char const*>(p);
+               size = std::size_t(st.st_size);
+            }
+         }
+         ::close(fd);   // The mapping stays valid
+         return data;
+      }
+
+      void unmap_file(char const* data, std::size_t size, void* /*mapping*/)
+      {
+         ::munmap(const_cast<char*>(data), size);
+      }
+
+#endif
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // preset_bank
+   ////////////////////////////////////////////////////////////////////////////
+   preset_bank::~preset_bank()
+   {
+      close();
+   }
+
+   bool preset_bank::open(fs::path const& path, parameter_list params)
+   {
+      close();
+
+      std::size_t size = 0;
+      void* mapping = nullptr;
+      auto data = map_file(path, size, mapping);
+      if (!data)
+         return false;
+
+      _data = data;
+      _size = size;
+      _mapping = mapping;
+
+      // Validate the header and the sizes of the tables
+      if (size < sizeof(bank_header))
+      {
+         close();
+         return false;
+      }
+
+      bank_header header;
+      std::memcpy(&header, data, sizeof(bank_header));
+      std::uint64_t num_params = header.num_params;
+      std::uint64_t num_presets = header.num_presets;
+      std::uint64_t record_size = (num_words(num_params) + num_params) * 8;
+      std::uint64_t total = sizeof(bank_header)
+         + num_params * sizeof(std::uint64_t)
+         + num_presets * (sizeof(bank_name) + record_size)
+         + header.strings_size
+         ;
+
+      if (header.magic != preset_bank_magic
+         || header.version > preset_bank_version
+         || header.record_size != record_size
+         || total > size)
+      {
+         close();
+         return false;
+      }
+
+      auto ids = data + sizeof(bank_header);
+      auto names = ids + num_params * sizeof(std::uint64_t);
+      _num_presets = num_presets;
+      _num_params = num_params;
+      _record_size = record_size;
+      _names = reinterpret_cast<bank_name const*>(names);
+      _records = names + num_presets * sizeof(bank_name);
+      _strings = _records + num_presets * record_size;
+
+      for (std::size_t i = 0; i != _num_presets; ++i)
+      {
+         if (std::uint64_t(_names[i].offset) + _names[i].size > header.strings_size)
+         {
+            close();
+            return false;
+         }
+      }
+
+      // Map the bank's columns to the plugin's parameters
+      parameter_index index{ params };
+      _columns.assign(params.size(), -1);
+      for (std::size_t col = 0; col != _num_params; ++col)
+      {
+         std::uint64_t id;
+         std::memcpy(&id, ids + col * sizeof(std::uint64_t), sizeof(id));
+         auto param = index.find(id);
+         if (param >= 0)
+            _columns[param] = int(col);
+      }
+      return true;
+   }
+
+   void preset_bank::close()
+   {
+      if (_data)
+         unmap_file(_data, _size, _mapping);
+
+      _data = nullptr;
+      _size = 0;
+      _mapping = nullptr;
+      _num_presets = 0;
+      _num_params = 0;
+      _record_size = 0;
+      _names = nullptr;
+      _records = nullptr;
+      _strings = nullptr;
+      _columns.clear();
+   }
+
+   void preset_bank::swap(preset_bank& other)
+   {
+      std::swap(_data, other._data);
+      std::swap(_size, other._size);
+      std::swap(_mapping, other._mapping);
+      std::swap(_num_presets, other._num_presets);
+      std::swap(_num_params, other._num_params);
+      std::swap(_record_size, other._record_size);
+      std::swap(_names, other._names);
+      std::swap(_records, other._records);
+      std::swap(_strings, other._strings);
+      std::swap(_columns, other._columns);
+   }
+
+   int preset_bank::find(std::string_view name_) const
+   {
+      std::size_t first = 0;
+      std::size_t count = _num_presets;
+      while (count > 0)
+      {
+         auto step = count / 2;
+         auto i = first + step;
+         if (name(i) < name_)
+         {
+            first = i + 1;
+            count -= step + 1;
+         }
+         else
+         {
+            count = step;
+         }
+      }
+      if (first != _num_presets && name(first) == name_)
+         return int(first);
+      return -1;
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // preset_bank_writer
+   ////////////////////////////////////////////////////////////////////////////
+   preset_bank_writer::preset_bank_writer(parameter_list params)
+    : _num_params(params.size())
+    , _num_words(num_words(params.size()))
+   {
+      _ids.reserve(params.size());
+      for (auto const& param : params)
+         _ids.push_back(parameter_hash(param._name));
+   }
+
+   void preset_bank_writer::add_preset(std::string_view name)
+   {
+      auto [i, added] = _lookup.try_emplace(std::string{ name }, _names.size());
+      _current = i->second;
+      if (added)
+      {
+         _names.emplace_back(name);
+         _bits.resize(_bits.size() + _num_words, 0);
+         _values.resize(_values.size() + _num_params, 0.0);
+      }
+      else
+      {
+         std::fill_n(_bits.begin() + _current * _num_words, _num_words, 0);
+      }
+   }
+
+   void preset_bank_writer::set(int param, double value)
+   {
+      if (_names.empty() || std::size_t(param) >= _num_params)
+         return;
+      _bits[_current * _num_words + param / 64] |= std::uint64_t(1) << (param % 64);
+      _values[_current * _num_params + param] = value;
+   }
+
+   void preset_bank_writer::write(ostream& str) const
+   {
+      std::vector<std::size_t> order(_names.size());
+      std::iota(order.begin(), order.end(), 0);
+      std::sort(order.begin(), order.end(),
+         [this](auto a, auto b) { return _names[a] < _names[b]; }
+      );
+
+      std::size_t strings_size = 0;
+      for (auto const& name : _names)
+         strings_size += name.size();
+
+      bank_header header;
+      header.magic = preset_bank_magic;
+      header.version = preset_bank_version;
+      header.num_params = std::uint32_t(_num_params);
+      header.num_presets = std::uint32_t(_names.size());
+      header.record_size = std::uint32_t((_num_words + _num_params) * 8);
+      header.strings_size = std::uint32_t(strings_size);
+
+      auto bytes = [&str](auto const* p, std::size_t n)
+      {
+         str.write(reinterpret_cast<char const*>(p), n * sizeof(*p));
+      };
+
+      str.reserve(sizeof(header)
+         + _ids.size() * sizeof(std::uint64_t)
+         + _names.size() * (sizeof(bank_name) + header.record_size)
+         + strings_size
+      );
+
+      bytes(&header, 1);
+      bytes(_ids.data(), _ids.size());
+
+      std::uint32_t offset = 0;
+      for (auto i : order)
+      {
+         bank_name n{ offset, std::uint32_t(_names[i].size()) };
+         bytes(&n, 1);
+         offset += n.size;
+      }
+
+      for (auto i : order)
+      {
+         bytes(_bits.data() + i * _num_words, _num_words);
+         bytes(_values.data() + i * _num_params, _num_params);
+      }
+
+      for (auto i : order)
+         bytes(_names[i].data(), _names[i].size());
+   }
+
+   bool preset_bank_writer::write(fs::path const& path) const
+   {
+      std::vector<char> buff;
+      vector_ostream str{ buff };
+      write(str);
+
+      // Write to a temporary file first, so that a bank is never seen
+      // (or mapped) half written.
+      auto tmp = path;
+      tmp += ".tmp";
+      {
+         std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+         file.write(buff.data(), buff.size());
+         if (!file)
+            return false;
+      }
+
+      std::error_code ec;
+      fs::rename(tmp, path, ec);
+      return !ec;
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // JSON conversion
+   ////////////////////////////////////////////////////////////////////////////
+   bool convert_presets(
+      std::string_view json, preset_bank::parameter_list params
+    , preset_bank_writer& bank)
+   {
+      auto&& on_param =
+         [&bank, params](auto const& p, parameter const& param)
+         {
+            bank.set(int(&param - params.begin()), p.second);
+         };
+
+      auto&& on_preset_name =
+         [&bank](std::string_view name)
+         {
+            bank.add_preset(name);
+         };
+
+      return read_presets(json, parameter_names{ params }, on_param, on_preset_name);
+   }
+}
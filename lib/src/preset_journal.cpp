@@ -0,0 +1,429 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <qplug/preset_journal.hpp>
+#include <qplug/data_stream.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if defined(_WIN32)
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/file.h>
+# include <unistd.h>
+#endif
+
+namespace cycfi::qplug
+{
+   namespace
+   {
+      constexpr std::size_t journal_header_size = 2 * sizeof(std::uint32_t);
+      constexpr std::size_t record_header_size =
+         sizeof(std::uint32_t) + sizeof(std::uint64_t);
+
+      std::uint64_t checksum(char const* data, std::size_t size)
+      {
+         return parameter_hash({ data, size });
+      }
+
+      // Leave room for the record header, then start the payload
+      void begin_record(vector_ostream& str, journal_op op, std::string_view name)
+      {
+         str._buff.resize(record_header_size);
+         str << std::uint8_t(op) << name;
+      }
+
+      // Wrap the payload (everything after the record header) in place
+      void end_record(std::vector<char>& buff)
+      {
+         auto size = std::uint32_t(buff.size() - record_header_size);
+         auto sum = checksum(buff.data() + record_header_size, size);
+         std::memcpy(buff.data(), &size, sizeof(size));
+         std::memcpy(buff.data() + sizeof(size), &sum, sizeof(sum));
+      }
+
+      // An exclusive lock on the journal's lock file, shared with the
+      // other processes (and threads: each lock opens the file anew). If
+      // the lock file can't be opened, the journal goes on unlocked.
+      class file_lock
+      {
+      public:
+
+         explicit file_lock(fs::path path)
+         {
+            path += ".lock";
+#if defined(_WIN32)
+            _file = CreateFileW(
+               path.wstring().c_str(), GENERIC_READ | GENERIC_WRITE
+             , FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS
+             , FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (_file != INVALID_HANDLE_VALUE)
+            {
+               OVERLAPPED overlapped = {};
+               LockFileEx(_file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped);
+            }
+#else
+            _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (_fd >= 0)
+            {
+               while (::flock(_fd, LOCK_EX) != 0 && errno == EINTR)
+                  ;
+            }
+#endif
+         }
+
+         ~file_lock()
+         {
+            // Closing the file releases the lock
+#if defined(_WIN32)
+            if (_file != INVALID_HANDLE_VALUE)
+               CloseHandle(_file);
+#else
+            if (_fd >= 0)
+               ::close(_fd);
+#endif
+         }
+
+         file_lock(file_lock const&) = delete;
+         file_lock& operator=(file_lock const&) = delete;
+
+      private:
+
+#if defined(_WIN32)
+         HANDLE _file = INVALID_HANDLE_VALUE;
+#else
+         int _fd = -1;
+#endif
+      };
+   }
+
+   preset_journal::~preset_journal()
+   {
+      flush();
+
+      // The writer is done. Don't join: this may run while a plugin
+      // library is being unloaded, where joining can deadlock.
+      if (_thread.joinable())
+         _thread.detach();
+   }
+
+   void preset_journal::open(fs::path const& path, parameter_list params)
+   {
+      flush();
+      _path = path;
+      _index = parameter_index{ params };
+      _ids.clear();
+      for (std::size_t i = 0; i != _index.size(); ++i)
+         _ids.push_back(_index.id(i));
+   }
+
+   std::size_t preset_journal::replay(preset_store& presets)
+   {
+      return read(presets, true);
+   }
+
+   std::size_t preset_journal::replay_more(preset_store& presets)
+   {
+      return read(presets, false);
+   }
+
+   std::size_t preset_journal::read(preset_store& presets, bool repair)
+   {
+      // The whole journal, or the records written since the last replay
+      std::uint64_t start = repair? 0 : _replayed.load();
+      if (start < journal_header_size)
+         start = 0;
+
+      // Appends are made under the lock too, so an incomplete record at the
+      // end is not one being written: it was cut short (e.g. by a crash)
+      file_lock lock{ _path };
+      std::string src;
+      {
+         std::ifstream file(_path, std::ios::binary);
+         if (!file)
+            return 0;
+         file.seekg(start);
+         src.assign(
+            (std::istreambuf_iterator<char>(file))
+          , std::istreambuf_iterator<char>());
+      }
+
+      std::size_t pos = 0;
+      if (start == 0)
+      {
+         memory_istream header{ src.data(), src.size() };
+         std::uint32_t magic = 0;
+         std::uint32_t version = 0;
+         header >> magic >> version;
+         if (!header.good() || magic != journal_magic || version > journal_version)
+         {
+            // Not a journal we can read. Start over, or we would append to
+            // it.
+            if (repair)
+               clear();
+            return 0;
+         }
+         pos = header.pos();
+      }
+
+      std::size_t applied = 0;
+      while (src.size() - pos >= record_header_size)
+      {
+         memory_istream str{ src.data() + pos, src.size() - pos };
+         std::uint32_t size = 0;
+         std::uint64_t sum = 0;
+         str >> size >> sum;
+         if (size > str.remaining())
+            break;
+
+         auto payload = src.data() + pos + record_header_size;
+         if (checksum(payload, size) != sum)
+            break;
+
+         memory_istream record{ payload, size };
+         std::uint8_t op = 0;
+         std::string_view name;
+         record >> op;
+         record.read_view(name);
+
+         if (op == journal_erase && record.good())
+         {
+            presets.erase(name);
+         }
+         else if (op == journal_save)
+         {
+            std::string_view ids, values;
+            record.read_array_view<std::uint64_t>(ids);
+            record.read_array_view<double>(values);
+            auto n = ids.size() / sizeof(std::uint64_t);
+            if (!record.good() || values.size() != n * sizeof(double))
+               break;
+
+            auto preset = presets.add(name);
+            presets.clear(preset);
+            for (std::size_t i = 0; i != n; ++i)
+            {
+               std::uint64_t id;
+               double value;
+               std::memcpy(&id, ids.data() + i * sizeof(id), sizeof(id));
+               std::memcpy(&value, values.data() + i * sizeof(value), sizeof(value));
+               auto param = _index.find(id);
+               if (param >= 0)
+                  presets.set(preset, param, value);
+            }
+         }
+         else
+         {
+            break;
+         }
+         pos += record_header_size + size;
+         ++applied;
+      }
+
+      // Drop a partially written or corrupt tail, so that new records are
+      // not appended after it
+      if (repair && pos != src.size())
+      {
+         std::error_code ec;
+         fs::resize_file(_path, pos, ec);
+      }
+
+      _replayed = start + pos;
+      if (repair)
+         _size = applied;
+      return applied;
+   }
+
+   void preset_journal::save(preset_store const& presets, int preset)
+   {
+      std::vector<std::uint64_t> ids;
+      std::vector<double> values;
+      presets.for_each(preset,
+         [&](int param, double value)
+         {
+            ids.push_back(_ids[param]);
+            values.push_back(value);
+         }
+      );
+
+      std::vector<char> record;
+      vector_ostream str{ record };
+      begin_record(str, journal_save, presets.name(preset));
+      str.write_array(ids);
+      str.write_array(values);
+      end_record(record);
+      push({ std::move(record), nullptr });
+   }
+
+   void preset_journal::erase(std::string_view name)
+   {
+      std::vector<char> record;
+      vector_ostream str{ record };
+      begin_record(str, journal_erase, name);
+      end_record(record);
+      push({ std::move(record), nullptr });
+   }
+
+   void preset_journal::compact(compact_function write_main)
+   {
+      push({ {}, std::move(write_main) });
+   }
+
+   void preset_journal::flush()
+   {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _idle.wait(lock, [this] { return !_running; });
+   }
+
+   bool preset_journal::idle()
+   {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return !_running;
+   }
+
+   void preset_journal::push(job&& j)
+   {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (j.write_main)
+         _size = 0;
+      else
+         ++_size;
+      _jobs.push_back(std::move(j));
+
+      // Start the writer if it is not running. A previous writer, if any,
+      // has finished (it stops running only once there is nothing left).
+      if (!_running)
+      {
+         if (_thread.joinable())
+            _thread.join();
+         _running = true;
+         _thread = std::thread{ [this] { writer(); } };
+      }
+   }
+
+   void preset_journal::writer()
+   {
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (!_jobs.empty())
+      {
+         // Take consecutive records together, so they are written at once
+         std::vector<char> records;
+         compact_function write_main;
+         while (!_jobs.empty() && !write_main)
+         {
+            auto& front = _jobs.front();
+            if (front.write_main)
+            {
+               if (!records.empty())
+                  break;
+               write_main = std::move(front.write_main);
+            }
+            else
+            {
+               records.insert(records.end(), front.record.begin(), front.record.end());
+            }
+            _jobs.pop_front();
+         }
+
+         lock.unlock();
+         if (write_main)
+         {
+            // On failure, the journal is kept and replayed on the next
+            // start
+            if (auto pos = write_main())
+               drop(pos);
+         }
+         else
+         {
+            append(records);
+         }
+         lock.lock();
+      }
+
+      _running = false;
+      _idle.notify_all();
+   }
+
+   bool preset_journal::append(std::vector<char> const& records)
+   {
+      std::error_code ec;
+      fs::create_directories(_path.parent_path(), ec);
+      file_lock lock{ _path };
+
+      auto size = fs::file_size(_path, ec);
+      if (ec || size == 0)
+      {
+         if (!clear())
+            return false;
+         size = journal_header_size;
+      }
+
+      // A journal without records has nothing to replay
+      if (size == journal_header_size && _replayed < journal_header_size)
+         _replayed = journal_header_size;
+
+      std::ofstream file(_path, std::ios::binary | std::ios::app);
+      file.write(records.data(), records.size());
+      file.flush();
+      if (!file)
+         return false;
+
+      // Nobody wrote since the journal was last applied: the records are
+      // applied already (they were written from the presets)
+      if (_replayed == size)
+         _replayed = size + records.size();
+      return true;
+   }
+
+   bool preset_journal::drop(std::uint64_t pos)
+   {
+      file_lock lock{ _path };
+      pos = std::max<std::uint64_t>(pos, journal_header_size);
+
+      // The records appended after pos (e.g. by another process while the
+      // main presets were written) are not in them. Keep them.
+      std::string tail;
+      {
+         std::ifstream file(_path, std::ios::binary);
+         if (file && file.seekg(pos))
+         {
+            tail.assign(
+               (std::istreambuf_iterator<char>(file))
+             , std::istreambuf_iterator<char>());
+         }
+      }
+
+      auto replayed = _replayed.load();
+      if (!clear())
+         return false;
+      if (!tail.empty())
+      {
+         std::ofstream file(_path, std::ios::binary | std::ios::app);
+         file.write(tail.data(), tail.size());
+         file.flush();
+      }
+
+      // Keep the position, in the tail. The whole journal is replayed if
+      // it was rewound since.
+      _replayed = (replayed >= pos)? journal_header_size + (replayed - pos) : 0;
+      return true;
+   }
+
+   // Requires the file lock
+   bool preset_journal::clear()
+   {
+      std::ofstream file(_path, std::ios::binary | std::ios::trunc);
+      file.write(reinterpret_cast<char const*>(&journal_magic), sizeof(journal_magic));
+      file.write(reinterpret_cast<char const*>(&journal_version), sizeof(journal_version));
+      file.flush();
+      _replayed = journal_header_size;
+      return bool(file);
+   }
+}
@@ -7,6 +7,8 @@
 
 #if defined(IPLUG2)
 # include "iplug2/iplug2_plugin.hpp"
+#elif defined(QPLUG_HEADLESS)
+# include "headless/headless_plugin.hpp"
 #endif
 
 namespace cycfi::qplug
@@ -23,13 +25,218 @@ namespace cycfi::qplug
 
    void processor::update_parameter(int id, double value)
    {
-      if (id < _on_parameter_change.size())
+      if (_bindings)
+         dispatch_parameter(id, value);
+      else if (id < _on_parameter_change.size())
          _on_parameter_change[id](value);
    }
 
+   void processor::init_parameters(parameter_list params)
+   {
+      std::vector<double> values(params.size());
+      _ramps.resize(params.size());
+      _smooth_ms.resize(params.size());
+      _smoothed.clear();
+      for (std::size_t i = 0; i != params.size(); ++i)
+      {
+         auto const& param = params[i];
+         values[i] = param.init_value();
+         _ramps[i].jump(values[i]);
+         _smooth_ms[i] = param._smooth;
+         if (param._smooth > 0.0)
+            _smoothed.push_back(i);
+      }
+      _parameters.reset(values);
+      _morph.reset(params);
+   }
+
+   void processor::prepare(std::size_t max_frames)
+   {
+      // The audio is not running. Apply what was published meanwhile.
+      apply_published_parameters();
+      _parameters.clear_changed();
+
+      for (auto id : _smoothed)
+         _ramps[id].config(_smooth_ms[id], sps(), max_frames);
+
+      if (channel_group_size() && !_workers)
+         _workers = std::make_unique<worker_pool>();
+   }
+
    void processor::parameter_change(int id, double value)
    {
+      if (std::size_t(id) < _ramps.size())
+         _ramps[id].target(value);
+      apply_parameter(id, value);
+   }
+
+   void processor::parameter_change(parameter_event const& ev)
+   {
+      // Smoothed ramps were already restarted at the event's frame by
+      // begin_block
+      if (std::size_t(ev.id) < _ramps.size() && !_ramps[ev.id].smoothed())
+         _ramps[ev.id].target(ev.value);
+      apply_parameter(ev.id, ev.value);
+   }
+
+   void processor::apply_parameter(int id, double value)
+   {
+      _parameters.assign(id, value);
       update_parameter(id, value);
       on_parameter_change(id, value);
    }
+
+   void processor::parameter_change(int id, double value, int frame)
+   {
+      // Queue the change if we are sample accurate and the host gave us a
+      // frame offset. Otherwise (or if the queue is full), publish it for
+      // the next block.
+      if (frame < 0 || !sample_accurate()
+         || !_parameter_events.push({ std::uint32_t(frame), id, value }))
+      {
+         publish_parameter(id, value);
+      }
+   }
+
+   void processor::publish_parameter(int id, double value)
+   {
+      _parameters.publish(id, value);
+   }
+
+   void processor::publish_parameters(parameter_value_list const& values)
+   {
+      // Applied together, in the same block
+      _parameters.begin_batch();
+      for (auto const& v : values)
+         _parameters.publish(v.id, v.value);
+      _parameters.end_batch();
+   }
+
+   void processor::apply_published_parameters()
+   {
+      _parameters.acquire(
+         [this](int id, double value)
+         {
+            parameter_change(id, value);
+         }
+      );
+   }
+
+   std::uint32_t processor::morph(
+      std::vector<double> const& from
+    , std::vector<double> const& to
+    , double ms
+    , double switch_point
+   )
+   {
+      return _morph.start(from, to, ms, switch_point);
+   }
+
+   void processor::stop_morph()
+   {
+      _morph.stop();
+   }
+
+   void processor::apply_morph(std::size_t frames)
+   {
+      _morph.update(frames, sps(),
+         [this](int id, double value)
+         {
+            if (_parameters[id] != value)
+               parameter_change(id, value);
+         }
+      );
+   }
+
+   void processor::midi_message(q::midi::raw_message msg, std::size_t frame)
+   {
+      if (!_midi_dispatch)
+         return;
+
+      // Queue the message if we are sample accurate. If the queue is full,
+      // dispatch the message immediately.
+      if (!sample_accurate() || !_midi_events.push({ std::uint32_t(frame), msg }))
+         _midi_dispatch(_midi_receiver, msg, frame);
+   }
+
+   void processor::dispatch_midi(midi_event const& ev)
+   {
+      _midi_dispatch(_midi_receiver, ev.msg, ev.frame);
+   }
+
+   void processor::begin_block(std::size_t frames)
+   {
+      _block_start = clock::now();
+      _block_frames = frames;
+
+      apply_published_parameters();
+      apply_morph(frames);
+      for (auto id : _smoothed)
+         _ramps[id].update(frames);
+
+      // Restart the smoothed ramps at their sample accurate events
+      if (!_smoothed.empty())
+      {
+         for (auto const& ev : _parameter_events)
+         {
+            if (std::size_t(ev.id) < _ramps.size() && _ramps[ev.id].smoothed())
+               _ramps[ev.id].target(ev.value, ev.frame);
+         }
+      }
+   }
+
+   void processor::process_block(
+      float const** in, std::size_t num_in
+    , float** out, std::size_t num_out
+    , std::size_t frames
+   )
+   {
+      auto group_size = channel_group_size();
+      if (group_size == 0 || !_workers)
+      {
+         process(in_channels{ in, num_in, frames }, out_channels{ out, num_out, frames });
+         return;
+      }
+
+      auto num_channels = std::max(num_in, num_out);
+      auto num_groups = (num_channels + group_size - 1) / group_size;
+      _workers->run(num_groups,
+         [&](std::size_t group)
+         {
+            auto first = group * group_size;
+            auto group_in = (first < num_in)? std::min(group_size, num_in - first) : 0;
+            auto group_out = (first < num_out)? std::min(group_size, num_out - first) : 0;
+            process_group(group
+             , in_channels{ group_in? in + first : in, group_in, frames }
+             , out_channels{ group_out? out + first : out, group_out, frames }
+            );
+         }
+      );
+   }
+
+   void processor::end_block()
+   {
+      // Changes applied from here on belong to the next block
+      _parameters.clear_changed();
+
+      // Apply the events not consumed by for_each_segment
+      for (; _events_consumed != _parameter_events.size(); ++_events_consumed)
+      {
+         parameter_change(_parameter_events[_events_consumed]);
+      }
+      _parameter_events.clear();
+      _events_consumed = 0;
+
+      // Dispatch the MIDI messages not consumed by for_each_segment
+      for (; _midi_consumed != _midi_events.size(); ++_midi_consumed)
+         dispatch_midi(_midi_events[_midi_consumed]);
+      _midi_events.clear();
+      _midi_consumed = 0;
+
+      if (auto sps_ = sps())
+      {
+         std::chrono::duration<double> elapsed = clock::now() - _block_start;
+         _load.record(elapsed.count(), double(_block_frames) / sps_);
+      }
+   }
 }
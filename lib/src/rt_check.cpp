@@ -0,0 +1,469 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if defined(QPLUG_RT_CHECK) && defined(__linux__)
+
+// The fortified versions of open and friends are inline wrappers that we
+// cannot replace.
+#undef _FORTIFY_SOURCE
+
+#include <qplug/rt_check.hpp>
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Replacements for the C library functions that are not realtime safe. They
+// forward to the real functions (found with dlsym(RTLD_NEXT)) after
+// recording a violation if the calling thread is inside an rt_check::scope.
+//
+// Recording must not allocate: the records are kept in a fixed table, and
+// the thread is flagged while recording so that calls made by backtrace
+// itself are not recorded.
+///////////////////////////////////////////////////////////////////////////////
+namespace cycfi::qplug::rt_check
+{
+   namespace
+   {
+      enum kind { allocation, lock, file_io };
+
+      char const* kind_name(kind k)
+      {
+         switch (k)
+         {
+            case allocation:  return "allocation";
+            case lock:        return "lock";
+            default:          return "file I/O";
+         }
+      }
+
+      constexpr int max_frames = 32;
+      constexpr std::size_t max_records = 256;
+
+      struct record
+      {
+         kind                       what_kind;
+         char const*                what;
+         char const*                where;
+         void*                      frames[max_frames];
+         int                        num_frames;
+         std::size_t                count;
+      };
+
+      // Trivial types with the initial-exec model: accessing them never
+      // allocates, even the first time.
+      __attribute__((tls_model("initial-exec")))
+      thread_local char const*      current_scope = nullptr;
+
+      __attribute__((tls_model("initial-exec")))
+      thread_local bool             recording = false;
+
+      record                        records[max_records];
+      std::size_t                   num_records = 0;
+      std::size_t                   dropped = 0;
+      std::atomic<std::size_t>      total{ 0 };
+      std::atomic_flag              records_lock = ATOMIC_FLAG_INIT;
+
+      void record_violation(kind k, char const* what)
+      {
+         recording = true;
+         total.fetch_add(1, std::memory_order_relaxed);
+
+         void* frames[max_frames];
+         int num_frames = backtrace(frames, max_frames);
+
+         while (records_lock.test_and_set(std::memory_order_acquire))
+            ;
+
+         // Count repeated violations (same call, same stack) only once
+         std::size_t i = 0;
+         for (; i != num_records; ++i)
+         {
+            auto& r = records[i];
+            if (r.what == what && r.where == current_scope && r.num_frames == num_frames
+               && std::memcmp(r.frames, frames, num_frames * sizeof(void*)) == 0)
+            {
+               ++r.count;
+               break;
+            }
+         }
+
+         if (i == num_records)
+         {
+            if (num_records != max_records)
+            {
+               auto& r = records[num_records++];
+               r.what_kind = k;
+               r.what = what;
+               r.where = current_scope;
+               std::memcpy(r.frames, frames, num_frames * sizeof(void*));
+               r.num_frames = num_frames;
+               r.count = 1;
+            }
+            else
+            {
+               ++dropped;
+            }
+         }
+
+         records_lock.clear(std::memory_order_release);
+         recording = false;
+      }
+
+      inline void check(kind k, char const* what)
+      {
+         if (current_scope && !recording)
+            record_violation(k, what);
+      }
+   }
+
+   scope::scope(char const* where)
+    : _outer(current_scope)
+   {
+      current_scope = where;
+   }
+
+   scope::~scope()
+   {
+      current_scope = _outer;
+   }
+
+   char const* current()
+   {
+      return current_scope;
+   }
+
+   std::size_t violations()
+   {
+      return total.load(std::memory_order_relaxed);
+   }
+
+   void print_report(std::FILE* out)
+   {
+      auto n = violations();
+      std::fprintf(out, "Realtime safety violations: %zu\n", n);
+      if (n == 0)
+         return;
+
+      std::fflush(out);
+      while (records_lock.test_and_set(std::memory_order_acquire))
+         ;
+      for (std::size_t i = 0; i != num_records; ++i)
+      {
+         auto const& r = records[i];
+         std::fprintf(out, "\n%zu x %s (%s) in %s:\n",
+            r.count, kind_name(r.what_kind), r.what, r.where);
+         std::fflush(out);
+
+         // backtrace_symbols_fd does not allocate. Skip our own frames.
+         auto skip = (r.num_frames > 2)? 2 : 0;
+         backtrace_symbols_fd(r.frames + skip, r.num_frames - skip, fileno(out));
+      }
+      if (dropped)
+         std::fprintf(out, "\n%zu more distinct violations not recorded\n", dropped);
+      records_lock.clear(std::memory_order_release);
+   }
+
+   void reset()
+   {
+      while (records_lock.test_and_set(std::memory_order_acquire))
+         ;
+      num_records = 0;
+      dropped = 0;
+      total = 0;
+      records_lock.clear(std::memory_order_release);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// The replacements
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   namespace rt = cycfi::qplug::rt_check;
+
+   using malloc_function = void*(*)(size_t);
+   using calloc_function = void*(*)(size_t, size_t);
+   using realloc_function = void*(*)(void*, size_t);
+   using free_function = void(*)(void*);
+   using posix_memalign_function = int(*)(void**, size_t, size_t);
+   using aligned_alloc_function = void*(*)(size_t, size_t);
+   using mutex_lock_function = int(*)(pthread_mutex_t*);
+   using open_function = int(*)(char const*, int, ...);
+   using openat_function = int(*)(int, char const*, int, ...);
+   using close_function = int(*)(int);
+   using read_function = ssize_t(*)(int, void*, size_t);
+   using write_function = ssize_t(*)(int, void const*, size_t);
+   using fopen_function = FILE*(*)(char const*, char const*);
+   using fclose_function = int(*)(FILE*);
+   using fread_function = size_t(*)(void*, size_t, size_t, FILE*);
+   using fwrite_function = size_t(*)(void const*, size_t, size_t, FILE*);
+
+   struct real_functions
+   {
+      malloc_function            malloc;
+      calloc_function            calloc;
+      realloc_function           realloc;
+      free_function              free;
+      posix_memalign_function    posix_memalign;
+      aligned_alloc_function     aligned_alloc;
+      mutex_lock_function        pthread_mutex_lock;
+      open_function              open;
+      open_function              open64;
+      openat_function            openat;
+      close_function             close;
+      read_function              read;
+      write_function             write;
+      fopen_function             fopen;
+      fopen_function             fopen64;
+      fclose_function            fclose;
+      fread_function             fread;
+      fwrite_function            fwrite;
+   };
+
+   real_functions real = {};
+   bool resolving = false;
+
+   // dlsym may allocate. Allocations made while resolving come from here.
+   alignas(16) char bootstrap[4096];
+   size_t bootstrap_used = 0;
+
+   void* bootstrap_alloc(size_t size)
+   {
+      size = (size + 15) & ~size_t(15);
+      if (bootstrap_used + size > sizeof(bootstrap))
+         return nullptr;
+      auto p = bootstrap + bootstrap_used;
+      bootstrap_used += size;
+      return p;
+   }
+
+   bool is_bootstrap(void* p)
+   {
+      return p >= bootstrap && p < bootstrap + sizeof(bootstrap);
+   }
+
+   template <typename F>
+   void resolve(F& f, char const* name)
+   {
+      f = reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+   }
+
+   void resolve_all()
+   {
+      resolving = true;
+      resolve(real.malloc, "malloc");
+      resolve(real.calloc, "calloc");
+      resolve(real.realloc, "realloc");
+      resolve(real.free, "free");
+      resolve(real.posix_memalign, "posix_memalign");
+      resolve(real.aligned_alloc, "aligned_alloc");
+      resolve(real.pthread_mutex_lock, "pthread_mutex_lock");
+      resolve(real.open, "open");
+      resolve(real.open64, "open64");
+      resolve(real.openat, "openat");
+      resolve(real.close, "close");
+      resolve(real.read, "read");
+      resolve(real.write, "write");
+      resolve(real.fopen, "fopen");
+      resolve(real.fopen64, "fopen64");
+      resolve(real.fclose, "fclose");
+      resolve(real.fread, "fread");
+      resolve(real.fwrite, "fwrite");
+      resolving = false;
+   }
+
+   inline void ensure_resolved()
+   {
+      if (!real.malloc && !resolving)
+         resolve_all();
+   }
+
+   // The first backtrace loads libgcc_s, which allocates. Get it out of the
+   // way before anyone enters a scope.
+   struct warm_up
+   {
+      warm_up()
+      {
+         ensure_resolved();
+         void* frames[2];
+         backtrace(frames, 2);
+      }
+   };
+
+   warm_up const warm_up_;
+
+   mode_t open_mode(int flags, va_list args)
+   {
+      return (flags & (O_CREAT | O_TMPFILE))? mode_t(va_arg(args, int)) : 0;
+   }
+}
+
+extern "C"
+{
+   void* malloc(size_t size) noexcept
+   {
+      if (resolving)
+         return bootstrap_alloc(size);
+      ensure_resolved();
+      rt::check(rt::allocation, "malloc");
+      return real.malloc(size);
+   }
+
+   void* calloc(size_t n, size_t size) noexcept
+   {
+      if (resolving)
+         return bootstrap_alloc(n * size);   // The bootstrap buffer is zeroed
+      ensure_resolved();
+      rt::check(rt::allocation, "calloc");
+      return real.calloc(n, size);
+   }
+
+   void* realloc(void* p, size_t size) noexcept
+   {
+      if (resolving)
+         return nullptr;
+      ensure_resolved();
+      rt::check(rt::allocation, "realloc");
+      if (is_bootstrap(p))
+      {
+         auto q = real.malloc(size);
+         if (q)
+            std::memcpy(q, p, size);   // The bootstrap buffer outlives this
+         return q;
+      }
+      return real.realloc(p, size);
+   }
+
+   void free(void* p) noexcept
+   {
+      if (!p || is_bootstrap(p))
+         return;
+      ensure_resolved();
+      rt::check(rt::allocation, "free");
+      real.free(p);
+   }
+
+   int posix_memalign(void** p, size_t alignment, size_t size) noexcept
+   {
+      ensure_resolved();
+      rt::check(rt::allocation, "posix_memalign");
+      return real.posix_memalign(p, alignment, size);
+   }
+
+   void* aligned_alloc(size_t alignment, size_t size) noexcept
+   {
+      ensure_resolved();
+      rt::check(rt::allocation, "aligned_alloc");
+      return real.aligned_alloc(alignment, size);
+   }
+
+   int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+   {
+      ensure_resolved();
+      rt::check(rt::lock, "pthread_mutex_lock");
+      return real.pthread_mutex_lock(mutex);
+   }
+
+   int open(char const* path, int flags, ...)
+   {
+      va_list args;
+      va_start(args, flags);
+      auto mode = open_mode(flags, args);
+      va_end(args);
+      ensure_resolved();
+      rt::check(rt::file_io, "open");
+      return real.open(path, flags, mode);
+   }
+
+   int open64(char const* path, int flags, ...)
+   {
+      va_list args;
+      va_start(args, flags);
+      auto mode = open_mode(flags, args);
+      va_end(args);
+      ensure_resolved();
+      rt::check(rt::file_io, "open64");
+      return real.open64(path, flags, mode);
+   }
+
+   int openat(int dir, char const* path, int flags, ...)
+   {
+      va_list args;
+      va_start(args, flags);
+      auto mode = open_mode(flags, args);
+      va_end(args);
+      ensure_resolved();
+      rt::check(rt::file_io, "openat");
+      return real.openat(dir, path, flags, mode);
+   }
+
+   int close(int fd)
+   {
+      ensure_resolved();
+      rt::check(rt::file_io, "close");
+      return real.close(fd);
+   }
+
+   ssize_t read(int fd, void* buff, size_t size)
+   {
+      ensure_resolved();
+      rt::check(rt::file_io, "read");
+      return real.read(fd, buff, size);
+   }
+
+   ssize_t write(int fd, void const* buff, size_t size)
+   {
+      ensure_resolved();
+      rt::check(rt::file_io, "write");
+      return real.write(fd, buff, size);
+   }
+
+   FILE* fopen(char const* path, char const* mode)
+   {
+      ensure_resolved();
+      rt::check(rt::file_io, "fopen");
+      return real.fopen(path, mode);
+   }
+
+   FILE* fopen64(char const* path, char const* mode)
+   {
+      ensure_resolved();
+      rt::check(rt::file_io, "fopen64");
+      return real.fopen64(path, mode);
+   }
+
+   int fclose(FILE* file)
+   {
+      ensure_resolved();
+      rt::check(rt::file_io, "fclose");
+      return real.fclose(file);
+   }
+
+   size_t fread(void* buff, size_t size, size_t n, FILE* file)
+   {
+      ensure_resolved();
+      rt::check(rt::file_io, "fread");
+      return real.fread(buff, size, n, file);
+   }
+
+   size_t fwrite(void const* buff, size_t size, size_t n, FILE* file)
+   {
+      ensure_resolved();
+      rt::check(rt::file_io, "fwrite");
+      return real.fwrite(buff, size, n, file);
+   }
+}
+
+#endif
@@ -0,0 +1,146 @@
+/*=============================================================================
+   Copyright (c) 2019 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <qplug/worker_pool.hpp>
+#include <qplug/rt_check.hpp>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+# include <immintrin.h>
+#endif
+
+namespace cycfi::qplug
+{
+   namespace
+   {
+      inline void pause()
+      {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+         _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+         asm volatile("yield");
+#endif
+      }
+
+      // How long idle workers spin (roughly tens of microseconds) before
+      // going to sleep, and how long they sleep before checking again.
+      constexpr int spin_count = 20000;
+      constexpr auto sleep_time = std::chrono::milliseconds(1);
+
+      constexpr std::uint32_t generation_of(std::uint64_t jobs)
+      {
+         return std::uint32_t(jobs >> 32);
+      }
+   }
+
+   std::size_t worker_pool::default_size()
+   {
+      auto n = std::thread::hardware_concurrency();
+      return (n > 1)? n - 1 : 0;
+   }
+
+   worker_pool::worker_pool(std::size_t num_workers)
+   {
+      _workers.reserve(num_workers);
+      for (std::size_t i = 0; i != num_workers; ++i)
+         _workers.emplace_back([this]{ worker(); });
+   }
+
+   worker_pool::~worker_pool()
+   {
+      {
+         std::lock_guard<std::mutex> lock(_mutex);
+         _stop = true;
+      }
+      _wakeup.notify_all();
+      for (auto& t : _workers)
+         t.join();
+   }
+
+   void worker_pool::run(std::size_t n, job_function f, void* context)
+   {
+      if (_workers.empty() || n < 2)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+            f(context, i);
+         return;
+      }
+
+      // Publish the batch, then start a new generation. The release store
+      // makes the batch visible to workers that see the new generation.
+      _num_jobs.store(n, std::memory_order_relaxed);
+      _function.store(f, std::memory_order_relaxed);
+      _context.store(context, std::memory_order_relaxed);
+      _done.store(0, std::memory_order_relaxed);
+      _scope.store(rt_check::current(), std::memory_order_relaxed);
+      auto generation = generation_of(_jobs.load(std::memory_order_relaxed)) + 1;
+      _jobs.store(std::uint64_t(generation) << 32, std::memory_order_release);
+
+      if (_sleeping.load(std::memory_order_acquire) != 0)
+         _wakeup.notify_all();
+
+      // Help, then wait for the jobs claimed by the workers
+      work(generation);
+      while (_done.load(std::memory_order_acquire) != n)
+         pause();
+   }
+
+   void worker_pool::work(std::uint32_t generation)
+   {
+      auto jobs = _jobs.load(std::memory_order_acquire);
+      while (generation_of(jobs) == generation)
+      {
+         auto i = std::size_t(jobs & 0xffffffff);
+         if (i >= _num_jobs.load(std::memory_order_relaxed))
+            break;
+
+         // Claim job i. This fails if another thread claimed it first or
+         // if a new generation started, in which case we try again.
+         if (_jobs.compare_exchange_weak(jobs, jobs + 1,
+            std::memory_order_acq_rel, std::memory_order_acquire))
+         {
+            _function.load(std::memory_order_relaxed)(
+               _context.load(std::memory_order_relaxed), i);
+            _done.fetch_add(1, std::memory_order_release);
+            jobs = _jobs.load(std::memory_order_acquire);
+         }
+      }
+   }
+
+   void worker_pool::worker()
+   {
+      std::uint32_t seen = 0;
+      int spins = 0;
+      while (!_stop.load(std::memory_order_relaxed))
+      {
+         auto generation = generation_of(_jobs.load(std::memory_order_acquire));
+         if (generation != seen)
+         {
+            seen = generation;
+            rt_check::scope rt{ _scope.load(std::memory_order_relaxed) };
+            work(generation);
+            spins = 0;
+         }
+         else if (spins++ < spin_count)
+         {
+            pause();
+         }
+         else
+         {
+            std::unique_lock<std::mutex> lock(_mutex);
+            ++_sleeping;
+            _wakeup.wait_for(lock, sleep_time,
+               [&]
+               {
+                  return _stop.load(std::memory_order_relaxed)
+                     || generation_of(_jobs.load(std::memory_order_acquire)) != seen;
+               }
+            );
+            --_sleeping;
+            spins = 0;
+         }
+      }
+   }
+}
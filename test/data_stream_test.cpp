@@ -0,0 +1,165 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/data_stream.hpp>
+
+using namespace cycfi::qplug;
+
+namespace
+{
+   // Counts the writes and the bytes reserved
+   struct counting_ostream : ostream
+   {
+      ostream& write(char const* s, std::size_t size) override
+      {
+         ++_writes;
+         _buff.insert(_buff.end(), s, s + size);
+         return *this;
+      }
+
+      void reserve(std::size_t size) override
+      {
+         _reserved += size;
+         _buff.reserve(_buff.size() + size);
+      }
+
+      std::vector<char> _buff;
+      std::size_t       _writes = 0;
+      std::size_t       _reserved = 0;
+   };
+
+   struct vector_istream : istream
+   {
+      vector_istream(std::vector<char> const& buff)
+       : _buff(buff)
+      {}
+
+      char const* data() const override { return _buff.data(); }
+      std::size_t size() const override { return _buff.size(); }
+
+      std::vector<char> const& _buff;
+   };
+}
+
+TEST_CASE("test_data_stream_values_and_strings")
+{
+   counting_ostream out;
+   out << 42 << 0.5 << true << "hello" << std::string{ "world" }
+      << std::string_view{ "view" } << std::uint64_t(1) << "";
+
+   vector_istream in{ out._buff };
+   int i = 0;
+   double d = 0;
+   bool b = false;
+   std::string s1, s2;
+   std::string_view v1, v2;
+   std::uint64_t u = 0;
+   in >> i >> d >> b >> s1 >> s2;
+   in.read_view(v1) >> u;
+   in.read_view(v2);
+
+   CHECK(in.good());
+   CHECK(i == 42);
+   CHECK(d == 0.5);
+   CHECK(b);
+   CHECK(s1 == "hello");
+   CHECK(s2 == "world");
+   CHECK(v1 == "view");
+   CHECK(u == 1);
+   CHECK(v2.empty());
+   CHECK(in.remaining() == 0);
+
+   // The views point into the data
+   CHECK(v1.data() > out._buff.data());
+   CHECK(v1.data() < out._buff.data() + out._buff.size());
+}
+
+TEST_CASE("test_data_stream_arrays")
+{
+   std::vector<float> table(1000);
+   for (std::size_t i = 0; i != table.size(); ++i)
+      table[i] = i * 0.25f;
+
+   counting_ostream out;
+   out << 'x';   // Misalign what follows
+   out.write_array(table);
+   out.write_array(table.data(), 10);
+   out << 7;
+
+   // One write for the count and one for all the elements
+   CHECK(out._writes == 6);
+   CHECK(out._reserved >= 1004 * sizeof(float));
+
+   vector_istream in{ out._buff };
+   char c = 0;
+   std::vector<float> copy;
+   std::string_view bytes;
+   int last = 0;
+   in >> c;
+   in.read_array(copy);
+   in.read_array_view<float>(bytes);
+   in >> last;
+
+   CHECK(in.good());
+   CHECK(c == 'x');
+   CHECK(copy == table);
+   REQUIRE(bytes.size() == 10 * sizeof(float));
+   CHECK(std::memcmp(bytes.data(), table.data(), bytes.size()) == 0);
+   CHECK(last == 7);
+}
+
+TEST_CASE("test_data_stream_vector_growth")
+{
+   // Many small writes reallocate only a few times
+   std::vector<char> buff;
+   vector_ostream out{ buff };
+   std::size_t reallocations = 0;
+   for (int i = 0; i != 10000; ++i)
+   {
+      auto capacity = buff.capacity();
+      out << std::string_view{ "abc" };
+      out.write_array(&i, 1);
+      reallocations += buff.capacity() != capacity;
+   }
+   CHECK(buff.size() == 10000 * (4 + 2 * sizeof(int)));
+   CHECK(reallocations < 32);
+}
+
+TEST_CASE("test_data_stream_truncated")
+{
+   counting_ostream out;
+   out.write_array(std::vector<double>(100, 1.0));
+   out << "unterminated";
+   out._buff.pop_back();
+
+   // Array past the end
+   {
+      auto data = out._buff;
+      data.resize(sizeof(std::uint32_t) + 50 * sizeof(double));
+      vector_istream in{ data };
+      std::vector<double> v;
+      in.read_array(v);
+      CHECK(!in.good());
+      CHECK(v.empty());
+   }
+
+   // String without its terminator
+   {
+      vector_istream in{ out._buff };
+      std::vector<double> v;
+      std::string s;
+      in.read_array(v) >> s;
+      CHECK(v.size() == 100);
+      CHECK(!in.good());
+      CHECK(s.empty());
+
+      // Reads after a failure fail
+      int i = 1;
+      in >> i;
+      CHECK(i == 0);
+   }
+}
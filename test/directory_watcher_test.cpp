@@ -0,0 +1,102 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/directory_watcher.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+using namespace cycfi::qplug;
+namespace fs = cycfi::fs;
+using namespace std::chrono_literals;
+
+namespace
+{
+   fs::path test_dir()
+   {
+      return fs::temp_directory_path() / "directory_watcher_test";
+   }
+
+   // Wait until count is at least n, for up to 5s
+   bool wait_for(std::atomic<int> const& count, int n)
+   {
+      auto until = std::chrono::steady_clock::now() + 5s;
+      while (count < n)
+      {
+         if (std::chrono::steady_clock::now() > until)
+            return false;
+         std::this_thread::sleep_for(1ms);
+      }
+      return true;
+   }
+
+   void write(fs::path const& path, char const* text)
+   {
+      std::ofstream file(path, std::ios::app);
+      file << text;
+   }
+
+   void test_watcher(directory_watcher::mode mode_)
+   {
+      fs::remove_all(test_dir());
+      fs::create_directories(test_dir());
+      std::atomic<int> changes{ 0 };
+      {
+         directory_watcher watcher{
+            test_dir(), { "watched.txt" }, [&] { ++changes; }
+          , mode_, 20ms
+         };
+         if (mode_ == directory_watcher::poll)
+            CHECK(watcher.is_polling());
+
+         // Other files are not watched
+         write(test_dir() / "other.txt", "1");
+         std::this_thread::sleep_for(100ms);
+         CHECK(changes == 0);
+
+         // Created
+         write(test_dir() / "watched.txt", "1");
+         CHECK(wait_for(changes, 1));
+
+         // Appended to. (Make sure the size changes: the time may not,
+         // for the poller.)
+         auto n = int(changes);
+         write(test_dir() / "watched.txt", "22");
+         CHECK(wait_for(changes, n + 1));
+
+         // Replaced
+         n = changes;
+         write(test_dir() / "watched.tmp", "333333");
+         fs::rename(test_dir() / "watched.tmp", test_dir() / "watched.txt");
+         CHECK(wait_for(changes, n + 1));
+
+         // Deleted
+         n = changes;
+         fs::remove(test_dir() / "watched.txt");
+         CHECK(wait_for(changes, n + 1));
+      }
+
+      // Stopped
+      auto n = int(changes);
+      write(test_dir() / "watched.txt", "1");
+      std::this_thread::sleep_for(100ms);
+      CHECK(changes == n);
+      fs::remove_all(test_dir());
+   }
+}
+
+TEST_CASE("test_directory_watcher_notify")
+{
+   test_watcher(directory_watcher::notify);
+}
+
+TEST_CASE("test_directory_watcher_poll")
+{
+   test_watcher(directory_watcher::poll);
+}
@@ -0,0 +1,41 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/event_queue.hpp>
+
+using namespace cycfi::qplug;
+
+TEST_CASE("test_event_queue_order")
+{
+   parameter_event_queue q{ 8 };
+   REQUIRE(q.empty());
+
+   REQUIRE(q.push({ 10, 0, 0.1 }));
+   REQUIRE(q.push({ 2, 1, 0.2 }));
+   REQUIRE(q.push({ 10, 2, 0.3 }));
+   REQUIRE(q.push({ 0, 3, 0.4 }));
+   REQUIRE(q.size() == 4);
+
+   // Sorted by frame, equal frames keep their arrival order
+   CHECK(q[0].id == 3);
+   CHECK(q[1].id == 1);
+   CHECK(q[2].id == 0);
+   CHECK(q[3].id == 2);
+
+   q.clear();
+   REQUIRE(q.empty());
+}
+
+TEST_CASE("test_event_queue_full")
+{
+   parameter_event_queue q{ 2 };
+   REQUIRE(q.push({ 0, 0, 0.0 }));
+   REQUIRE(q.push({ 1, 0, 1.0 }));
+   REQUIRE(q.full());
+   REQUIRE(!q.push({ 2, 0, 2.0 }));
+   REQUIRE(q.size() == 2);
+}
@@ -0,0 +1,163 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <infra/filesystem.hpp>
+#include <elements/support/resource_paths.hpp>
+#include <qplug/factory_presets.hpp>
+#include "headless/headless_plugin.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+namespace fs = cycfi::fs;
+
+namespace
+{
+   qplug::parameter params[] =
+   {
+      qplug::parameter{ "Gain", 0.5 }.range(0, 2)
+    , qplug::parameter{ "Bypass", false }
+    , qplug::parameter{ "Voices", 1 }.range(1, 8)
+   };
+
+   struct test_controller : qplug::controller
+   {
+      using controller::controller;
+
+      parameter_list parameters() const override
+      {
+         return { std::begin(params), std::end(params) };
+      }
+   };
+
+   struct test_processor : qplug::processor
+   {
+      using processor::processor;
+      void process(in_channels const& in, out_channels const& out) override {}
+   };
+
+   fs::path test_dir()
+   {
+      return fs::temp_directory_path() / "factory_presets_test";
+   }
+
+   // A table, as the presets tool writes it from:
+   //
+   //    {
+   //      "Loud" : { "Gain" : 1.75, "Voices" : 4 },
+   //      "Quiet" : { "Gain" : 0.25, "Bypass" : true }
+   //    }
+   constexpr qplug::factory_preset_value preset_0[] =
+   {
+      { 0, 1.75 }
+    , { 2, 4 }
+   };
+
+   constexpr qplug::factory_preset_value preset_1[] =
+   {
+      { 0, 0.25 }
+    , { 1, 1 }
+   };
+
+   constexpr qplug::factory_preset presets[] =
+   {
+      { "Loud", preset_0, 2 }
+    , { "Quiet", preset_1, 2 }
+   };
+
+   constexpr qplug::factory_preset_table table =
+      { presets, 2, 3 };
+
+   bool const registered = qplug::register_factory_presets(table);
+}
+
+namespace cycfi::qplug
+{
+   controller_ptr make_controller(base_controller& base)
+   {
+      return std::make_unique<test_controller>(base);
+   }
+
+   processor_ptr make_processor(base_processor& base)
+   {
+      return std::make_unique<test_processor>(base);
+   }
+}
+
+TEST_CASE("test_write_factory_presets")
+{
+   std::string json =
+      "{\n"
+      "  \"Loud\" : { \"Gain\" : 1.75, \"Voices\" : 4 },\n"
+      "  \"Quiet\" : { \"Gain\" : 0.25, \"Bypass\" : true },\n"
+      "  \"Say \\\"Hi\\\"\" : {}\n"
+      "}\n"
+      ;
+
+   std::ostringstream out, err;
+   REQUIRE(qplug::write_factory_presets(json, params, out, err));
+   auto src = out.str();
+
+   // Sorted by name, with the values by parameter index
+   CHECK(src.find("{ \"Loud\", preset_0, 2 }") != std::string::npos);
+   CHECK(src.find("{ \"Quiet\", preset_1, 2 }") != std::string::npos);
+   CHECK(src.find("{ 0, 1.75 }\n       , { 2, 4 }") != std::string::npos);
+   CHECK(src.find("{ 0, 0.25 }\n       , { 1, 1 }") != std::string::npos);
+
+   // Names are kept as they are in the JSON, escaped for C++
+   CHECK(src.find("{ \"Say \\\\\\\"Hi\\\\\\\"\", nullptr, 0 }") != std::string::npos);
+   CHECK(src.find("{ presets, 3, 3 }") != std::string::npos);
+   CHECK(err.str().empty());
+}
+
+TEST_CASE("test_write_factory_presets_invalid")
+{
+   // A parameter the plugin does not have fails the build
+   std::ostringstream out, err;
+   std::string json = "{ \"Loud\" : { \"Gain\" : 1.75, \"Volume\" : 4 } }";
+   CHECK(!qplug::write_factory_presets(json, params, out, err));
+   CHECK(err.str().find("\"Loud\"") != std::string::npos);
+
+   // No presets is fine
+   std::ostringstream empty;
+   CHECK(qplug::write_factory_presets("{}", params, empty, err));
+   CHECK(empty.str().find("{ nullptr, 0, 3 }") != std::string::npos);
+}
+
+TEST_CASE("test_compiled_factory_presets")
+{
+   REQUIRE(registered);
+   REQUIRE(qplug::compiled_factory_presets() == &table);
+
+   // A factory_presets.json on the search path is not used (or read)
+   fs::remove_all(test_dir());
+   fs::create_directories(test_dir());
+   {
+      std::ofstream file(test_dir() / "factory_presets.json");
+      file << "{ \"From File\" : { \"Gain\" : 2 } }\n";
+   }
+   setenv("XDG_DATA_HOME", test_dir().c_str(), 1);
+   cycfi::elements::add_search_path(test_dir());
+
+   headless_plugin plugin;
+   auto& controller = plugin.controller();
+   CHECK(controller.load_all_presets());
+   CHECK(controller.has_factory_preset("Loud"));
+   CHECK(controller.has_factory_preset("Quiet"));
+   CHECK(!controller.has_factory_preset("From File"));
+
+   CHECK(controller.load_preset("Loud"));
+   CHECK(plugin.get_parameter(0) == Approx(1.75));
+   CHECK(plugin.get_parameter(2) == 4);
+
+   CHECK(controller.load_preset("Quiet"));
+   CHECK(plugin.get_parameter(0) == Approx(0.25));
+   CHECK(plugin.get_parameter(1) == 1);
+}
@@ -0,0 +1,164 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/kernels.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace cycfi::qplug;
+
+namespace
+{
+   // Odd sizes exercise the scalar tails of the vector loops
+   constexpr std::size_t sizes[] = { 0, 1, 3, 7, 16, 17, 31, 64, 100, 1023 };
+
+   std::vector<float> noise(std::size_t n, unsigned seed)
+   {
+      std::mt19937 gen{ seed };
+      std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+      std::vector<float> v(n);
+      for (auto& x : v)
+         x = dist(gen);
+      return v;
+   }
+
+   std::vector<kernel_table const*> supported_tables()
+   {
+      std::vector<kernel_table const*> tables;
+      for (auto isa : { kernel_isa::scalar, kernel_isa::sse2
+         , kernel_isa::avx2, kernel_isa::avx512, kernel_isa::neon })
+      {
+         if (auto table = kernel_table_for(isa))
+            tables.push_back(table);
+      }
+      return tables;
+   }
+}
+
+TEST_CASE("test_kernels_selected")
+{
+   REQUIRE(kernel_table_for(kernel_isa::scalar) != nullptr);
+   REQUIRE(kernel_table_for(active_kernel_isa()) != nullptr);
+   INFO("Active kernels: " << kernel_isa_name(active_kernel_isa()));
+}
+
+TEST_CASE("test_kernels_elementwise")
+{
+   for (auto table : supported_tables())
+   {
+      for (auto n : sizes)
+      {
+         auto in = noise(n, 1);
+         auto g = noise(n, 2);
+         std::vector<float> out(n, 1.0f), r(n, 1.0f);
+
+         table->clear(out.data(), n);
+         for (auto x : out)
+            REQUIRE(x == 0.0f);
+
+         table->copy(out.data(), in.data(), n);
+         REQUIRE(out == in);
+
+         table->gain(out.data(), in.data(), 0.5f, n);
+         for (std::size_t i = 0; i != n; ++i)
+            REQUIRE(out[i] == in[i] * 0.5f);
+
+         table->gain_buffer(out.data(), in.data(), g.data(), 0.01f, n);
+         for (std::size_t i = 0; i != n; ++i)
+            REQUIRE(out[i] == Approx(in[i] * g[i] * 0.01f));
+
+         table->gain_ramp(out.data(), in.data(), 0.0f, 1.0f, n);
+         for (std::size_t i = 0; i != n; ++i)
+            REQUIRE(out[i] == Approx(in[i] * (float(i + 1) / n)).margin(1e-6));
+
+         out = g;
+         table->mix(out.data(), in.data(), 0.25f, n);
+         for (std::size_t i = 0; i != n; ++i)
+            REQUIRE(out[i] == Approx(g[i] + in[i] * 0.25f).margin(1e-6));
+
+         table->pan(out.data(), r.data(), in.data(), 0.25f, 0.75f, n);
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            REQUIRE(out[i] == in[i] * 0.25f);
+            REQUIRE(r[i] == in[i] * 0.75f);
+         }
+      }
+   }
+}
+
+TEST_CASE("test_kernels_reductions")
+{
+   for (auto table : supported_tables())
+   {
+      for (auto n : sizes)
+      {
+         auto in = noise(n, 3);
+         float peak = 0.0f;
+         double sum = 0.0;
+         for (auto x : in)
+         {
+            peak = std::max(peak, std::abs(x));
+            sum += double(x) * x;
+         }
+         REQUIRE(table->peak(in.data(), n) == peak);
+         REQUIRE(table->sum_squares(in.data(), n) == Approx(sum).margin(1e-4));
+      }
+   }
+}
+
+TEST_CASE("test_kernels_interleave")
+{
+   for (auto table : supported_tables())
+   {
+      for (auto n : sizes)
+      {
+         auto left = noise(n, 4);
+         auto right = noise(n, 5);
+         std::vector<float> frames(2 * n);
+
+         table->interleave2(frames.data(), left.data(), right.data(), n);
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            REQUIRE(frames[2*i] == left[i]);
+            REQUIRE(frames[2*i + 1] == right[i]);
+         }
+
+         std::vector<float> l(n), r(n);
+         table->deinterleave2(l.data(), r.data(), frames.data(), n);
+         REQUIRE(l == left);
+         REQUIRE(r == right);
+      }
+   }
+}
+
+TEST_CASE("test_kernels_interleave_channels")
+{
+   constexpr std::size_t n = 37;
+   auto a = noise(n, 6), b = noise(n, 7), c = noise(n, 8);
+   float const* in[] = { a.data(), b.data(), c.data() };
+
+   std::vector<float> frames(3 * n);
+   kernels::interleave(frames.data(), in, 3, n);
+   for (std::size_t i = 0; i != n; ++i)
+   {
+      REQUIRE(frames[3*i] == a[i]);
+      REQUIRE(frames[3*i + 1] == b[i]);
+      REQUIRE(frames[3*i + 2] == c[i]);
+   }
+
+   std::vector<float> x(n), y(n), z(n);
+   float* out[] = { x.data(), y.data(), z.data() };
+   kernels::deinterleave(out, frames.data(), 3, n);
+   REQUIRE(x == a);
+   REQUIRE(y == b);
+   REQUIRE(z == c);
+
+   REQUIRE(kernels::rms(a.data(), 0) == 0.0f);
+   REQUIRE(kernels::peak(a.data(), n) > 0.0f);
+}
@@ -0,0 +1,90 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/load_meter.hpp>
+#include <thread>
+
+using namespace cycfi::qplug;
+
+TEST_CASE("test_load_meter_empty")
+{
+   load_meter meter;
+   auto s = meter.stats();
+   CHECK(s.blocks == 0);
+   CHECK(s.max == 0);
+   CHECK(meter.percentile(0.99) == 0);
+}
+
+TEST_CASE("test_load_meter_stats")
+{
+   load_meter meter;
+
+   // 100 blocks from 1% to 100% of a 1ms deadline
+   for (int i = 1; i <= 100; ++i)
+      meter.record(i * 1e-5, 1e-3);
+   meter.record(1.5e-3, 1e-3);   // 150%, an overrun
+   meter.record(3e-3, 1e-3);     // 300%, goes to the last bin
+
+   auto s = meter.stats();
+   CHECK(s.blocks == 102);
+   CHECK(s.overruns == 2);
+   CHECK(s.current == Approx(300));
+   CHECK(s.min == Approx(1));
+   CHECK(s.max == Approx(300));
+   CHECK(s.avg == Approx((5050 + 150 + 300) / 102.0).epsilon(0.001));
+
+   CHECK(meter.bin(0) == 0);
+   CHECK(meter.bin(1) == 1);
+   CHECK(meter.bin(150) == 1);
+   CHECK(meter.bin(load_meter::num_bins-1) == 1);
+
+   // p99 is 1% resolution, rounded up to the bin's upper edge
+   CHECK(s.p99 >= 100);
+   CHECK(s.p99 <= 151);
+   CHECK(meter.percentile(0.5) == Approx(52).margin(1));
+   CHECK(meter.percentile(1.0) == Approx(300));
+}
+
+TEST_CASE("test_load_meter_reset")
+{
+   load_meter meter;
+   meter.record(2e-3, 1e-3);
+   meter.reset();
+
+   // The reset happens on the next record
+   meter.record(5e-4, 1e-3);
+   auto s = meter.stats();
+   CHECK(s.blocks == 1);
+   CHECK(s.overruns == 0);
+   CHECK(s.min == Approx(50));
+   CHECK(s.max == Approx(50));
+   CHECK(meter.bin(load_meter::num_bins-1) == 0);
+}
+
+TEST_CASE("test_load_meter_concurrent_reader")
+{
+   load_meter meter;
+   constexpr int n = 100000;
+   std::thread writer{
+      [&]
+      {
+         for (int i = 0; i != n; ++i)
+            meter.record((i % 100) * 1e-5, 1e-3);
+      }
+   };
+
+   std::uint64_t last = 0;
+   while (last != n)
+   {
+      auto s = meter.stats();
+      REQUIRE(s.blocks >= last);
+      REQUIRE(s.max < 100);
+      last = s.blocks;
+   }
+   writer.join();
+   CHECK(meter.stats().avg == Approx(49.5).epsilon(0.01));
+}
@@ -0,0 +1,128 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/parameter_morph.hpp>
+#include <map>
+#include <thread>
+
+using namespace cycfi::qplug;
+
+namespace
+{
+   parameter params[] =
+   {
+      parameter{ "double", 0.0 }.range(0, 100)
+    , parameter{ "bool", false }
+    , parameter{ "int", 0 }.range(0, 10)
+    , parameter{ "same", 0.0 }
+   };
+
+   using values = std::map<int, double>;
+
+   // The values update gives, as a map
+   values update(parameter_morph& morph, std::size_t frames = 100)
+   {
+      values result;
+      morph.update(frames, 1000,
+         [&](int id, double value) { result[id] = value; });
+      return result;
+   }
+}
+
+TEST_CASE("test_parameter_morph_timed")
+{
+   parameter_morph morph;
+   morph.reset(params);
+   CHECK(update(morph).empty());
+
+   // 1000 sps: 1000ms is 10 blocks of 100 frames
+   morph.start({ 0.0, 0.0, 2.0, 1.0 }, { 100.0, 1.0, 8.0, 1.0 }, 1000, 0.25);
+   auto v = update(morph);
+   CHECK(morph.active());
+   CHECK(v == values{ { 0, 0.0 }, { 1, 0.0 }, { 2, 2.0 } });
+
+   v = update(morph);
+   CHECK(v[0] == Approx(10.0));
+   CHECK(v[1] == 0.0);
+
+   // bool and int switch at the switch point
+   update(morph);
+   v = update(morph);
+   CHECK(v[0] == Approx(30.0));
+   CHECK(v[1] == 1.0);
+   CHECK(v[2] == 8.0);
+
+   for (int i = 0; i != 6; ++i)
+      update(morph);
+   v = update(morph);
+   CHECK(v[0] == 100.0);
+   CHECK(!morph.active());
+   CHECK(update(morph).empty());
+}
+
+TEST_CASE("test_parameter_morph_position")
+{
+   parameter_morph morph;
+   morph.reset(params);
+   morph.start({ 0.0, 0.0, 2.0, 1.0 }, { 100.0, 1.0, 8.0, 1.0 }, 0);
+
+   auto v = update(morph);
+   CHECK(v[0] == 0.0);
+
+   // Nothing moves, nothing is updated
+   CHECK(update(morph).empty());
+
+   morph.position(0.75);
+   v = update(morph);
+   CHECK(v[0] == Approx(75.0));
+   CHECK(v[1] == 1.0);
+
+   // Clamped, and active until stopped
+   morph.position(2.0);
+   CHECK(update(morph)[0] == 100.0);
+   CHECK(morph.active());
+
+   morph.stop();
+   morph.position(0.0);
+   CHECK(update(morph).empty());
+   CHECK(!morph.active());
+}
+
+TEST_CASE("test_parameter_morph_concurrent")
+{
+   // The UI starts morphs while the audio thread updates. Each morph goes
+   // from -i to i, so the audio thread must see both move together.
+   constexpr int n = 5000;
+   parameter_morph morph;
+   morph.reset(params);
+   morph.position(1.0);
+
+   std::atomic<bool> done{ false };
+   std::thread ui{
+      [&]
+      {
+         for (int i = 1; i <= n; ++i)
+            morph.start({ -double(i), 0.0, 0.0, -double(i) }, { double(i), 0.0, 0.0, double(i) }, 0);
+         done = true;
+      }
+   };
+
+   while (!done)
+   {
+      auto v = update(morph);
+      if (!v.empty())
+      {
+         REQUIRE(v.size() == 2);
+         REQUIRE(v[0] == v[3]);
+      }
+   }
+   ui.join();
+
+   auto v = update(morph);
+   if (!v.empty())
+      CHECK(v[0] == n);
+}
@@ -0,0 +1,171 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/parameter_snapshot.hpp>
+#include <thread>
+
+using namespace cycfi::qplug;
+
+namespace
+{
+   void acquire(parameter_snapshot& snapshot)
+   {
+      snapshot.clear_changed();
+      snapshot.acquire(
+         [&](int id, double value) { snapshot.assign(id, value); });
+   }
+}
+
+TEST_CASE("test_parameter_snapshot_publish")
+{
+   parameter_snapshot snapshot;
+   snapshot.reset({ 0.0, 1.0, 2.0 });
+   REQUIRE(snapshot.size() == 3);
+   CHECK(snapshot[1] == 1.0);
+   CHECK(!snapshot.any_changed());
+
+   // Published values are not seen until acquired
+   snapshot.publish(2, 20.0);
+   snapshot.publish(0, 5.0);
+   snapshot.publish(0, 10.0);
+   CHECK(snapshot[0] == 0.0);
+
+   acquire(snapshot);
+   CHECK(snapshot[0] == 10.0);
+   CHECK(snapshot[1] == 1.0);
+   CHECK(snapshot[2] == 20.0);
+   CHECK(snapshot.changed(0));
+   CHECK(!snapshot.changed(1));
+   CHECK(snapshot.changed(2));
+   CHECK(!snapshot.changed(3));
+
+   std::vector<int> ids;
+   snapshot.for_each_changed([&](int id) { ids.push_back(id); });
+   CHECK(ids == std::vector<int>{ 0, 2 });
+
+   // Nothing published since
+   acquire(snapshot);
+   CHECK(!snapshot.any_changed());
+   CHECK(snapshot[0] == 10.0);
+
+   // Out of range ids are ignored
+   snapshot.publish(3, 1.0);
+   snapshot.publish(-1, 1.0);
+   acquire(snapshot);
+   CHECK(!snapshot.any_changed());
+}
+
+TEST_CASE("test_parameter_snapshot_many")
+{
+   parameter_snapshot snapshot;
+   snapshot.reset(std::vector<double>(200, 0.0));
+   for (int id = 0; id < 200; id += 3)
+      snapshot.publish(id, id);
+
+   acquire(snapshot);
+   std::vector<int> ids;
+   snapshot.for_each_changed([&](int id) { ids.push_back(id); });
+   REQUIRE(ids.size() == 67);
+   for (std::size_t i = 0; i != ids.size(); ++i)
+   {
+      CHECK(ids[i] == int(i * 3));
+      CHECK(snapshot[ids[i]] == ids[i]);
+   }
+}
+
+TEST_CASE("test_parameter_snapshot_concurrent")
+{
+   // Writers publish increasing values. The reader must see each value
+   // go up, never a torn or stale value, and eventually the last one. A
+   // value may be flagged twice (seen early, before its flag was set).
+   constexpr int num_params = 130;
+   constexpr int n = 20000;
+   parameter_snapshot snapshot;
+   snapshot.reset(std::vector<double>(num_params, -1.0));
+
+   auto writer = [&](int first)
+   {
+      for (int i = 0; i != n; ++i)
+         for (int id = first; id < num_params; id += 2)
+            snapshot.publish(id, i);
+   };
+
+   std::thread w1{ writer, 0 };
+   std::thread w2{ writer, 1 };
+
+   std::vector<double> last(num_params, -1.0);
+   bool done = false;
+   while (!done)
+   {
+      acquire(snapshot);
+      done = true;
+      for (int id = 0; id != num_params; ++id)
+      {
+         REQUIRE(snapshot[id] >= last[id]);
+         if (snapshot[id] != last[id])
+            REQUIRE(snapshot.changed(id));
+         last[id] = snapshot[id];
+         if (last[id] != n - 1)
+            done = false;
+      }
+   }
+   w1.join();
+   w2.join();
+}
+
+TEST_CASE("test_parameter_snapshot_batch")
+{
+   parameter_snapshot snapshot;
+   snapshot.reset({ 0.0, 1.0, 2.0 });
+
+   // Nothing is acquired while a batch is open, including values
+   // published outside of it
+   snapshot.begin_batch();
+   snapshot.publish(0, 10.0);
+   snapshot.publish(2, 20.0);
+   acquire(snapshot);
+   CHECK(!snapshot.any_changed());
+   CHECK(snapshot[0] == 0.0);
+
+   snapshot.publish(1, 11.0);
+   snapshot.end_batch();
+   acquire(snapshot);
+   CHECK(snapshot[0] == 10.0);
+   CHECK(snapshot[1] == 11.0);
+   CHECK(snapshot[2] == 20.0);
+}
+
+TEST_CASE("test_parameter_snapshot_batch_concurrent")
+{
+   // The writer publishes every parameter with the same value, in a batch.
+   // The reader must never see a mix of two batches.
+   constexpr int num_params = 500;
+   constexpr int n = 5000;
+   parameter_snapshot snapshot;
+   snapshot.reset(std::vector<double>(num_params, -1.0));
+
+   std::thread writer{
+      [&]
+      {
+         for (int i = 0; i != n; ++i)
+         {
+            snapshot.begin_batch();
+            for (int id = 0; id != num_params; ++id)
+               snapshot.publish(id, i);
+            snapshot.end_batch();
+         }
+      }
+   };
+
+   while (snapshot[0] != n - 1)
+   {
+      acquire(snapshot);
+      for (int id = 1; id != num_params; ++id)
+         REQUIRE(snapshot[id] == snapshot[0]);
+   }
+   writer.join();
+}
@@ -0,0 +1,118 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/persistent_map.hpp>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace cycfi::qplug;
+
+namespace
+{
+   using map_type = persistent_map<int, int>;
+   using entries = std::vector<std::pair<int, int>>;
+
+   entries get(map_type const& map)
+   {
+      entries r;
+      map.for_each([&](int key, int value) { r.emplace_back(key, value); });
+      return r;
+   }
+}
+
+TEST_CASE("test_persistent_map")
+{
+   map_type map;
+   CHECK(map.empty());
+   CHECK(map.find(1) == nullptr);
+
+   map.set(2, 20);
+   map.set(1, 10);
+   map.set(3, 30);
+   CHECK(map.size() == 3);
+   CHECK(*map.find(2) == 20);
+   CHECK(get(map) == entries{ { 1, 10 }, { 2, 20 }, { 3, 30 } });
+
+   // Replace
+   map.set(2, 21);
+   CHECK(map.size() == 3);
+   CHECK(*map.find(2) == 21);
+
+   // Erase
+   CHECK(map.erase(1));
+   CHECK(!map.erase(1));
+   CHECK(map.size() == 2);
+   CHECK(map.find(1) == nullptr);
+
+   map.clear();
+   CHECK(map.empty());
+   CHECK(map.size() == 0);
+}
+
+TEST_CASE("test_persistent_map_copies")
+{
+   // Changes to a map do not show in its copies
+   map_type map;
+   for (int i = 0; i != 100; ++i)
+      map.set(i, i);
+
+   auto copy = map;
+   map.set(50, -1);
+   map.erase(10);
+   map.set(200, 200);
+
+   CHECK(*copy.find(50) == 50);
+   CHECK(*copy.find(10) == 10);
+   CHECK(copy.find(200) == nullptr);
+   CHECK(copy.size() == 100);
+
+   CHECK(*map.find(50) == -1);
+   CHECK(map.find(10) == nullptr);
+   CHECK(map.size() == 100);
+}
+
+TEST_CASE("test_persistent_map_heterogeneous_find")
+{
+   std::vector<std::string> names = { "Lead", "Bass", "Pad" };
+   persistent_map<std::string_view, int> map;
+   for (std::size_t i = 0; i != names.size(); ++i)
+      map.set(names[i], int(i));
+
+   CHECK(*map.find("Bass") == 1);
+   CHECK(*map.find(std::string{ "Pad" }) == 2);
+   CHECK(map.find("Keys") == nullptr);
+}
+
+TEST_CASE("test_persistent_map_random")
+{
+   // Check against std::map
+   std::mt19937 rng{ 42 };
+   std::uniform_int_distribution<int> key{ 0, 500 };
+   map_type map;
+   std::map<int, int> expected;
+
+   for (int i = 0; i != 10000; ++i)
+   {
+      auto k = key(rng);
+      if (rng() % 3 == 0)
+      {
+         CHECK(map.erase(k) == (expected.erase(k) != 0));
+      }
+      else
+      {
+         map.set(k, i);
+         expected[k] = i;
+      }
+   }
+
+   CHECK(map.size() == expected.size());
+   CHECK(get(map) == entries(expected.begin(), expected.end()));
+}
@@ -0,0 +1,137 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/plugin_state.hpp>
+#include <qplug/data_stream.hpp>
+#include <map>
+
+using namespace cycfi::qplug;
+
+namespace
+{
+   struct vector_istream : istream
+   {
+      vector_istream(std::vector<char> const& buff)
+       : _buff(buff)
+      {}
+
+      char const* data() const override { return _buff.data(); }
+      std::size_t size() const override { return _buff.size(); }
+
+      std::vector<char> const& _buff;
+   };
+
+   using parameter_list = parameter_index::parameter_list;
+
+   parameter_list as_list(std::vector<parameter> const& params)
+   {
+      return { params.data(), params.data() + params.size() };
+   }
+
+   std::map<int, double> load(std::vector<char> const& buff, parameter_index const& index)
+   {
+      std::map<int, double> values;
+      vector_istream str{ buff };
+      bool ok = load_parameters(str, index,
+         [&](int id, double value) { values[id] = value; });
+      REQUIRE(ok);
+      return values;
+   }
+}
+
+TEST_CASE("test_parameter_index")
+{
+   std::vector<parameter> params = {
+      { "Gain", 1.0 }, { "Drive", 0.5 }, { "Tone", 0.5 }
+   };
+   parameter_index index{ as_list(params) };
+   REQUIRE(index.size() == 3);
+   CHECK(index.unique());
+   CHECK(index.find("Gain") == 0);
+   CHECK(index.find("Tone") == 2);
+   CHECK(index.find("Level") == -1);
+   CHECK(index.find(parameter_hash("Drive")) == 1);
+   CHECK(index.id(1) == parameter_hash("Drive"));
+
+   // Known FNV-1a values
+   CHECK(parameter_hash("") == 0xcbf29ce484222325);
+   CHECK(parameter_hash("a") == 0xaf63dc4c8601ec8c);
+}
+
+TEST_CASE("test_plugin_state_round_trip")
+{
+   std::vector<parameter> params = {
+      { "Gain", 1.0 }, { "Drive", 0.5 }, { "Tone", 0.5 }
+   };
+   parameter_index index{ as_list(params) };
+
+   std::vector<char> buff;
+   vector_ostream out{ buff };
+   save_parameters(out, index, [](int id) { return id * 10.0; });
+   out << 1234;   // The controller's state follows
+
+   std::map<int, double> values;
+   vector_istream in{ buff };
+   REQUIRE(load_parameters(in, index, [&](int id, double value) { values[id] = value; }));
+   CHECK(values == std::map<int, double>{ { 0, 0.0 }, { 1, 10.0 }, { 2, 20.0 } });
+
+   int controller_state = 0;
+   in >> controller_state;
+   CHECK(controller_state == 1234);
+}
+
+TEST_CASE("test_plugin_state_matched_by_name")
+{
+   // Save with one set of parameters, load into a newer version of the
+   // plugin that reordered them, removed one and added another.
+   std::vector<parameter> v1 = {
+      { "Gain", 1.0 }, { "Drive", 0.5 }, { "Tone", 0.5 }
+   };
+   std::vector<parameter> v2 = {
+      { "Tone", 0.5 }, { "Level", 0.5 }, { "Gain", 1.0 }
+   };
+
+   std::vector<char> buff;
+   vector_ostream out{ buff };
+   save_parameters(out, parameter_index{ as_list(v1) }, [](int id) { return id + 1.0; });
+
+   auto values = load(buff, parameter_index{ as_list(v2) });
+   CHECK(values == std::map<int, double>{ { 0, 3.0 }, { 2, 1.0 } });
+}
+
+TEST_CASE("test_plugin_state_legacy")
+{
+   std::vector<parameter> params = {
+      { "Gain", 1.0 }, { "Drive", 0.5 }, { "Tone", 0.5 }
+   };
+   parameter_index index{ as_list(params) };
+
+   // The format written by earlier versions
+   std::vector<char> buff;
+   vector_ostream out{ buff };
+   out << 3;
+   out << "Tone" << 0.25;
+   out << "Unknown" << 0.5;
+   out << "Gain" << 0.75;
+
+   auto values = load(buff, index);
+   CHECK(values == std::map<int, double>{ { 0, 0.75 }, { 2, 0.25 } });
+}
+
+TEST_CASE("test_plugin_state_newer_version")
+{
+   std::vector<parameter> params = { { "Gain", 1.0 } };
+   parameter_index index{ as_list(params) };
+
+   std::vector<char> buff;
+   vector_ostream out{ buff };
+   out << state_magic << (state_version + 1) << std::uint32_t(1);
+   out << parameter_hash("Gain") << 0.5;
+
+   vector_istream in{ buff };
+   CHECK(!load_parameters(in, index, [](int, double) {}));
+}
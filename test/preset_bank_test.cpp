@@ -0,0 +1,151 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/preset_bank.hpp>
+#include <fstream>
+
+namespace q = cycfi::q;
+namespace fs = cycfi::fs;
+using namespace cycfi::qplug;
+using namespace q::literals;
+
+namespace
+{
+   parameter params[] =
+   {
+      parameter{ "param 1", true }
+    , parameter{ "param 2", 0 }.range(0, 90)
+    , parameter{ "param 3", 0.5 }
+    , parameter{ "param 4", 2_kHz }
+    , parameter{ "param 5", q::midi::note::E2 }
+      .range(q::midi::note::A1, q::midi::note::G4)
+   };
+
+   char const* json =
+   R"(
+      {
+         "Lead" : {
+            "param 1" : false,
+            "param 2" : 45,
+            "param 5" : "C4"
+         },
+         "Bass" : {
+            "param 3" : 0.7,
+            "param 4" : 1500
+         },
+         "Lead" : {
+            "param 2" : 30
+         }
+      }
+   )";
+
+   fs::path bank_path()
+   {
+      return fs::temp_directory_path() / "preset_bank_test.qpb";
+   }
+
+   void write_bank()
+   {
+      preset_bank_writer writer{ params };
+      REQUIRE(convert_presets(json, params, writer));
+      REQUIRE(writer.size() == 2);
+      REQUIRE(writer.write(bank_path()));
+   }
+}
+
+TEST_CASE("test_preset_bank")
+{
+   write_bank();
+
+   preset_bank bank;
+   REQUIRE(bank.open(bank_path(), params));
+   REQUIRE(bank.size() == 2);
+
+   // Sorted by name
+   CHECK(bank.name(0) == "Bass");
+   CHECK(bank.name(1) == "Lead");
+   CHECK(bank.find("Bass") == 0);
+   CHECK(bank.find("Lead") == 1);
+   CHECK(bank.find("Pad") == -1);
+   CHECK(bank.find("") == -1);
+
+   CHECK(!bank.has(0, 0));
+   CHECK(bank.has(0, 2));
+   CHECK(bank.value(0, 2) == Approx(0.7));
+   CHECK(bank.value(0, 3) == 1500);
+
+   // The second "Lead" replaces the first
+   std::vector<std::pair<int, double>> lead;
+   bank.for_each(1, [&](int param, double value) { lead.emplace_back(param, value); });
+   REQUIRE(lead.size() == 1);
+   CHECK(lead[0].first == 1);
+   CHECK(lead[0].second == 30);
+
+   fs::remove(bank_path());
+}
+
+TEST_CASE("test_preset_bank_changed_parameters")
+{
+   write_bank();
+
+   // Parameters reordered, one removed and one added
+   parameter new_params[] =
+   {
+      parameter{ "param 6", 0.1 }
+    , parameter{ "param 4", 2_kHz }
+    , parameter{ "param 3", 0.5 }
+    , parameter{ "param 2", 0 }.range(0, 90)
+   };
+
+   preset_bank bank;
+   REQUIRE(bank.open(bank_path(), new_params));
+   auto bass = bank.find("Bass");
+   REQUIRE(bass >= 0);
+   CHECK(!bank.has(bass, 0));
+   CHECK(bank.value(bass, 1) == 1500);
+   CHECK(bank.value(bass, 2) == Approx(0.7));
+   CHECK(!bank.has(bass, 3));
+   CHECK(!bank.has(bass, 4));
+
+   fs::remove(bank_path());
+}
+
+TEST_CASE("test_preset_bank_invalid")
+{
+   preset_bank bank;
+   CHECK(!bank.open(fs::temp_directory_path() / "no_such_bank.qpb", params));
+
+   write_bank();
+   std::string data;
+   {
+      std::ifstream file(bank_path(), std::ios::binary);
+      data.assign(
+         (std::istreambuf_iterator<char>(file))
+       , std::istreambuf_iterator<char>());
+   }
+
+   auto check_invalid = [&](std::string const& contents)
+   {
+      {
+         std::ofstream file(bank_path(), std::ios::binary | std::ios::trunc);
+         file.write(contents.data(), contents.size());
+      }
+      CHECK(!bank.open(bank_path(), params));
+      CHECK(!bank.is_open());
+      CHECK(bank.size() == 0);
+   };
+
+   check_invalid("");
+   check_invalid("{ \"Lead\" : {} }");
+   check_invalid(data.substr(0, data.size() - 1));
+
+   auto bad_version = data;
+   bad_version[4] = 99;
+   check_invalid(bad_version);
+
+   fs::remove(bank_path());
+}
@@ -0,0 +1,231 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/preset_journal.hpp>
+#include <fstream>
+
+namespace fs = cycfi::fs;
+using namespace cycfi::qplug;
+
+namespace
+{
+   parameter params[] =
+   {
+      parameter{ "param 1", 0.1 }
+    , parameter{ "param 2", 0.2 }
+    , parameter{ "param 3", 0.3 }
+   };
+
+   fs::path journal_path()
+   {
+      return fs::temp_directory_path() / "preset_journal_test.journal";
+   }
+
+   void write_presets(preset_journal& journal)
+   {
+      preset_store presets{ 3 };
+      auto lead = presets.add("Lead");
+      presets.set(lead, 0, 1.0);
+      presets.set(lead, 2, 3.0);
+      journal.save(presets, lead);
+
+      auto bass = presets.add("Bass");
+      presets.set(bass, 1, 2.0);
+      journal.save(presets, bass);
+
+      // Lead saved again, without param 3
+      presets.clear(lead);
+      presets.set(lead, 0, 4.0);
+      journal.save(presets, lead);
+
+      journal.erase("Bass");
+      journal.flush();
+   }
+}
+
+TEST_CASE("test_preset_journal")
+{
+   fs::remove(journal_path());
+   {
+      preset_journal journal;
+      journal.open(journal_path(), params);
+      write_presets(journal);
+      CHECK(journal.size() == 4);
+   }
+
+   preset_store presets{ 3 };
+   auto pad = presets.add("Pad");
+   presets.set(pad, 1, 0.5);
+
+   preset_journal journal;
+   journal.open(journal_path(), params);
+   CHECK(journal.replay(presets) == 4);
+   CHECK(journal.size() == 4);
+
+   REQUIRE(presets.size() == 2);
+   CHECK(presets.find("Bass") == -1);
+   CHECK(presets.find("Pad") >= 0);
+
+   auto lead = presets.find("Lead");
+   REQUIRE(lead >= 0);
+   CHECK(presets.value(lead, 0) == 4.0);
+   CHECK(!presets.has(lead, 1));
+   CHECK(!presets.has(lead, 2));
+
+   fs::remove(journal_path());
+}
+
+TEST_CASE("test_preset_journal_changed_parameters")
+{
+   fs::remove(journal_path());
+   {
+      preset_journal journal;
+      journal.open(journal_path(), params);
+      write_presets(journal);
+   }
+
+   // Parameters reordered, one removed
+   parameter new_params[] =
+   {
+      parameter{ "param 3", 0.3 }
+    , parameter{ "param 1", 0.1 }
+   };
+
+   preset_store presets{ 2 };
+   preset_journal journal;
+   journal.open(journal_path(), new_params);
+   journal.replay(presets);
+
+   auto lead = presets.find("Lead");
+   REQUIRE(lead >= 0);
+   CHECK(!presets.has(lead, 0));
+   CHECK(presets.value(lead, 1) == 4.0);
+
+   fs::remove(journal_path());
+}
+
+TEST_CASE("test_preset_journal_torn_tail")
+{
+   fs::remove(journal_path());
+   {
+      preset_journal journal;
+      journal.open(journal_path(), params);
+      write_presets(journal);
+   }
+
+   // Cut the last record (the erase) short, as a crash would
+   auto size = fs::file_size(journal_path());
+   fs::resize_file(journal_path(), size - 3);
+
+   {
+      preset_store presets{ 3 };
+      preset_journal journal;
+      journal.open(journal_path(), params);
+      CHECK(journal.replay(presets) == 3);
+      CHECK(presets.find("Bass") >= 0);
+
+      // The torn record is dropped, so new records are readable
+      journal.erase("Lead");
+      journal.flush();
+   }
+
+   preset_store presets{ 3 };
+   preset_journal journal;
+   journal.open(journal_path(), params);
+   CHECK(journal.replay(presets) == 4);
+   CHECK(presets.find("Lead") == -1);
+   CHECK(presets.find("Bass") >= 0);
+
+   fs::remove(journal_path());
+}
+
+TEST_CASE("test_preset_journal_invalid")
+{
+   {
+      std::ofstream file(journal_path(), std::ios::binary | std::ios::trunc);
+      file << "{ \"Lead\" : {} }";
+   }
+
+   preset_store presets{ 3 };
+   preset_journal journal;
+   journal.open(journal_path(), params);
+   CHECK(journal.replay(presets) == 0);
+   CHECK(presets.empty());
+
+   // Started over
+   journal.erase("Lead");
+   journal.flush();
+   presets.add("Lead");
+   CHECK(journal.replay(presets) == 1);
+   CHECK(presets.empty());
+
+   fs::remove(journal_path());
+}
+
+TEST_CASE("test_preset_journal_compact")
+{
+   fs::remove(journal_path());
+   preset_journal journal;
+   journal.open(journal_path(), params);
+   write_presets(journal);
+
+   // A failed compaction keeps the journal
+   journal.compact([] { return std::uint64_t(0); });
+   CHECK(journal.size() == 0);
+   journal.flush();
+
+   preset_store presets{ 3 };
+   CHECK(journal.replay(presets) == 4);
+
+   bool compacted = false;
+   journal.compact([&] { compacted = true; return journal.replayed(); });
+   journal.flush();
+   CHECK(compacted);
+
+   presets.reset(3);
+   CHECK(journal.replay(presets) == 0);
+   CHECK(presets.empty());
+
+   fs::remove(journal_path());
+}
+
+TEST_CASE("test_preset_journal_shared")
+{
+   fs::remove(journal_path());
+   preset_journal ours;
+   ours.open(journal_path(), params);
+   write_presets(ours);
+
+   // Our own records are applied already
+   preset_store presets{ 3 };
+   CHECK(ours.replay_more(presets) == 0);
+
+   // Another process appends while ours is compacting: its record is not
+   // in our presets, so it is kept
+   preset_journal theirs;
+   theirs.open(journal_path(), params);
+   ours.compact(
+      [&]
+      {
+         auto pos = ours.replayed();
+         theirs.erase("Lead");
+         theirs.flush();
+         return pos;
+      }
+   );
+   ours.flush();
+
+   presets.add("Lead");
+   CHECK(ours.replay_more(presets) == 1);
+   CHECK(presets.empty());
+
+   presets.add("Lead");
+   CHECK(ours.replay(presets) == 1);
+   CHECK(presets.empty());
+
+   fs::remove(journal_path());
+}
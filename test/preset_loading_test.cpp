@@ -0,0 +1,477 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <infra/filesystem.hpp>
+#include <elements/support/resource_paths.hpp>
+#include "headless/headless_plugin.hpp"
+#include <qplug/preset_journal.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+namespace fs = cycfi::fs;
+using namespace std::chrono_literals;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+   constexpr std::size_t num_params = 64;
+   constexpr std::size_t num_presets = 2000;
+   constexpr int note_param = num_params;    // Not in the factory presets
+   constexpr int id_param = num_params + 1;  // Not in the factory presets
+
+   qplug::controller::parameter_list test_parameters()
+   {
+      static std::vector<std::string> names;
+      static std::vector<qplug::parameter> params;
+      if (params.empty())
+      {
+         for (std::size_t i = 0; i != num_params; ++i)
+            names.push_back("Param " + std::to_string(i));
+         for (auto const& name : names)
+            params.push_back(qplug::parameter{ name.c_str(), 0.5 });
+         params.push_back(
+            qplug::parameter{ "Note", q::midi::note::E2 }
+               .range(q::midi::note::A1, q::midi::note::G4)
+         );
+         params.push_back(qplug::parameter{ "Program ID", -1 }.range(-1, 127));
+      }
+      return { params.data(), params.data() + params.size() };
+   }
+
+   struct test_controller : qplug::controller
+   {
+      using controller::controller;
+
+      parameter_list parameters() const override
+      {
+         return test_parameters();
+      }
+
+      void on_presets_loaded() override
+      {
+         ++loaded;
+         loaded_time = clock_type::now();
+      }
+
+      void on_recall_parameter(int id, double value) override
+      {
+         ++recalled;
+      }
+
+      void on_presets_changed() override
+      {
+         ++changed;
+      }
+
+      int loaded = 0;
+      int recalled = 0;
+      int changed = 0;
+      clock_type::time_point loaded_time;
+   };
+
+   struct test_processor : qplug::processor
+   {
+      using processor::processor;
+      void process(in_channels const& in, out_channels const& out) override {}
+   };
+
+   fs::path test_dir()
+   {
+      return fs::temp_directory_path() / "preset_loading_test";
+   }
+
+   // Factory presets big enough that parsing them takes a while
+   std::string factory_presets()
+   {
+      std::string json = "{";
+      for (std::size_t i = 0; i != num_presets; ++i)
+      {
+         json += (i? ",\n" : "\n");
+         json += "  \"Preset " + std::to_string(i) + "\" : {";
+         for (std::size_t j = 0; j != num_params; ++j)
+         {
+            json += (j? ", " : "");
+            json += "\"Param " + std::to_string(j) + "\" : 0." + std::to_string((i + j) % 10);
+         }
+         json += '}';
+      }
+      return json + "\n}\n";
+   }
+
+   fs::path factory_presets_file()
+   {
+      return test_dir() / "factory_presets.json";
+   }
+
+   // The factory presets file is a named pipe: the loader blocks opening
+   // it until release_factory_presets writes the presets
+   void gate_factory_presets()
+   {
+      fs::remove_all(test_dir());
+      fs::create_directories(test_dir());
+      REQUIRE(mkfifo(factory_presets_file().c_str(), 0600) == 0);
+   }
+
+   // Afterwards, the file is a regular file, for the tests that follow
+   void release_factory_presets()
+   {
+      auto json = factory_presets();
+      std::ofstream(factory_presets_file()) << json;
+      fs::remove(factory_presets_file());
+      std::ofstream(factory_presets_file()) << json;
+   }
+
+   // What the plugin does when the host opens its window (see
+   // iplug2_plugin::OpenWindow)
+   void open_window(headless_plugin& plugin)
+   {
+      auto& controller = plugin.controller();
+      controller.on_attach_view();
+      controller.poll_presets();
+      for (int id = 0; id != int(plugin.num_parameters()); ++id)
+         controller.update_ui_parameter(id, plugin.get_parameter_normalized(id));
+   }
+
+   // Wait (for the presets watcher) until f is true, for up to 5s
+   template <typename F>
+   bool wait_for(headless_plugin& plugin, F&& f)
+   {
+      auto until = clock_type::now() + 5s;
+      while (!f())
+      {
+         if (clock_type::now() > until)
+            return false;
+         plugin.idle();
+         std::this_thread::sleep_for(1ms);
+      }
+      return true;
+   }
+
+   bool file_has(fs::path const& path, std::string_view text)
+   {
+      std::ifstream file(path, std::ios::binary);
+      std::string data{ std::istreambuf_iterator<char>(file), {} };
+      return data.find(text) != std::string::npos;
+   }
+
+   double to_ms(clock_type::duration d)
+   {
+      return std::chrono::duration<double, std::milli>(d).count();
+   }
+}
+
+namespace cycfi::qplug
+{
+   controller_ptr make_controller(base_controller& base)
+   {
+      return std::make_unique<test_controller>(base);
+   }
+
+   processor_ptr make_processor(base_processor& base)
+   {
+      return std::make_unique<test_processor>(base);
+   }
+}
+
+TEST_CASE("test_preset_loading")
+{
+   gate_factory_presets();
+   setenv("XDG_DATA_HOME", test_dir().c_str(), 1);
+   cycfi::elements::add_search_path(test_dir());
+
+   // Created and opened by the host, one right after the other. The
+   // loader can't read the factory presets until the window is open.
+   auto start = clock_type::now();
+   headless_plugin plugin;
+   plugin.controller().load_all_presets_async();
+   open_window(plugin);
+   auto opened = clock_type::now();
+
+   // The window opened (and painted its parameters) without waiting for
+   // the loader
+   auto& controller = static_cast<test_controller&>(plugin.controller());
+   CHECK(!controller.presets_loaded());
+   CHECK(controller.loaded == 0);
+
+   auto released = clock_type::now();
+   release_factory_presets();
+   while (!controller.presets_loaded())
+   {
+      plugin.idle();
+      std::this_thread::sleep_for(100us);
+   }
+
+   std::printf(
+      "open to first paint: %.3f ms, presets ready: %.3f ms after release\n"
+    , to_ms(opened - start), to_ms(controller.loaded_time - released)
+   );
+
+   CHECK(controller.loaded == 1);
+   CHECK(controller.preset_list().size() == num_presets);
+   CHECK(controller.has_factory_preset("Preset 42"));
+
+   // Delivered once
+   plugin.idle();
+   CHECK(controller.loaded == 1);
+
+   CHECK(controller.load_preset("Preset 3"));
+   CHECK(plugin.get_parameter(1) == Approx(0.4));
+}
+
+TEST_CASE("test_preset_loading_wait")
+{
+   // A load in progress is waited for, and delivered, by load_all_presets
+   headless_plugin plugin;
+   auto& controller = static_cast<test_controller&>(plugin.controller());
+   controller.load_all_presets_async();
+   CHECK(controller.load_all_presets());
+   CHECK(controller.presets_loaded());
+   CHECK(controller.loaded == 1);
+
+   // Saving waits for the load too, so the preset is not lost
+   headless_plugin plugin2;
+   plugin2.controller().load_all_presets_async();
+   plugin2.controller().save_preset("Mine");
+   CHECK(plugin2.controller().has_preset("Mine"));
+   CHECK(plugin2.controller().has_factory_preset("Preset 0"));
+   CHECK(plugin2.controller().delete_preset("Mine"));
+
+   // test_dir is not removed here: the preset journal may still be writing
+   // to it. It is cleared at the start of the next run.
+}
+
+TEST_CASE("test_preset_recall")
+{
+   headless_plugin plugin;
+   auto& controller = static_cast<test_controller&>(plugin.controller());
+   auto& processor = plugin.processor();
+   controller.load_all_presets();
+   plugin.reset(44100, 64);
+   plugin.activate(true);
+
+   std::vector<float> buffer(64);
+   float* out[] = { buffer.data(), buffer.data() };
+   float const* in[] = { buffer.data(), buffer.data() };
+   auto block = [&] { plugin.process(in, 2, out, 2, buffer.size()); };
+
+   // Param j of Preset i is 0.((i + j) % 10). Only the parameters that
+   // change (from the default 0.5) are recalled.
+   CHECK(controller.load_preset("Preset 1"));
+   CHECK(controller.recalled == num_params - 6);
+   block();
+   CHECK(processor.parameter_values()[5] == Approx(0.6));
+
+   // Nothing changes: nothing is recalled
+   controller.recalled = 0;
+   CHECK(controller.load_preset("Preset 11"));
+   CHECK(controller.recalled == 0);
+
+   CHECK(controller.load_preset("Preset 4"));
+   controller.recalled = 0;
+   CHECK(controller.load_preset("Default"));
+   CHECK(controller.recalled == num_params - 7);
+   CHECK(plugin.get_parameter(1) == Approx(0.5));
+
+   // And reach the processor together, in the next block
+   block();
+   for (int id = 0; id != int(num_params); ++id)
+      CHECK(processor.parameter_values()[id] == Approx(0.5));
+
+   CHECK(!controller.load_preset("No such preset"));
+}
+
+TEST_CASE("test_preset_morph")
+{
+   headless_plugin plugin;
+   auto& controller = static_cast<test_controller&>(plugin.controller());
+   auto& processor = plugin.processor();
+   controller.load_all_presets();
+   plugin.reset(1000, 100);
+   plugin.activate(true);
+
+   std::vector<float> buffer(100);
+   float* out[] = { buffer.data(), buffer.data() };
+   float const* in[] = { buffer.data(), buffer.data() };
+   auto block = [&] { plugin.process(in, 2, out, 2, buffer.size()); };
+
+   // Param 0 goes from 0.1 to 0.5 over 4 blocks of 100 frames (at 1000 sps)
+   CHECK(controller.morph_preset("Preset 1", "Preset 5", 400));
+   CHECK(!controller.morph_preset("Preset 1", "No such preset", 400));
+   block();
+   CHECK(processor.parameter_values()[0] == Approx(0.1));
+   block();
+   CHECK(processor.parameter_values()[0] == Approx(0.2));
+   block();
+   block();
+   block();
+   CHECK(processor.parameter_values()[0] == Approx(0.5));
+   CHECK(!processor.morphing());
+
+   // The host is told the values the morph ended on, on idle
+   CHECK(plugin.get_parameter(1) == Approx(0.5));
+   CHECK(controller.recalled == 0);
+   plugin.idle();
+   CHECK(plugin.get_parameter(1) == Approx(0.6));
+   CHECK(controller.recalled == num_params - 7);
+
+   // Along the morph position, from the current values
+   CHECK(controller.morph_preset("", "Preset 1", 0));
+   processor.morph_position(0.5);
+   block();
+   CHECK(processor.parameter_values()[0] == Approx(0.3));
+   CHECK(processor.morphing());
+   controller.stop_morph();
+   block();
+   CHECK(!processor.morphing());
+
+   // Notes are saved as MIDI notes, and morphed as enumerations, like the
+   // host sees them. The note switches halfway, after 2 blocks.
+   plugin.automate(note_param, 12.0);
+   controller.save_preset("High");
+   plugin.automate(note_param, 2.0);
+   controller.save_preset("Low");
+   block();
+   CHECK(controller.morph_preset("Low", "High", 400));
+   block();
+   CHECK(processor.parameter_values()[note_param] == Approx(2.0));
+   block();
+   block();
+   CHECK(processor.parameter_values()[note_param] == Approx(12.0));
+   block();
+   block();
+   plugin.idle();
+   CHECK(plugin.get_parameter(note_param) == Approx(12.0));
+
+   // Loaded the same way
+   CHECK(controller.load_preset("Low"));
+   CHECK(plugin.get_parameter(note_param) == Approx(2.0));
+   CHECK(controller.load_preset("Default"));
+   CHECK(plugin.get_parameter(note_param) == Approx(
+      double(q::midi::note::E2) - double(q::midi::note::A1)));
+
+   CHECK(controller.delete_preset("High"));
+   CHECK(controller.delete_preset("Low"));
+}
+
+TEST_CASE("test_preset_program_ids")
+{
+   headless_plugin plugin;
+   auto& controller = static_cast<test_controller&>(plugin.controller());
+   controller.load_all_presets();
+
+   using entry = std::pair<std::string_view, int>;
+   auto has_entry =
+      [&](std::string_view name, int id)
+      {
+         auto list = controller.preset_list();
+         return std::find(list.begin(), list.end(), entry{ name, id }) != list.end();
+      };
+
+   // Presets without an ID are listed by name, before the rest
+   controller.save_preset("Seven");
+   CHECK(has_entry("Seven", -1));
+   CHECK(controller.preset_list().size() == num_presets + 1);
+
+   plugin.automate(id_param, 7.0);
+   controller.save_preset("Seven");
+   CHECK(!has_entry("Seven", -1));
+   CHECK(controller.preset_list().back() == entry{ "Seven", 7 });
+   CHECK(controller.find_preset(7) == "Seven");
+   CHECK(controller.find_preset_id("Seven") == 7);
+
+   // Taking an ID gives the owner the preset's old one
+   controller.save_preset("Another");
+   CHECK(controller.find_preset(7) == "Another");
+   CHECK(controller.find_preset(0) == "Seven");
+   CHECK(has_entry("Another", 7));
+   CHECK(has_entry("Seven", 0));
+   CHECK(controller.preset_list().size() == num_presets + 2);
+
+   CHECK(controller.delete_preset("Another"));
+   CHECK(controller.find_preset(7) == "");
+   CHECK(!has_entry("Another", 7));
+   CHECK(controller.delete_preset("Seven"));
+   CHECK(controller.find_preset(0) == "");
+   CHECK(controller.preset_list().size() == num_presets);
+}
+
+
+TEST_CASE("test_preset_external_changes")
+{
+   headless_plugin plugin;
+   auto& controller = static_cast<test_controller&>(plugin.controller());
+   controller.load_all_presets();
+   controller.save_preset("Ours");
+
+   // Our journal is written in the background. Wait for it (or for the
+   // compacted presets file), so that their records come after ours.
+   auto dir = test_dir() / PLUG_MFR;
+   CHECK(wait_for(plugin, [&]
+      {
+         return file_has(dir / PLUG_NAME"_presets.journal", "Ours")
+            || file_has(dir / PLUG_NAME"_presets.json", "\"Ours\"");
+      }
+   ));
+
+   // Another process saves presets to the journal
+   qplug::preset_journal journal;
+   journal.open(dir / PLUG_NAME"_presets.journal", test_parameters());
+   qplug::preset_store presets{ num_params + 1 };
+   auto theirs = presets.add("Theirs");
+   presets.set(theirs, 2, 0.25);
+   journal.save(presets, theirs);
+   journal.erase("Ours");
+   journal.flush();
+
+   // Only their records are read, and the presets published
+   CHECK(wait_for(plugin, [&] { return controller.has_preset("Theirs"); }));
+   CHECK(wait_for(plugin, [&] { return !controller.has_preset("Ours"); }));
+   CHECK(controller.load_preset("Theirs"));
+   CHECK(plugin.get_parameter(2) == Approx(0.25));
+   CHECK(wait_for(plugin, [&] { return controller.changed > 0; }));
+
+   // It compacts its journal: the presets file is rewritten, and loaded
+   // again, with the journal written since
+   journal.replay_more(presets);
+   journal.compact(
+      [&]
+      {
+         auto tmp = dir / PLUG_NAME"_presets.json.tmp";
+         std::ofstream(tmp) << "{\n  \"Compacted\" : { \"Param 3\" : 0.75 }\n}\n";
+         fs::rename(tmp, dir / PLUG_NAME"_presets.json");
+         return journal.replayed();
+      }
+   );
+   journal.flush();
+   auto later = presets.add("Later");
+   presets.set(later, 4, 0.125);
+   journal.save(presets, later);
+   journal.flush();
+
+   CHECK(wait_for(plugin, [&] { return controller.has_preset("Later"); }));
+   CHECK(controller.has_preset("Compacted"));
+   CHECK(!controller.has_preset("Theirs"));
+   CHECK(controller.has_factory_preset("Preset 0"));
+   CHECK(controller.load_preset("Compacted"));
+   CHECK(plugin.get_parameter(3) == Approx(0.75));
+
+   // Our own changes still go through
+   controller.save_preset("Ours again");
+   CHECK(controller.has_preset("Ours again"));
+   CHECK(controller.delete_preset("Ours again"));
+   CHECK(controller.delete_preset("Compacted"));
+   CHECK(controller.delete_preset("Later"));
+}
@@ -0,0 +1,111 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/preset_store.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace cycfi::qplug;
+
+namespace
+{
+   using values = std::vector<std::pair<int, double>>;
+
+   values get(preset_store const& store, int preset)
+   {
+      values r;
+      store.for_each(preset, [&](int param, double value) { r.emplace_back(param, value); });
+      return r;
+   }
+
+   std::vector<std::string> names(preset_store const& store)
+   {
+      std::vector<std::string> r;
+      store.for_each_preset(
+         [&](std::string_view name, int preset)
+         {
+            CHECK(store.name(preset) == name);
+            r.emplace_back(name);
+         }
+      );
+      return r;
+   }
+}
+
+TEST_CASE("test_preset_store")
+{
+   preset_store store{ 130 };
+   auto lead = store.add("Lead");
+   auto bass = store.add("Bass");
+   CHECK(lead == 0);
+   CHECK(bass == 1);
+   CHECK(store.add("Lead") == lead);
+   CHECK(store.size() == 2);
+
+   store.set(lead, 129, 1.5);
+   store.set(lead, 0, 0.5);
+   store.set(lead, 64, 2.0);
+   store.set(lead, 130, 9.0);   // Out of range; ignored
+   store.set(bass, 3, 3.0);
+
+   CHECK(store.has(lead, 0));
+   CHECK(!store.has(lead, 1));
+   CHECK(!store.has(lead, 130));
+   CHECK(store.value(lead, 64) == 2.0);
+   CHECK((get(store, lead) == values{ { 0, 0.5 }, { 64, 2.0 }, { 129, 1.5 } }));
+   CHECK((get(store, bass) == values{ { 3, 3.0 } }));
+
+   CHECK(store.find("Bass") == bass);
+   CHECK(store.find("Pad") == -1);
+   CHECK((names(store) == std::vector<std::string>{ "Bass", "Lead" }));
+}
+
+TEST_CASE("test_preset_store_erase")
+{
+   preset_store store{ 4 };
+   for (int i = 0; i != 4; ++i)
+   {
+      auto preset = store.add("Preset " + std::to_string(i));
+      store.set(preset, i, i * 10.0);
+   }
+
+   CHECK(!store.erase("Preset 9"));
+   CHECK(store.erase("Preset 1"));
+   CHECK(store.size() == 3);
+   CHECK(store.find("Preset 1") == -1);
+
+   // The last preset takes the place of the erased one
+   auto last = store.find("Preset 3");
+   CHECK(last == 1);
+   CHECK((get(store, last) == values{ { 3, 30.0 } }));
+   CHECK((get(store, store.find("Preset 2")) == values{ { 2, 20.0 } }));
+
+   CHECK(store.erase("Preset 2"));
+   CHECK(store.erase("Preset 0"));
+   CHECK(store.erase("Preset 3"));
+   CHECK(store.empty());
+
+   auto preset = store.add("New");
+   CHECK(preset == 0);
+   CHECK(get(store, preset).empty());
+}
+
+TEST_CASE("test_preset_store_reset")
+{
+   preset_store store;
+   CHECK(store.num_params() == 0);
+   store.reset(10);
+   store.set(store.add("A"), 5, 1.0);
+
+   preset_store other{ 3 };
+   other.swap(store);
+   CHECK(store.empty());
+   CHECK(store.num_params() == 3);
+   CHECK(other.num_params() == 10);
+   CHECK((get(other, other.find("A")) == values{ { 5, 1.0 } }));
+}
@@ -6,6 +6,11 @@
 #define CATCH_CONFIG_MAIN
 #include <infra/catch.hpp>
 #include <qplug/presets.hpp>
+#include <qplug/preset_reader.hpp>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
 
 namespace q = cycfi::q;
 using namespace cycfi::qplug;
@@ -114,6 +119,7 @@ TEST_CASE("test_preset_parser")
       auto attr = on_preset(params, f);
       bool r = test_parser(preset_parser{}, json, attr);
       REQUIRE(r);
+      REQUIRE(read_preset(json, parameter_names{ params }, f));
    }
 }
 
@@ -143,6 +149,7 @@ TEST_CASE("test_preset_parser_bad_input")
       auto attr = on_preset(params, f);
       bool r = test_parser(preset_parser{}, json, attr);
       REQUIRE(!r);
+      REQUIRE(!read_preset(json, parameter_names{ params }, f));
    }
 }
 
@@ -192,6 +199,7 @@ TEST_CASE("test_params_parser_missing_and_unordered_fields")
       auto attr = on_preset(params, f);
       bool r = test_parser(preset_parser{}, json, attr);
       REQUIRE(r);
+      REQUIRE(read_preset(json, parameter_names{ params }, f));
    }
 }
 
@@ -290,11 +298,188 @@ TEST_CASE("test_multi_presets")
    auto attr = for_each_preset(params, f1, f2);
    bool r = test_parser(preset_parser{}, json, attr);
    REQUIRE(r);
+
+   i = 0;
+   REQUIRE(read_presets(json, parameter_names{ params }, f1, f2));
+   CHECK(i == 2);
+}
+
+TEST_CASE("test_parameter_names")
+{
+   std::vector<std::string> names;
+   for (int i = 0; i != 1000; ++i)
+      names.push_back("param " + std::to_string(i));
+
+   std::vector<parameter> params;
+   for (auto const& name : names)
+      params.push_back(parameter{ name.c_str(), 0.5 });
+   params.push_back(parameter{ "param 7", 0 });   // Repeated: this one wins
+
+   parameter_names index{ { params.data(), params.data() + params.size() } };
+   for (std::size_t i = 0; i != names.size(); ++i)
+   {
+      if (i != 7)
+         CHECK(index.find(names[i]) == &params[i]);
+   }
+   CHECK(index.find("param 7") == &params.back());
+   CHECK(index.find("param 1000") == nullptr);
+   CHECK(index.find("") == nullptr);
+}
+
+TEST_CASE("test_extract_string")
+{
+   CHECK(extract_string("plain") == std::string{ "plain" });
+   CHECK(extract_string(R"(a\"b\\c\n)") == std::string{ "a\"b\\c\n" });
+   CHECK(extract_string(R"(\u00e9t\u00e9)") == std::string{ "\xc3\xa9t\xc3\xa9" });
+   CHECK(!extract_string("a\tb"));
+   CHECK(!extract_string(R"(a\)"));
 }
 
+namespace
+{
+   parameter reader_params[] =
+   {
+      parameter{ "bool", true }
+    , parameter{ "int", 0 }.range(0, 90)
+    , parameter{ "double", 0.5 }
+    , parameter{ "frequency", 2_kHz }
+    , parameter{ "note", q::midi::note::E2 }
+      .range(q::midi::note::A1, q::midi::note::G4)
+    , parameter{ "with \\\"quotes\\\"", 0.5 }
+   };
+
+   // What preset_parser and read_presets report, including the exact
+   // values
+   std::vector<std::string> events(std::string_view json, bool use_reader)
+   {
+      std::vector<std::string> r;
+      auto&& f1 = [&r](auto const& p, parameter const& param)
+      {
+         char buff[64];
+         std::snprintf(buff, sizeof(buff), " = %a", double(p.second));
+         r.push_back(std::string{ p.first } + buff);
+      };
+
+      auto&& f2 = [&r](std::string_view name)
+      {
+         r.push_back("preset " + std::string{ name });
+      };
 
+      bool ok;
+      if (use_reader)
+      {
+         ok = read_presets(json, parameter_names{ reader_params }, f1, f2);
+      }
+      else
+      {
+         auto attr = for_each_preset(reader_params, f1, f2);
+         char const* f = json.data();
+         char const* l = f + json.size();
+         ok = x3::phrase_parse(f, l, preset_parser{}, x3::space, attr);
+      }
+      r.push_back(ok? "ok" : "fail");
+      return r;
+   }
 
+   void check_same(std::string const& json)
+   {
+      INFO(json);
+      CHECK(events(json, true) == events(json, false));
+   }
+}
 
+TEST_CASE("test_preset_reader_same_as_parser")
+{
+   char const* structure[] =
+   {
+      "", "   ", "{", "}", "{}", " { } ", "{,}", "[]", "{\"a\"}", "{\"a\":}"
+    , "{\"a\":{}}", "{\"a\":{},}", "{\"a\":{}\"b\":{}}", "{\"a\":{},\"b\":{}}"
+    , "{\"a\":{\"int\":1,}}", "{\"a\":{\"int\":1 \"double\":2}}"
+    , "{\"a\":{\"unknown\":1},\"b\":{\"int\":2}}"
+    , "{\"a\":{\"unknown\":\"x\"},\"b\":{\"int\":2}}"
+    , "{\"a\":{\"int\":1},\"b\":{\"int\":2}"
+    , "{\"a\":{\"int\":1} \"b\":{\"int\":2}}"
+    , "{\"a\" \"b\":{}}", "{\"a\":{\"int\"}}", "{\"a\":{\"int\":}}"
+    , "{\"unterminated:{}}", "{\"a\":{\"note\":\"C4}}"
+    , "{\"a\\\"b\":{}}", "{\"a\\\\\":{}}", "{\"a\\\\\":{}}\"}"
+    , "{\"with \\\"quotes\\\"\":{\"with \\\"quotes\\\"\":0.25}}"
+    , "{\"a\":{\"note\":\"C4\",\"note\":\"A1\",\"bool\":false}}"
+    , "{\"  spaced  name  \":{\"bool\" : true , \"int\" : 3}}"
+    , "\t{\n\"a\"\r:\v{\f\"int\"\t:\n7\r}\n}\n"
+    , "{                                        \"a\"                    :{}}"
+    , "{\"a\":{\"bool\":true},\"a\":{\"bool\":false}} trailing"
+   };
+   for (auto json : structure)
+      check_same(json);
 
+   char const* numbers[] =
+   {
+      "0", "-0", "+0", "7", "007", "+5", "-5", "+-5", "-+5", "--1", "+", "-"
+    , "0.7", "123.456", ".5", "-.5", "+.5", "5.", "-5.", ".", "-."
+    , "1e3", "1E-2", "1e", "1e+", "1ex", "2.5e+10", "1e400", "1e-400"
+    , "inf", "-inf", "infinity", "nan", "-nan", "NaN", "0x10"
+    , "2147483647", "2147483648", "-2147483648", "-2147483649"
+    , "123456789012345", "1234567890123456", "1234567890123456789"
+    , "0.123456789012345", "0.1234567890123456789", "3.141592653589793"
+    , "1.5", "1,5", "true", "True", "tru", "false", "falsey", "\"C4\"", "\"C#4\""
+   };
+   char const* names[] = { "bool", "int", "double", "frequency", "note" };
+   for (auto name : names)
+   {
+      for (auto number : numbers)
+      {
+         auto preset = std::string{ "\"" } + name + "\" : " + number;
+         check_same("{\"a\":{" + preset + "}}");
+         check_same("{\"a\":{" + preset + ", \"int\" : 1}}");
+      }
+   }
+}
 
+TEST_CASE("test_preset_reader_bank")
+{
+   // Random presets, with values written as the controller writes them,
+   // and with up to 17 digits
+   std::mt19937 rng{ 1234 };
+   std::uniform_real_distribution<double> value{ -1000, 1000 };
+   std::uniform_int_distribution<int> coin{ 0, 3 };
+
+   std::string json = "{";
+   for (int i = 0; i != 500; ++i)
+   {
+      json += (i? ",\n" : "\n");
+      json += "  \"Preset " + std::to_string(i) + "\" : {";
+      bool first = true;
+      for (auto const& param : reader_params)
+      {
+         if (coin(rng) == 0)
+            continue;
+         json += first? "\n    \"" : ",\n    \"";
+         first = false;
+         json += std::string{ param._name } + "\" : ";
+
+         char buff[64];
+         auto v = value(rng);
+         switch (param._type)
+         {
+            case parameter::bool_:
+               json += (v > 0)? "true" : "false";
+               break;
+            case parameter::int_:
+               json += std::to_string(int(v));
+               break;
+            case parameter::note:
+               json += "\"C4\"";
+               break;
+            default:
+               std::snprintf(buff, sizeof(buff), "%.*g", 1 + coin(rng) * 5, v);
+               json += buff;
+         }
+      }
+      json += "\n  }";
+   }
+   json += "\n}\n";
 
+   auto r = events(json, true);
+   CHECK(r.back() == "ok");
+   CHECK(r == events(json, false));
+}
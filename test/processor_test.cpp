@@ -0,0 +1,329 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include "headless/headless_plugin.hpp"
+
+#include <vector>
+
+namespace
+{
+   constexpr std::size_t block_size = 64;
+
+   qplug::parameter params[] =
+   {
+      qplug::parameter{ "Gain", 0.5 }
+    , qplug::parameter{ "Pan", 0.0 }.range(-1.0, 1.0)
+    , qplug::parameter{ "Level", 0.0 }.smooth(10)   // 441 frames
+   };
+
+   struct test_controller : qplug::controller
+   {
+      using controller::controller;
+
+      parameter_list parameters() const override
+      {
+         return { std::begin(params), std::end(params) };
+      }
+   };
+
+   // Records the frame (and key, for note ons) of each MIDI message
+   struct midi_receiver
+   {
+      void operator()(q::midi::note_on msg, std::size_t time)
+      {
+         keys.push_back(msg.key());
+         times.push_back(time);
+      }
+
+      template <typename Message>
+      void operator()(Message, std::size_t time)
+      {
+         keys.push_back(-1);
+         times.push_back(time);
+      }
+
+      std::vector<int> keys;
+      std::vector<std::size_t> times;
+   };
+
+   // A segment, with the gain and the number of MIDI messages received when
+   // it was processed
+   struct segment
+   {
+      std::size_t first, last;
+      double gain;
+      std::size_t midi;
+   };
+
+   struct ramp
+   {
+      std::size_t first, last;
+      double start, end;
+   };
+
+   struct test_processor : qplug::processor
+   {
+      test_processor(base_processor& base)
+       : processor(base)
+      {
+         receive_midi(midi);
+      }
+
+      bool sample_accurate() const override
+      {
+         return true;
+      }
+
+      void process(in_channels const&, out_channels const&) override
+      {
+         segments.clear();
+         ramps.clear();
+         if (!split)
+            return;
+
+         for_each_segment(block_size,
+            [this](std::size_t first, std::size_t last)
+            {
+               segments.push_back({ first, last, parameter_values()[0], midi.times.size() });
+            }
+         );
+
+         // After the segments: the events are still there
+         for_each_ramp(0, gain, block_size,
+            [this](std::size_t first, std::size_t last, double start, double end)
+            {
+               ramps.push_back({ first, last, start, end });
+            }
+         );
+         gain = parameter_values()[0];
+      }
+
+      bool split = true;
+      double gain = 0.5;
+      midi_receiver midi;
+      std::vector<segment> segments;
+      std::vector<ramp> ramps;
+   };
+
+   q::midi::raw_message note_on(int key)
+   {
+      return { std::uint32_t(0x90 | (key << 8) | (100 << 16)) };
+   }
+
+   struct test_host
+   {
+      test_host()
+       : buffer(block_size)
+      {
+         plugin.reset(44100, block_size);
+         plugin.activate(true);
+      }
+
+      test_processor& processor()
+      {
+         return static_cast<test_processor&>(plugin.processor());
+      }
+
+      void block()
+      {
+         float* out[] = { buffer.data() };
+         float const* in[] = { buffer.data() };
+         plugin.process(in, 1, out, 1, block_size);
+      }
+
+      headless_plugin plugin;
+      std::vector<float> buffer;
+   };
+}
+
+namespace cycfi::qplug
+{
+   controller_ptr make_controller(base_controller& base)
+   {
+      return std::make_unique<test_controller>(base);
+   }
+
+   processor_ptr make_processor(base_processor& base)
+   {
+      return std::make_unique<test_processor>(base);
+   }
+}
+
+TEST_CASE("test_segment_boundaries")
+{
+   test_host host;
+   auto& proc = host.processor();
+
+   // Out of order, and at the same frame: parameter changes go first
+   host.plugin.midi(note_on(60), 40);
+   host.plugin.automate(0, 0.75, 40);
+   host.plugin.automate(0, 0.25, 16);
+   host.block();
+
+   REQUIRE(proc.segments.size() == 3);
+   CHECK(proc.segments[0].first == 0);
+   CHECK(proc.segments[0].last == 16);
+   CHECK(proc.segments[0].gain == Approx(0.5));
+   CHECK(proc.segments[1].first == 16);
+   CHECK(proc.segments[1].last == 40);
+   CHECK(proc.segments[1].gain == Approx(0.25));
+   CHECK(proc.segments[2].first == 40);
+   CHECK(proc.segments[2].last == block_size);
+   CHECK(proc.segments[2].gain == Approx(0.75));
+   CHECK(proc.segments[2].midi == 1);
+   REQUIRE(proc.midi.times.size() == 1);
+   CHECK(proc.midi.times[0] == 40);
+   CHECK(proc.midi.keys[0] == 60);
+
+   // The events are gone the next block
+   host.block();
+   REQUIRE(proc.segments.size() == 1);
+   CHECK(proc.segments[0].first == 0);
+   CHECK(proc.segments[0].last == block_size);
+   CHECK(proc.segments[0].gain == Approx(0.75));
+   CHECK(proc.midi.times.size() == 1);
+}
+
+TEST_CASE("test_segment_edges")
+{
+   test_host host;
+   auto& proc = host.processor();
+
+   // At the first and last frames: no empty segments
+   host.plugin.automate(0, 0.25, 0);
+   host.plugin.midi(note_on(61), 0);
+   host.plugin.automate(0, 0.75, block_size - 1);
+   host.plugin.midi(note_on(62), block_size - 1);
+   host.block();
+
+   REQUIRE(proc.segments.size() == 2);
+   CHECK(proc.segments[0].first == 0);
+   CHECK(proc.segments[0].last == block_size - 1);
+   CHECK(proc.segments[0].gain == Approx(0.25));
+   CHECK(proc.segments[0].midi == 1);
+   CHECK(proc.segments[1].first == block_size - 1);
+   CHECK(proc.segments[1].last == block_size);
+   CHECK(proc.segments[1].gain == Approx(0.75));
+   CHECK(proc.segments[1].midi == 2);
+
+   // Past the end of the block: applied after the last segment
+   host.plugin.automate(0, 1.0, block_size + 10);
+   host.block();
+   REQUIRE(proc.segments.size() == 1);
+   CHECK(proc.segments[0].last == block_size);
+   CHECK(proc.segments[0].gain == Approx(0.75));
+   CHECK(proc.parameter_values()[0] == Approx(1.0));
+}
+
+TEST_CASE("test_segment_end_block")
+{
+   test_host host;
+   auto& proc = host.processor();
+
+   // Not split: the events are applied, and the messages dispatched, at the
+   // end of the block, in frame order
+   proc.split = false;
+   host.plugin.automate(1, 0.5, 8);
+   host.plugin.midi(note_on(64), 32);
+   host.plugin.midi(note_on(63), 4);
+   host.plugin.automate(1, -0.5, 20);
+   host.block();
+
+   CHECK(proc.segments.empty());
+   CHECK(proc.parameter_values()[1] == Approx(-0.5));
+   CHECK(proc.parameter_values().changed(1));
+   REQUIRE(proc.midi.keys.size() == 2);
+   CHECK(proc.midi.keys[0] == 63);
+   CHECK(proc.midi.keys[1] == 64);
+
+   // And not again
+   proc.split = true;
+   host.block();
+   CHECK(proc.segments.size() == 1);
+   CHECK(proc.midi.keys.size() == 2);
+
+   // Not sample accurate (no frame): applied at the start of the next block
+   host.plugin.automate(0, 0.125);
+   host.block();
+   REQUIRE(proc.segments.size() == 1);
+   CHECK(proc.segments[0].gain == Approx(0.125));
+}
+
+TEST_CASE("test_segment_ramps")
+{
+   test_host host;
+   auto& proc = host.processor();
+
+   // Only the events of the parameter, from the value before the block
+   host.plugin.automate(0, 0.25, 16);
+   host.plugin.automate(1, 0.5, 20);
+   host.plugin.automate(0, 0.75, 48);
+   host.block();
+
+   REQUIRE(proc.ramps.size() == 3);
+   CHECK(proc.ramps[0].first == 0);
+   CHECK(proc.ramps[0].last == 16);
+   CHECK(proc.ramps[0].start == Approx(0.5));
+   CHECK(proc.ramps[0].end == Approx(0.25));
+   CHECK(proc.ramps[1].first == 16);
+   CHECK(proc.ramps[1].last == 48);
+   CHECK(proc.ramps[1].start == Approx(0.25));
+   CHECK(proc.ramps[1].end == Approx(0.75));
+   CHECK(proc.ramps[2].first == 48);
+   CHECK(proc.ramps[2].last == block_size);
+   CHECK(proc.ramps[2].start == Approx(0.75));
+   CHECK(proc.ramps[2].end == Approx(0.75));
+
+   // The segments split at the other parameter's event too
+   CHECK(proc.segments.size() == 4);
+
+   // At the first frame: a jump, then constant
+   host.plugin.automate(0, 0.5, 0);
+   host.block();
+   REQUIRE(proc.ramps.size() == 1);
+   CHECK(proc.ramps[0].first == 0);
+   CHECK(proc.ramps[0].last == block_size);
+   CHECK(proc.ramps[0].start == Approx(0.5));
+   CHECK(proc.ramps[0].end == Approx(0.5));
+
+   // No events: constant, at the current value
+   host.block();
+   REQUIRE(proc.ramps.size() == 1);
+   CHECK(proc.ramps[0].start == Approx(0.5));
+   CHECK(proc.ramps[0].end == Approx(0.5));
+}
+
+TEST_CASE("test_smoothed_events")
+{
+   test_host host;
+   auto& proc = host.processor();
+   auto const& level = proc.smoothed(2);
+   constexpr double step = 1.0 / 441;
+
+   // Constant up to the event, then ramps from there
+   host.plugin.automate(2, 1.0, 32);
+   host.block();
+   REQUIRE(!level.constant());
+   CHECK(level[0] == Approx(0.0));
+   CHECK(level[31] == Approx(0.0));
+   CHECK(level[32] == Approx(step));
+   CHECK(level[63] == Approx(32 * step));
+   CHECK(proc.parameter_values()[2] == Approx(1.0));
+
+   // Continues with the next block
+   host.block();
+   CHECK(level[0] == Approx(33 * step));
+   CHECK(level[15] == Approx(48 * step));
+
+   // Restarts at the event, from the value the ramp has there
+   host.plugin.automate(2, 0.0, 16);
+   host.block();
+   auto from = 112 * step;
+   CHECK(level[15] == Approx(from));
+   CHECK(level[16] == Approx(from - from / 441));
+   CHECK(level[63] == Approx(from - 48 * from / 441));
+}
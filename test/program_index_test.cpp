@@ -0,0 +1,120 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/program_index.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace cycfi::qplug;
+
+namespace
+{
+   using entries = std::vector<std::pair<std::string, int>>;
+
+   entries get(program_index const& index)
+   {
+      entries r;
+      index.for_each([&](std::string_view name, int id) { r.emplace_back(name, id); });
+      return r;
+   }
+}
+
+TEST_CASE("test_program_index")
+{
+   program_index index;
+   CHECK(index.find(1) == "");
+   CHECK(index.find("Lead") == -1);
+
+   index.set("Lead", 1);
+   index.set("Bass", 2);
+   index.set("Pad", -1);
+   CHECK(index.size() == 3);
+   CHECK(index.find(1) == "Lead");
+   CHECK(index.find(2) == "Bass");
+   CHECK(index.find(-1) == "");
+   CHECK(index.find("Bass") == 2);
+   CHECK(index.find("Pad") == -1);
+   CHECK(index.has("Pad"));
+   CHECK(!index.has("Keys"));
+   CHECK(get(index) == entries{ { "Bass", 2 }, { "Lead", 1 }, { "Pad", -1 } });
+
+   // Change an id
+   index.set("Lead", 3);
+   CHECK(index.find(1) == "");
+   CHECK(index.find(3) == "Lead");
+
+   // Erase
+   CHECK(index.erase("Bass"));
+   CHECK(!index.erase("Bass"));
+   CHECK(index.find(2) == "");
+   CHECK(!index.has("Bass"));
+
+   index.clear();
+   CHECK(index.size() == 0);
+   CHECK(index.find(3) == "");
+}
+
+TEST_CASE("test_program_index_shared_id")
+{
+   // The first by name owns the id
+   program_index index;
+   index.set("Pad", 5);
+   index.set("Lead", 5);
+   index.set("Organ", 5);
+   CHECK(index.find(5) == "Lead");
+
+   index.erase("Lead");
+   CHECK(index.find(5) == "Organ");
+
+   index.set("Organ", 6);
+   CHECK(index.find(5) == "Pad");
+   CHECK(index.find(6) == "Organ");
+}
+
+TEST_CASE("test_program_index_generation")
+{
+   program_index index;
+   auto generation = index.generation();
+
+   index.set("Lead", 1);
+   CHECK(index.generation() != generation);
+   generation = index.generation();
+
+   // No change
+   index.set("Lead", 1);
+   index.erase("Bass");
+   CHECK(index.generation() == generation);
+
+   index.set("Lead", 2);
+   CHECK(index.generation() != generation);
+   generation = index.generation();
+
+   index.clear();
+   CHECK(index.generation() != generation);
+}
+
+TEST_CASE("test_program_index_copies")
+{
+   // Changes to an index do not show in its copies
+   program_index index;
+   index.set("Lead", 1);
+   index.set("Pad", 1);
+
+   auto copy = index;
+   index.set("Lead", 2);
+   index.erase("Pad");
+   index.set("Bass", 1);
+
+   CHECK(copy.find(1) == "Lead");
+   CHECK(copy.find(2) == "");
+   CHECK(get(copy) == entries{ { "Lead", 1 }, { "Pad", 1 } });
+
+   CHECK(index.find(1) == "Bass");
+   CHECK(index.find(2) == "Lead");
+   CHECK(get(index) == entries{ { "Bass", 1 }, { "Lead", 2 } });
+}
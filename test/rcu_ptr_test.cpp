@@ -0,0 +1,106 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/rcu_ptr.hpp>
+#include <thread>
+#include <vector>
+
+using namespace cycfi::qplug;
+
+namespace
+{
+   std::atomic<int> alive{ 0 };
+
+   struct object
+   {
+      object(int value_) : value(value_), check(~value_) { ++alive; }
+      ~object() { check = 0; --alive; }
+
+      int value;
+      int check;
+   };
+
+   std::unique_ptr<object const> make(int value)
+   {
+      return std::make_unique<object const>(value);
+   }
+}
+
+TEST_CASE("test_rcu_ptr")
+{
+   {
+      rcu_ptr<object> ptr{ make(1) };
+      CHECK(ptr.read()->value == 1);
+
+      // Retired objects are deleted once no reader can use them
+      ptr.publish(make(2));
+      ptr.publish(make(3));
+      CHECK(ptr.read()->value == 3);
+      ptr.reclaim();
+      CHECK(ptr.retired() == 0);
+      CHECK(alive == 1);
+
+      // Not while a reader has them
+      {
+         auto reader = ptr.read();
+         ptr.publish(make(4));
+         ptr.publish(make(5));
+         CHECK(reader->value == 3);
+         CHECK(ptr.retired() == 2);
+         CHECK(alive == 3);
+      }
+
+      ptr.reclaim();
+      CHECK(ptr.retired() == 0);
+      CHECK(alive == 1);
+   }
+   CHECK(alive == 0);
+
+   rcu_ptr<object> empty;
+   CHECK(!empty.read());
+}
+
+TEST_CASE("test_rcu_ptr_concurrent")
+{
+   // Readers check that the object they read is intact and never goes
+   // back, while the writer keeps replacing it
+   constexpr int n = 20000;
+   {
+      rcu_ptr<object> ptr{ make(0) };
+      std::atomic<bool> done{ false };
+      std::atomic<int> errors{ 0 };
+
+      // Catch is not thread safe: count the errors, and check them below
+      auto read = [&]
+      {
+         int last = 0;
+         while (!done)
+         {
+            auto reader = ptr.read();
+            if (reader->check != ~reader->value || reader->value < last)
+               ++errors;
+            last = reader->value;
+         }
+      };
+
+      std::vector<std::thread> readers;
+      for (int i = 0; i != 4; ++i)
+         readers.emplace_back(read);
+
+      for (int i = 1; i <= n; ++i)
+         ptr.publish(make(i));
+      done = true;
+      for (auto& t : readers)
+         t.join();
+      CHECK(errors == 0);
+
+      ptr.reclaim();
+      CHECK(ptr.read()->value == n);
+      CHECK(alive == 1);
+   }
+   CHECK(alive == 0);
+}
@@ -0,0 +1,117 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/rt_check.hpp>
+#include <qplug/worker_pool.hpp>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace cycfi::qplug;
+
+namespace
+{
+   // Keep the compiler from optimizing the allocations away
+   void* volatile sink;
+}
+
+TEST_CASE("test_rt_check_allocation_outside_scope")
+{
+   rt_check::reset();
+   sink = std::malloc(64);
+   std::free(sink);
+   auto p = std::make_unique<int[]>(100);
+   CHECK(rt_check::violations() == 0);
+}
+
+TEST_CASE("test_rt_check_allocation_inside_scope")
+{
+   rt_check::reset();
+   {
+      rt_check::scope rt{ "test" };
+      sink = std::malloc(64);
+   }
+   std::size_t after_malloc = rt_check::violations();
+   {
+      rt_check::scope rt{ "test" };
+      std::free(sink);
+   }
+   std::size_t after_free = rt_check::violations();
+   {
+      rt_check::scope rt{ "test" };
+      auto p = new int[100];
+      sink = p;
+      delete[] p;
+   }
+   std::size_t after_new = rt_check::violations();
+
+   CHECK(after_malloc == 1);
+   CHECK(after_free == 2);
+   CHECK(after_new == 4);
+}
+
+TEST_CASE("test_rt_check_lock_inside_scope")
+{
+   rt_check::reset();
+   std::mutex m;
+   {
+      rt_check::scope rt{ "test" };
+      std::lock_guard<std::mutex> lock(m);
+   }
+   CHECK(rt_check::violations() == 1);
+}
+
+TEST_CASE("test_rt_check_nested_scopes")
+{
+   rt_check::reset();
+   {
+      rt_check::scope outer{ "outer" };
+      {
+         rt_check::scope off{ nullptr };
+         sink = std::malloc(64);
+      }
+      std::free(sink);
+   }
+   CHECK(rt_check::violations() == 1);
+}
+
+TEST_CASE("test_rt_check_other_threads")
+{
+   // Scopes are per thread
+   rt_check::reset();
+   std::thread t{ [] { sink = std::malloc(64); std::free(sink); } };
+   std::size_t during = 0;
+   {
+      rt_check::scope rt{ "test" };
+      t.join();
+      during = rt_check::violations();
+   }
+   CHECK(during == 0);
+}
+
+TEST_CASE("test_rt_check_worker_pool")
+{
+   // The workers run the jobs in the caller's scope
+   worker_pool pool{ 2 };
+   rt_check::reset();
+   {
+      rt_check::scope rt{ "test" };
+      pool.run(8,
+         [](std::size_t)
+         {
+            void* volatile p = std::malloc(64);
+            std::free(p);
+         }
+      );
+   }
+   std::size_t during = rt_check::violations();
+
+   pool.run(8, [](std::size_t) { std::free(std::malloc(64)); });
+   CHECK(during == 16);
+   CHECK(rt_check::violations() == during);
+}
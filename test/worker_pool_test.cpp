@@ -0,0 +1,49 @@
+/*=============================================================================
+   Copyright (c) 2016-2019 Joel de Guzman
+
+   Distributed under the MIT License (https://opensource.org/licenses/MIT)
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#include <infra/catch.hpp>
+#include <qplug/worker_pool.hpp>
+
+using namespace cycfi::qplug;
+
+TEST_CASE("test_worker_pool_runs_each_job_once")
+{
+   worker_pool pool{ 3 };
+   std::vector<std::atomic<int>> counts(64);
+   std::vector<int> expected(64);
+
+   for (std::size_t batch = 0; batch != 1000; ++batch)
+   {
+      auto n = 1 + (batch % counts.size());
+      pool.run(n, [&](std::size_t i) { ++counts[i]; });
+      for (std::size_t i = 0; i != n; ++i)
+         ++expected[i];
+   }
+
+   for (std::size_t i = 0; i != counts.size(); ++i)
+      CHECK(counts[i] == expected[i]);
+}
+
+TEST_CASE("test_worker_pool_results_visible")
+{
+   worker_pool pool{ 2 };
+   std::vector<float> data(16);
+
+   for (int batch = 1; batch != 100; ++batch)
+   {
+      pool.run(data.size(), [&](std::size_t i) { data[i] = batch * i; });
+      for (std::size_t i = 0; i != data.size(); ++i)
+         REQUIRE(data[i] == batch * i);
+   }
+}
+
+TEST_CASE("test_worker_pool_no_workers")
+{
+   worker_pool pool{ 0 };
+   int sum = 0;
+   pool.run(10, [&](std::size_t i) { sum += i; });
+   CHECK(sum == 45);
+}